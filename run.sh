@@ -5,10 +5,16 @@
 WIDTH=${WIDTH:-1920}
 HEIGHT=${HEIGHT:-1080}
 FRONTEND_VSYNC=${FRONTEND_VSYNC:-false}
+FRONTEND_FAST_START=${FRONTEND_FAST_START:-true}
+FRONTEND_PREDICTION=${FRONTEND_PREDICTION:-}
+FRONTEND_COALESCE_MOTION=${FRONTEND_COALESCE_MOTION:-true}
+FRONTEND_RAW_MOUSE=${FRONTEND_RAW_MOUSE:-}
+FRONTEND_LOCAL_CURSOR=${FRONTEND_LOCAL_CURSOR:-false}
 FPS=${FPS:-60}
 CURRENT_KEYBOARD_LAYOUT="$(setxkbmap -query | grep layout | sed -r 's/.*\s(.+)$/\1/')"  # Not overridable
 XVFB_KEYBOARD_LAYOUT="${XVFB_KEYBOARD_LAYOUT:-$CURRENT_KEYBOARD_LAYOUT}"
 SYNCINPUT_PROTOCOL=${SYNCINPUT_PROTOCOL:-tcp}
+SYNCINPUT_BACKEND=${SYNCINPUT_BACKEND:-xtest}
 MOUSE_SENSITIVITY=${MOUSE_SENSITIVITY:-1.0}
 
 # For Steam Proton games, set this option to false. They have their own vulkan translation layer and vglrun does not support vulkan.
@@ -24,6 +30,19 @@ CLIENT_LOSS_START=${CLIENT_LOSS_START:-0.0}
 CLIENT_LOSS_STOP=${CLIENT_LOSS_STOP:-1.0}
 # VIDEO_CRF=${VIDEO_CRF:-23}
 VIDEO_BITRATE=${VIDEO_BITRATE:-25M}
+SESSION_FILE=${SESSION_FILE:-session.rtprec}
+REPLAY_SPEED=${REPLAY_SPEED:-1.0}
+INPUT_RECORD_FILE=${INPUT_RECORD_FILE:-}
+INPUT_REPLAY_FILE=${INPUT_REPLAY_FILE:-inputs.rec}
+NATIVE_STREAMER=${NATIVE_STREAMER:-false}
+STREAMER_INTRA_REFRESH=${STREAMER_INTRA_REFRESH:-true}
+STREAMER_THREADS=${STREAMER_THREADS:-}
+STREAMER_PIN_CORE=${STREAMER_PIN_CORE:-}
+STREAMER_COLOR_KERNEL=${STREAMER_COLOR_KERNEL:-auto}
+STREAMER_CAPTURE=${STREAMER_CAPTURE:-xshm}
+WINDOW_TITLE=${WINDOW_TITLE:-}
+VIDEO_TRANSPORT=${VIDEO_TRANSPORT:-rtp}
+CONFIG_FILE=${CONFIG_FILE:-}
 
 # Private variables
 BUILD_DIR="$PWD/build"
@@ -37,11 +56,18 @@ FFMPEG_AUDIO_PORT=4004
 VIDEO_OUT="rtp://127.0.0.1:$FFMPEG_VIDEO_PORT?buffer_size=20971520"
 # VIDEO_OUT="rtp://127.0.0.1:$FFMPEG_VIDEO_PORT"
 AUDIO_OUT="rtp://127.0.0.1:$FFMPEG_AUDIO_PORT"
+SHM_VIDEO_NAME=cloudgaming-video
+# Xvfb maps its framebuffer from a file in this directory, see STREAMER_CAPTURE=xvfb
+XVFB_FBDIR=/dev/shm/cloudgaming-xvfb
 SYNCINPUT_IP='127.0.0.1'
 SYNCINPUT_PORT=9090
 FRONTEND_SYNCINPUT_PORT=9091
+SYNCINPUT_CURSOR_PORT=9092
+FRONTEND_CURSOR_PORT=9093
 FRONTEND_VIDEO_PORT=6004
 FRONTEND_AUDIO_PORT=7004
+STREAMER_FEEDBACK_PORT=5010
+FRONTEND_FEEDBACK_PORT=6010
 COMMAND=""
 
 
@@ -86,26 +112,64 @@ run_proxies() {
     ./udp-proxy/udp-wan-proxy -l "$((FFMPEG_AUDIO_PORT + 1))" -r "$((FRONTEND_AUDIO_PORT + 1))" $server_args > "$LOG_DIR/udp_audio_rtcp.log" 2>&1 &
     ./udp-proxy/udp-wan-proxy -l "$((FFMPEG_VIDEO_PORT + 1))" -r "$((FRONTEND_VIDEO_PORT + 1))" $server_args > "$LOG_DIR/udp_video_rtcp.log" 2>&1 &
 
+    # Loss reports of the native streamer
+    if $NATIVE_STREAMER; then
+        ./udp-proxy/udp-wan-proxy -l "$FRONTEND_FEEDBACK_PORT" -r "$STREAMER_FEEDBACK_PORT" -d "$CLIENT_DELAY_MS" -j "$CLIENT_JITTER_MS" --loss-start "$CLIENT_LOSS_START" --loss-stop "$CLIENT_LOSS_STOP" \
+            > "$LOG_DIR/udp_feedback.log" 2>&1 &
+    fi
+
     # syncinput
     if [ "$SYNCINPUT_PROTOCOL" == "udp" ]; then
         ./udp-proxy/udp-wan-proxy -l "$FRONTEND_SYNCINPUT_PORT" -r "$SYNCINPUT_PORT" -d "$CLIENT_DELAY_MS" -j "$CLIENT_JITTER_MS" --loss-start "$CLIENT_LOSS_START" --loss-stop "$CLIENT_LOSS_STOP" \
             > "$LOG_DIR/udp_syncinput.log" 2>&1 &
-    elif [ "$SYNCINPUT_PROTOCOL" == "tcp" ]; then
+    fi
+
+    # The cursor channel is always TCP
+    if [ "$SYNCINPUT_PROTOCOL" == "tcp" ] || $FRONTEND_LOCAL_CURSOR; then
         echo "TCP proxy"
         cd toxiproxy/dist || exit 1
         ./toxiproxy-server 2>&1 | tee "$LOG_DIR/toxiproxy_server.log" &
         sleep 1
 
         (
-        ./toxiproxy-cli create --listen "localhost:$FRONTEND_SYNCINPUT_PORT" --upstream "localhost:$SYNCINPUT_PORT" input_proxy
-        ./toxiproxy-cli toxic add --downstream --type latency --attribute latency="$CLIENT_DELAY_MS" --attribute jitter="$CLIENT_JITTER_MS" input_proxy
-        ./toxiproxy-cli toxic add --upstream --type latency --attribute latency="$CLIENT_DELAY_MS" --attribute jitter="$CLIENT_JITTER_MS" input_proxy
+        if [ "$SYNCINPUT_PROTOCOL" == "tcp" ]; then
+            ./toxiproxy-cli create --listen "localhost:$FRONTEND_SYNCINPUT_PORT" --upstream "localhost:$SYNCINPUT_PORT" input_proxy
+            ./toxiproxy-cli toxic add --downstream --type latency --attribute latency="$CLIENT_DELAY_MS" --attribute jitter="$CLIENT_JITTER_MS" input_proxy
+            ./toxiproxy-cli toxic add --upstream --type latency --attribute latency="$CLIENT_DELAY_MS" --attribute jitter="$CLIENT_JITTER_MS" input_proxy
+        fi
+
+        # Cursor updates travel from server to client like the video
+        if $FRONTEND_LOCAL_CURSOR; then
+            ./toxiproxy-cli create --listen "localhost:$FRONTEND_CURSOR_PORT" --upstream "localhost:$SYNCINPUT_CURSOR_PORT" cursor_proxy
+            ./toxiproxy-cli toxic add --downstream --type latency --attribute latency="$SERVER_DELAY_MS" --attribute jitter="$SERVER_JITTER_MS" cursor_proxy
+        fi
         )  2>&1 | tee "$LOG_DIR/toxiproxy_cli.log"
 
         cd ../..
     fi
 }
 
+# args: UDP port, timeout in seconds
+# Waits until a socket is bound to the given local UDP port.
+wait_udp_port() {
+    local tries=$(($2 * 10))
+    while ! ss -Hlun "sport = :$1" | grep -q .; do
+        tries=$((tries - 1))
+        [ $tries -le 0 ] && return 1
+        sleep 0.1
+    done
+}
+
+# args: RTP ports
+# Prints a comma separated list of the given RTP ports and their corresponding RTCP ports.
+rtp_ports() {
+    local ports=()
+    for port in "$@"; do
+        ports+=("$port" "$((port + 1))")
+    done
+    (IFS=,; echo "${ports[*]}")
+}
+
 # args: app path + arguments
 run_app() {
     echo "App"
@@ -154,11 +218,31 @@ main() {
     if [ "$1" == "-h" ] || [ "$1" == "--help" ] || [ $# -lt 1 ]; then
         echo "Usage: run.sh <application> [subsystems] [app args...]"
         echo -e "    <application>: Path to the application executable."
-        echo -e "    [subsystems]: (Optional) Comma separated (no space) list of subsystems to start. Can be 'app', 'stream', 'syncinput', 'proxy', 'frontend', or empty ('') to ignore this option."
+        echo -e "    [subsystems]: (Optional) Comma separated (no space) list of subsystems to start. Can be 'app', 'stream', 'syncinput', 'proxy', 'frontend', 'record', 'replay', 'inputreplay', or empty ('') to ignore this option."
+        echo -e "                  'record', 'replay' and 'inputreplay' are not started by default."
         echo -e "    [app args...]: (Optional) Additional arguments passed to the application."
         return 0
     fi
 
+    if [ "$STREAMER_CAPTURE" != "xshm" ] && ! $NATIVE_STREAMER; then
+        echo "STREAMER_CAPTURE=$STREAMER_CAPTURE requires NATIVE_STREAMER=true"
+        return 1
+    fi
+
+    if [ "$STREAMER_CAPTURE" == "window" ] && [ -z "$WINDOW_TITLE" ]; then
+        echo "STREAMER_CAPTURE=window requires WINDOW_TITLE"
+        return 1
+    fi
+
+    if [ "$VIDEO_TRANSPORT" != "rtp" ] && ! $NATIVE_STREAMER; then
+        echo "VIDEO_TRANSPORT=$VIDEO_TRANSPORT requires NATIVE_STREAMER=true"
+        return 1
+    fi
+
+    # Options of the native executables that are not covered by environment variables
+    local config_flags=()
+    [ -n "$CONFIG_FILE" ] && config_flags+=("--config=$(realpath "$CONFIG_FILE")")
+
     local APP_PATH="$1"
     COMMAND="$2"
     shift 1  # Shift app path
@@ -173,11 +257,20 @@ main() {
         SINK_ID="$(pactl load-module module-null-sink sink_name="$SINK_NAME")"
 
         echo "Xvfb"
-        Xvfb "$OUT_DISPLAY" -screen 0 "${WIDTH}x${HEIGHT}x24" &
+        # Always expose the framebuffer, so the streamer can read it even if started separately
+        mkdir -p "$XVFB_FBDIR"
+        Xvfb "$OUT_DISPLAY" -screen 0 "${WIDTH}x${HEIGHT}x24" -fbdir "$XVFB_FBDIR" &
 
         run_app "$APP_PATH" "$@"
     fi
 
+    if [[ ",$COMMAND," =~ .*,record,.* ]]; then
+        # Record the audio/video RTP streams in place of the proxies.
+        echo "Recording session to $SESSION_FILE"
+        "$BUILD_DIR/rtpreplay" record "$SESSION_FILE" 127.0.0.1 "$(rtp_ports $FFMPEG_VIDEO_PORT $FFMPEG_AUDIO_PORT)" "${config_flags[@]}" 2>&1 | tee "$LOG_DIR/record.log" &
+        sleep 1
+    fi
+
     if has_command "stream"; then
         # Presets and crf
         # https://superuser.com/questions/1556953/why-does-preset-veryfast-in-ffmpeg-generate-the-most-compressed-file-compared
@@ -188,17 +281,35 @@ main() {
         # NVidia hardware acceleration
         # ffmpeg -help encoder=hevc_nvenc | less
         # -c:v h264_nvenc -preset llhq -tune hq \
-        echo "Video stream at $VIDEO_OUT"
-        # ffmpeg -f x11grab -video_size "${WIDTH}x${HEIGHT}" -framerate "$FPS" -i "$OUT_DISPLAY" -draw_mouse 1 \
-        ffmpeg -re -r "$FPS" -f x11grab -video_size "${WIDTH}x${HEIGHT}" -framerate "$FPS" -i "$OUT_DISPLAY" -draw_mouse 1 \
-            -pix_fmt yuv420p \
-            -c:v libx264 -preset ultrafast -tune zerolatency -b:v "${VIDEO_BITRATE}" \
-            -flags2 fast \
-            -refs 1 -me_method dia -me_range 16 -thread_type slice -slices 4 -threads 0 \
-            -an \
-            -f rtp "$VIDEO_OUT" \
-            -sdp_file video.sdp \
-            > "$LOG_DIR/video.log" 2>&1 &
+        local video_out="$VIDEO_OUT"
+        [ "$VIDEO_TRANSPORT" == "shm" ] && video_out="shm:$SHM_VIDEO_NAME"
+        [ "$VIDEO_TRANSPORT" == "raw" ] && video_out="shmraw:$SHM_VIDEO_NAME"
+        echo "Video stream at $video_out"
+        if $NATIVE_STREAMER; then
+            local streamer_flags=("feedback=$STREAMER_FEEDBACK_PORT")
+            $STREAMER_INTRA_REFRESH && streamer_flags+=(intra-refresh)
+            [ -n "$STREAMER_THREADS" ] && streamer_flags+=("threads=$STREAMER_THREADS")
+            [ -n "$STREAMER_PIN_CORE" ] && streamer_flags+=("pin=$STREAMER_PIN_CORE")
+            streamer_flags+=("color=$STREAMER_COLOR_KERNEL" "capture=$STREAMER_CAPTURE" "fbdir=$XVFB_FBDIR")
+            [ -n "$WINDOW_TITLE" ] && streamer_flags+=("window=$WINDOW_TITLE")
+            "$BUILD_DIR/streamer" "$OUT_DISPLAY" "$WIDTH" "$HEIGHT" "$FPS" "$VIDEO_BITRATE" "$video_out" video.sdp "${streamer_flags[@]}" "${config_flags[@]}" \
+                > "$LOG_DIR/video.log" 2>&1 &
+        else
+            # The frontend draws the cursor itself with FRONTEND_LOCAL_CURSOR
+            local draw_mouse=1
+            $FRONTEND_LOCAL_CURSOR && draw_mouse=0
+            # ffmpeg -f x11grab -video_size "${WIDTH}x${HEIGHT}" -framerate "$FPS" -i "$OUT_DISPLAY" -draw_mouse 1 \
+            ffmpeg -re -r "$FPS" -f x11grab -video_size "${WIDTH}x${HEIGHT}" -framerate "$FPS" -i "$OUT_DISPLAY" -draw_mouse "$draw_mouse" \
+                -pix_fmt yuv420p \
+                -c:v libx264 -preset ultrafast -tune zerolatency -b:v "${VIDEO_BITRATE}" \
+                -flags2 fast \
+                -flags +global_header -x264-params repeat-headers=1 \
+                -refs 1 -me_method dia -me_range 16 -thread_type slice -slices 4 -threads 0 \
+                -an \
+                -f rtp "$VIDEO_OUT" \
+                -sdp_file video.sdp \
+                > "$LOG_DIR/video.log" 2>&1 &
+        fi
 
         echo "Audio stream at $AUDIO_OUT"
         ffmpeg -f pulse -fragment_size 16 -i "$SINK_NAME.monitor" \
@@ -208,14 +319,30 @@ main() {
             > "$LOG_DIR/audio.log" 2>&1 &
 
         sleep 1
-        sed -i -r "s/$FFMPEG_VIDEO_PORT/$FRONTEND_VIDEO_PORT/" video.sdp
+        if [ "$VIDEO_TRANSPORT" == "rtp" ]; then
+            sed -i -r "s/$FFMPEG_VIDEO_PORT/$FRONTEND_VIDEO_PORT/" video.sdp
+            # Announce the resolution so the frontend can open the decoder without probing the stream.
+            # The parameter sets are already contained in the SDP due to the global header flag.
+            # The native streamer announces it itself, as it depends on the captured window.
+            $NATIVE_STREAMER || echo "a=framesize:96 ${WIDTH}-${HEIGHT}" >> video.sdp
+        fi
         sed -i -r "s/$FFMPEG_AUDIO_PORT/$FRONTEND_AUDIO_PORT/" audio.sdp
     fi
 
+    if [[ ",$COMMAND," =~ .*,record,.* ]]; then
+        # The replay needs the SDPs of the recorded streams, as written by the stream subsystem above
+        cp video.sdp "$SESSION_FILE.video.sdp"
+        cp audio.sdp "$SESSION_FILE.audio.sdp"
+    fi
+
     if has_command "syncinput"; then
         echo "syncinput"
-        local app_title=""  # Unused on linux
-        DISPLAY="$OUT_DISPLAY" "$BUILD_DIR/syncinput" "$app_title" "$SYNCINPUT_IP" "$SYNCINPUT_PORT" "$SYNCINPUT_PROTOCOL" 2>&1 | tee "$LOG_DIR/syncinput.log" &
+        local syncinput_flags=()
+        if $FRONTEND_LOCAL_CURSOR; then
+            syncinput_flags+=("cursor-port=$SYNCINPUT_CURSOR_PORT")
+            [ "$STREAMER_CAPTURE" == "window" ] && syncinput_flags+=(cursor-window)
+        fi
+        DISPLAY="$OUT_DISPLAY" "$BUILD_DIR/syncinput" "$WINDOW_TITLE" "$SYNCINPUT_IP" "$SYNCINPUT_PORT" "$SYNCINPUT_PROTOCOL" "$SYNCINPUT_BACKEND" "${syncinput_flags[@]}" "${config_flags[@]}" 2>&1 | tee "$LOG_DIR/syncinput.log" &
         sleep 1
     fi
 
@@ -223,11 +350,45 @@ main() {
         run_proxies
     fi
 
+    if [[ ",$COMMAND," =~ .*,replay,.* ]]; then
+        # Replay into the proxies, so the recorded session is subject to WAN emulation.
+        echo "Replaying session $SESSION_FILE"
+        if [ ! -f "$SESSION_FILE.video.sdp" ] || [ ! -f "$SESSION_FILE.audio.sdp" ]; then
+            echo "Missing $SESSION_FILE.video.sdp or $SESSION_FILE.audio.sdp, record the session with the stream subsystem"
+            return 1
+        fi
+        cp "$SESSION_FILE.video.sdp" video.sdp
+        cp "$SESSION_FILE.audio.sdp" audio.sdp
+        # Wait for the frontend to open the stream, otherwise the first packets are lost
+        (wait_udp_port "$FRONTEND_VIDEO_PORT" 10 || echo "Frontend did not open port $FRONTEND_VIDEO_PORT, replaying anyway"
+         "$BUILD_DIR/rtpreplay" replay "$SESSION_FILE" 127.0.0.1 "$(rtp_ports $FFMPEG_VIDEO_PORT $FFMPEG_AUDIO_PORT)" "$REPLAY_SPEED" "${config_flags[@]}") 2>&1 | tee "$LOG_DIR/replay.log" &
+    fi
+
+    if [[ ",$COMMAND," =~ .*,inputreplay,.* ]]; then
+        # Replay inputs in place of the frontend, through the proxies.
+        echo "Replaying inputs $INPUT_REPLAY_FILE"
+        "$BUILD_DIR/inputreplay" "$INPUT_REPLAY_FILE" "$SYNCINPUT_IP" "$FRONTEND_SYNCINPUT_PORT" "$SYNCINPUT_PROTOCOL" "$REPLAY_SPEED" "${config_flags[@]}" 2>&1 | tee "$LOG_DIR/inputreplay.log" &
+    fi
+
     if has_command "frontend"; then
         echo "Frontend"
-        local vsync=""
-        $FRONTEND_VSYNC && vsync="vsync"
-        "$BUILD_DIR/frontend" video.sdp audio.sdp "$SYNCINPUT_IP" "$FRONTEND_SYNCINPUT_PORT" "$SYNCINPUT_PROTOCOL" "$MOUSE_SENSITIVITY" "$vsync" 2>&1 | tee "$LOG_DIR/frontend.log"
+        local flags=()
+        $FRONTEND_VSYNC && flags+=(vsync)
+        $FRONTEND_FAST_START && flags+=(faststart)
+        $FRONTEND_COALESCE_MOTION || flags+=(no-coalesce)
+        if [ "$FRONTEND_RAW_MOUSE" == "auto" ]; then
+            flags+=(raw-mouse)
+        elif [ -n "$FRONTEND_RAW_MOUSE" ]; then
+            flags+=("raw-mouse=$FRONTEND_RAW_MOUSE")
+        fi
+        [ -n "$INPUT_RECORD_FILE" ] && flags+=("record-input=$INPUT_RECORD_FILE")
+        [ -n "$FRONTEND_PREDICTION" ] && flags+=("predict=$FRONTEND_PREDICTION")
+        $FRONTEND_LOCAL_CURSOR && flags+=("cursor-port=$FRONTEND_CURSOR_PORT")
+        $NATIVE_STREAMER && flags+=("feedback=127.0.0.1:$FRONTEND_FEEDBACK_PORT")
+        local video_in=video.sdp
+        [ "$VIDEO_TRANSPORT" == "shm" ] && video_in="shm:$SHM_VIDEO_NAME"
+        [ "$VIDEO_TRANSPORT" == "raw" ] && video_in="shmraw:$SHM_VIDEO_NAME"
+        "$BUILD_DIR/frontend" "$video_in" audio.sdp "$SYNCINPUT_IP" "$FRONTEND_SYNCINPUT_PORT" "$SYNCINPUT_PROTOCOL" "$MOUSE_SENSITIVITY" "${flags[@]}" "${config_flags[@]}" 2>&1 | tee "$LOG_DIR/frontend.log"
     else
         # Normally, wait until frontend quits, then kill all child processes.
         # But if the frontend was not started, wait for child processes to end.
@@ -6,17 +6,17 @@ using std::cout;
 using std::cerr;
 
 namespace frontend {
-    // Maximum number of bytes the audio queue is allowed to have before being cleared.
-    constexpr int max_queued_audio_bytes = 1024 * 3;
+    // Default maximum number of bytes the audio queue is allowed to have before being cleared.
+    constexpr unsigned int default_max_queued_audio_bytes = 1024 * 3;
 
 
-    AudioService::AudioService() : _audioDev(0), _running(false) {}
+    AudioService::AudioService() : _audioDev(0), _maxQueuedBytes(default_max_queued_audio_bytes), _running(false) {}
 
-    bool AudioService::open(const char* url) {
+    bool AudioService::open(const char* url, bool fastStart) {
         _stream.format()->probesize = 16;  // low latency audio
         _stream.format()->max_analyze_duration = 0;
 
-        if (!_stream.open(url))
+        if (!_stream.open(url, !fastStart))
             return false;
 
         auto audio = _stream.audio();
@@ -56,11 +56,21 @@ namespace frontend {
         SDL_CloseAudioDevice(_audioDev);
     }
 
+    void AudioService::setMaxQueuedBytes(unsigned int bytes) {
+        _maxQueuedBytes = bytes;
+    }
+
+    void AudioService::setThreadRole(const util::ThreadRole& role) {
+        _threadRole = role;
+    }
+
     void AudioService::_process(AudioService* self) {
+        util::ScopedThreadRole role("audio", self->_threadRole);
         AVStream& stream = self->_stream;
         auto audio = stream.audio();
         auto sampleBufSize = av_get_bytes_per_sample(audio->sample_fmt);
         auto dev = self->_audioDev;
+        auto maxQueuedBytes = self->_maxQueuedBytes;
         auto frame = self->_frame.get();
 
         if (sampleBufSize < 0) {
@@ -81,7 +91,7 @@ namespace frontend {
             // At start, the buffer fills up, causing about 0.5s latency, but I don't know when or why
             // this happens exactly. To prevent this, simply clear the audio queue when it becomes too
             // full. This might not be the nicest way to fix this delay, but it works.
-            if (SDL_GetQueuedAudioSize(dev) > max_queued_audio_bytes) [[unlikely]] {
+            if (SDL_GetQueuedAudioSize(dev) > maxQueuedBytes) [[unlikely]] {
                 cout << "Flushing audio queue to reduce latency: " << SDL_GetQueuedAudioSize(dev) << " Bytes\n";
                 SDL_ClearQueuedAudio(dev);
                 avcodec_flush_buffers(audio);
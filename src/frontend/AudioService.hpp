@@ -4,16 +4,25 @@
 #include <SDL_audio.h>
 #include <thread>
 #include "av.hpp"
+#include "util/thread_role.hpp"
 
 namespace frontend {
     class AudioService {
         public:
             AudioService();
 
-            bool open(const char* url);
+            // If fastStart is true, skip stream probing and open the decoder immediately using the
+            // codec parameters provided by the SDP.
+            bool open(const char* url, bool fastStart = false);
             void start();
             void join();
 
+            // Clear the audio queue when it grows beyond the given number of bytes. Default: 3072
+            void setMaxQueuedBytes(unsigned int bytes);
+
+            // Placement of the decoder thread. Call before start().
+            void setThreadRole(const util::ThreadRole& role);
+
         private:
             static void _process(AudioService* self);
 
@@ -22,6 +31,8 @@ namespace frontend {
             Frame _frame;
             std::thread _thread;
             AVStream _stream;
+            util::ThreadRole _threadRole;
+            unsigned int _maxQueuedBytes;
             bool _running;
     };
 }
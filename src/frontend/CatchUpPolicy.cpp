@@ -0,0 +1,34 @@
+#include "CatchUpPolicy.hpp"
+
+namespace frontend {
+    CatchUpPolicy::CatchUpPolicy() :
+        _pressureUs(0), _jumpUs(0), _underPressure(false)
+    {}
+
+    void CatchUpPolicy::configure(int pressureMs, int jumpMs) {
+        _pressureUs = pressureMs * 1000LL;
+        _jumpUs = jumpMs * 1000LL;
+        _underPressure = false;
+    }
+
+    bool CatchUpPolicy::isEnabled() const {
+        return _pressureUs > 0 || _jumpUs > 0;
+    }
+
+    CatchUpPolicy::Action CatchUpPolicy::update(int64_t ageUs, size_t queued) {
+        if (_jumpUs > 0 && ageUs > _jumpUs)
+            return Action::Jump;
+
+        if (_pressureUs > 0) {
+            if (ageUs > _pressureUs || queued >= pressure_queue_size)
+                _underPressure = true;
+
+            // Only leave fast decoding once the backlog is gone, otherwise it would toggle with
+            // every packet while slowly catching up
+            else if (queued == 0 && ageUs < _pressureUs / 2)
+                _underPressure = false;
+        }
+
+        return _underPressure ? Action::DecodeFast : Action::Decode;
+    }
+}
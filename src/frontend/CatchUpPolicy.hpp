@@ -0,0 +1,50 @@
+#ifndef FRONTEND_CATCHUPPOLICY_HPP
+#define FRONTEND_CATCHUPPOLICY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace frontend {
+    // Decides how to get rid of a backlog of video packets that queued up between the network and
+    // the decoder, e.g. after a CPU spike or a burst following a network stall.
+    // Decoding every packet in order would keep the added latency until the backlog is cleared.
+    // Instead, decoding is sped up under pressure and stale frames are skipped when far behind.
+    class CatchUpPolicy {
+        public:
+            enum class Action {
+                // Decode normally
+                Decode,
+
+                // Skip non-reference frames and the loop filter. Reduces quality slightly until
+                // the next keyframe, but decodes considerably faster.
+                DecodeFast,
+
+                // Drop all packets before the newest keyframe or recovery point.
+                Jump,
+            };
+
+        public:
+            CatchUpPolicy();
+
+            // pressureMs: Decode fast when packets waited longer than this before decoding.
+            // jumpMs: Jump to the newest keyframe when packets waited longer than this.
+            // Catch-up is disabled if both are 0.
+            void configure(int pressureMs, int jumpMs);
+            bool isEnabled() const;
+
+            // Returns the action for a packet that waited ageUs in the receive queue, with queued
+            // packets still waiting behind it.
+            Action update(int64_t ageUs, size_t queued);
+
+        private:
+            // Packets queued behind the current one that count as pressure regardless of age
+            static constexpr size_t pressure_queue_size = 8;
+
+        private:
+            int64_t _pressureUs;
+            int64_t _jumpUs;
+            bool _underPressure;
+    };
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "CursorService.hpp"
+#include <cerrno>
+#include <iostream>
+#include "util/clock.hpp"
+
+using std::cout;
+using std::cerr;
+
+namespace frontend {
+    // Interval in which the receiver checks whether it should stop
+    constexpr int receive_timeout_ms = 200;
+
+    CursorService::CursorService(const net::ClockSync& clockSync) :
+        _clockSync(clockSync), _running(false), _serial(0), _pendingX(0), _pendingY(0),
+        _x(0), _y(0), _hasPosition(false)
+    {}
+
+    bool CursorService::connect(const char* host, const char* port) {
+        if (!_transmitter.connect(host, port))
+            return false;
+
+        _transmitter.setReceiveTimeout(receive_timeout_ms);
+        return true;
+    }
+
+    void CursorService::start() {
+        _running = true;
+        _thread = std::thread(_process, this);
+    }
+
+    void CursorService::join() {
+        _running = false;
+
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    void CursorService::addMotion(int32_t x, int32_t y, int64_t timeUs) {
+        std::lock_guard lock(_mutex);
+        _pending.push_back(Motion { .timeUs = timeUs, .x = x, .y = y });
+        _pendingX += x;
+        _pendingY += y;
+    }
+
+    bool CursorService::getPosition(int* x, int* y) {
+        std::lock_guard lock(_mutex);
+
+        if (!_hasPosition)
+            return false;
+
+        _dropPendingMotion(util::monotonicTimeUs() - pending_motion_timeout_us);
+        *x = _x + _pendingX;
+        *y = _y + _pendingY;
+        return true;
+    }
+
+    bool CursorService::updateShape(Shape* shape) const {
+        std::lock_guard lock(_mutex);
+
+        if (_serial == shape->serial)
+            return false;
+
+        auto it = _shapes.find(_serial);
+        if (it == _shapes.end())
+            return false;
+
+        *shape = it->second;
+        return true;
+    }
+
+    void CursorService::_dropPendingMotion(int64_t untilUs) {
+        while (!_pending.empty() && _pending.front().timeUs <= untilUs) {
+            _pendingX -= _pending.front().x;
+            _pendingY -= _pending.front().y;
+            _pending.pop_front();
+        }
+    }
+
+    void CursorService::_process(CursorService* self) {
+        input::CursorMessage msg;
+        std::vector<uint32_t> pixels;
+
+        while (self->_running) {
+            errno = 0;
+
+            if (!self->_transmitter.recv(&msg, &pixels)) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    continue;
+
+                cerr << "Cursor forwarding stopped\n";
+                break;
+            }
+
+            std::lock_guard lock(self->_mutex);
+
+            if (msg.type == input::CursorMessagePosition) {
+                const int64_t lastMotion = input::timestampToUs(msg.lastMotion);
+
+                // Timestamp 0 means no motion was injected yet
+                if (lastMotion != 0)
+                    self->_dropPendingMotion(self->_clockSync.toLocal(lastMotion));
+
+                self->_x = msg.x;
+                self->_y = msg.y;
+                self->_hasPosition = true;
+            } else if (msg.type == input::CursorMessageShape) {
+                if (msg.width > 0 && msg.height > 0) {
+                    self->_shapes[msg.serial] = Shape {
+                        .serial = msg.serial,
+                        .width = static_cast<int>(msg.width),
+                        .height = static_cast<int>(msg.height),
+                        .hotX = msg.x,
+                        .hotY = msg.y,
+                        .pixels = pixels
+                    };
+                }
+                self->_serial = msg.serial;
+            }
+        }
+    }
+} // namespace frontend
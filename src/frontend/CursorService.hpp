@@ -0,0 +1,85 @@
+#ifndef FRONTEND_CURSORSERVICE_HPP
+#define FRONTEND_CURSORSERVICE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "network/clocksync.hpp"
+#include "network/cursor.hpp"
+
+namespace frontend {
+    // Receives the cursor from syncinput, see input::CursorTransmitter, so the UI can draw it
+    // without waiting for the video.
+    // The drawn position is the last reported position plus the local mouse motion that was sent
+    // after the last motion event included in that report. Like this, the cursor moves with local
+    // display latency, while warps by the application still show up one round trip later.
+    class CursorService {
+        public:
+            struct Shape {
+                uint32_t serial = 0;
+                int width = 0;
+                int height = 0;
+                int hotX = 0;
+                int hotY = 0;
+                std::vector<uint32_t> pixels;  // ARGB8888, straight alpha
+            };
+
+        public:
+            // The clock sync of the input connection, to relate reported motion to local motion.
+            CursorService(const net::ClockSync& clockSync);
+
+            bool connect(const char* host, const char* port);
+            void start();
+            void join();
+
+            // (Thread-safe) Register mouse motion that was sent to syncinput.
+            // timeUs: The timestamp the motion event was sent with, in the local monotonic clock.
+            // Motion merged by InputService is sent with the newest timestamp, so a cursor update
+            // retires all of it at once.
+            void addMotion(int32_t x, int32_t y, int64_t timeUs);
+
+            // (Thread-safe) Get the predicted position in stream coordinates.
+            // Returns false if no position was received yet.
+            bool getPosition(int* x, int* y);
+
+            // (Thread-safe) Copy the current shape if its serial differs from shape->serial.
+            // Returns false if the shape did not change.
+            bool updateShape(Shape* shape) const;
+
+        private:
+            struct Motion {
+                int64_t timeUs;
+                int32_t x;
+                int32_t y;
+            };
+
+            // Motion that is not reported after this time is assumed to be included in the
+            // position, e.g. because it was lost or merged with an older event.
+            static constexpr int64_t pending_motion_timeout_us = 250'000;
+
+            static void _process(CursorService* self);
+            void _dropPendingMotion(int64_t untilUs);
+
+        private:
+            input::CursorTransmitter _transmitter;
+            const net::ClockSync& _clockSync;
+            std::thread _thread;
+            std::atomic<bool> _running;
+
+            mutable std::mutex _mutex;
+            std::unordered_map<uint32_t, Shape> _shapes;
+            uint32_t _serial;
+            std::deque<Motion> _pending;
+            int32_t _pendingX;
+            int32_t _pendingY;
+            int _x;
+            int _y;
+            bool _hasPosition;
+    };
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "InputService.hpp"
+#include <iostream>
+#include "util/clock.hpp"
+
+using std::cout;
+using std::cerr;
+
+namespace frontend {
+    // Minimum time between two "Input queue full" messages
+    constexpr int64_t queue_full_log_interval_us = 1000000;
+
+
+    InputService::InputService(const input::InputTransmitter& transmitter) :
+        _transmitter(transmitter), _coalesceMotion(true), _numCoalesced(0), _numQueueFull(0),
+        _lastQueueFullLogUs(0)
+    {}
+
+    void InputService::start() {
+        _thread = std::thread(_process, this);
+    }
+
+    void InputService::join() {
+        _queue.close();
+        _thread.join();
+
+        if (_numCoalesced > 0)
+            cout << "Coalesced " << _numCoalesced << " mouse motion events\n";
+        if (_numQueueFull > 0)
+            cout << "Waited for the input queue " << _numQueueFull << " times\n";
+    }
+
+    void InputService::setCoalesceMotion(bool coalesce) {
+        _coalesceMotion = coalesce;
+    }
+
+    void InputService::push(const input::InputEvent& event) {
+        input::InputEvent stamped = event;
+
+        // Stamp when the input happened, not when it is eventually sent
+        if (input::timestampToUs(stamped.timestamp) == 0)
+            stamped.timestamp = input::makeTimestamp(util::monotonicTimeUs());
+
+        if (_queue.push(stamped) || _queue.isClosed())
+            return;
+
+        // Inputs must not get lost, so sleep until the sender catches up.
+        _numQueueFull++;
+        const int64_t now = util::monotonicTimeUs();
+        int64_t lastLog = _lastQueueFullLogUs.load(std::memory_order_relaxed);
+
+        if (now - lastLog >= queue_full_log_interval_us && _lastQueueFullLogUs.compare_exchange_strong(lastLog, now))
+            cerr << "Input queue full, waiting\n";
+
+        _queue.waitPush(stamped);
+    }
+
+    void InputService::pushMouseButton(uint8_t button, bool pressed) {
+        push(input::InputEvent {
+            .type = input::EventMouseButton,
+            .timestamp = {},
+            .button = input::MouseButton { .button = button, .pressed = pressed }
+        });
+    }
+
+    void InputService::pushMouseMotion(int32_t x, int32_t y, int64_t timeUs) {
+        push(input::InputEvent {
+            .type = input::EventMouseMotion,
+            .timestamp = input::makeTimestamp(timeUs),
+            .motion = input::MouseMotion { .x = x, .y = y }
+        });
+    }
+
+    void InputService::pushMouseWheel(int32_t x, int32_t y) {
+        push(input::InputEvent {
+            .type = input::EventMouseWheel,
+            .timestamp = {},
+            .wheel = input::MouseWheel { .x = x, .y = y }
+        });
+    }
+
+    void InputService::pushKey(const SDL_Keysym& key, bool pressed) {
+        push(input::makeKeyEvent(key, pressed));
+    }
+
+    void InputService::_process(InputService* self) {
+        input::InputEvent event;
+
+        while (self->_queue.waitPop(&event)) {
+            // Events only queue up if sending is slower than event generation, i.e. when the
+            // connection is backpressured. Merge queued motion into a single event in this case,
+            // keeping the timestamp of the newest one. syncinput echoes it in cursor updates, so
+            // CursorService retires all merged motion at once, see CursorService::addMotion().
+            if (event.type == input::EventMouseMotion && self->_coalesceMotion) {
+                const input::InputEvent* next;
+                input::InputEvent merged;
+
+                while ((next = self->_queue.peek()) && next->type == input::EventMouseMotion) {
+                    self->_queue.pop(&merged);
+                    event.motion.x += merged.motion.x;
+                    event.motion.y += merged.motion.y;
+                    event.timestamp = merged.timestamp;
+                    self->_numCoalesced++;
+                }
+            }
+
+            self->_transmitter.send(event);
+        }
+    }
+} // namespace frontend
@@ -0,0 +1,50 @@
+#ifndef FRONTEND_INPUTSERVICE_HPP
+#define FRONTEND_INPUTSERVICE_HPP
+
+#include <atomic>
+#include <thread>
+#include "network/input.hpp"
+#include "util/mpsc_queue.hpp"
+
+namespace frontend {
+    // Sends input events from a dedicated thread, so that a blocking send, e.g. a full TCP window
+    // under emulated delay, does not stall event processing and rendering.
+    // Events are passed through a lock-free queue and may be pushed from any thread.
+    class InputService {
+        public:
+            InputService(const input::InputTransmitter& transmitter);
+
+            void start();
+            void join();
+
+            // If enabled, consecutive mouse motion events that queued up while the connection was
+            // backpressured are merged into a single event. Default: true
+            void setCoalesceMotion(bool coalesce);
+
+            // (Thread-safe) Queue an input event in host byte order. See InputTransmitter::send().
+            // Only blocks if the queue is full, until the sender made space.
+            void push(const input::InputEvent& event);
+
+            void pushMouseButton(uint8_t button, bool pressed);
+            // timeUs: Time the motion occurred in the local monotonic clock, or 0 for now.
+            void pushMouseMotion(int32_t x, int32_t y, int64_t timeUs = 0);
+            void pushMouseWheel(int32_t x, int32_t y);
+            void pushKey(const SDL_Keysym& key, bool pressed);
+
+        private:
+            static constexpr size_t queue_size = 1024;
+
+            static void _process(InputService* self);
+
+        private:
+            const input::InputTransmitter& _transmitter;
+            util::MPSCQueue<input::InputEvent, queue_size> _queue;
+            std::thread _thread;
+            std::atomic<bool> _coalesceMotion;
+            size_t _numCoalesced;
+            std::atomic<uint64_t> _numQueueFull;
+            std::atomic<int64_t> _lastQueueFullLogUs;
+    };
+}
+
+#endif
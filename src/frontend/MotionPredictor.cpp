@@ -0,0 +1,42 @@
+#include "MotionPredictor.hpp"
+
+namespace frontend {
+    MotionPredictor::MotionPredictor() :
+        _pendingX(0), _pendingY(0), _latency(clock::duration::zero()), _pixelsPerCount(0)
+    {}
+
+    void MotionPredictor::configure(float pixelsPerCount, int latencyMs) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _pixelsPerCount = pixelsPerCount;
+        _latency = std::chrono::milliseconds(latencyMs);
+        _pending.clear();
+        _pendingX = _pendingY = 0;
+    }
+
+    bool MotionPredictor::isEnabled() const {
+        return _pixelsPerCount != 0;
+    }
+
+    void MotionPredictor::addMotion(int32_t x, int32_t y) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _pending.push_back({ clock::now(), x, y });
+        _pendingX += x;
+        _pendingY += y;
+    }
+
+    void MotionPredictor::getOffset(float* dx, float* dy) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        const auto reflected = clock::now() - _latency;
+
+        // Drop motion that should already be visible in the video
+        while (!_pending.empty() && _pending.front().time <= reflected) {
+            _pendingX -= _pending.front().x;
+            _pendingY -= _pending.front().y;
+            _pending.pop_front();
+        }
+
+        // Turning the camera to the right moves the image content to the left
+        *dx = -_pendingX * _pixelsPerCount;
+        *dy = -_pendingY * _pixelsPerCount;
+    }
+} // namespace frontend
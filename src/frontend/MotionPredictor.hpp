@@ -0,0 +1,49 @@
+#ifndef FRONTEND_MOTIONPREDICTOR_HPP
+#define FRONTEND_MOTIONPREDICTOR_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace frontend {
+    // Tracks relative mouse motion that was sent but is presumably not yet reflected in the video,
+    // and predicts the resulting viewport shift, i.e. image-space reprojection for latency hiding.
+    // Motion is considered reflected once it is older than the configured latency.
+    class MotionPredictor {
+        public:
+            MotionPredictor();
+
+            // pixelsPerCount: Viewport shift in window pixels per unit of mouse motion. Game and
+            //                 sensitivity specific, hence needs to be calibrated.
+            // latencyMs: Time until sent motion is reflected in the video, i.e. roughly the RTT.
+            // Prediction is disabled if pixelsPerCount is 0.
+            void configure(float pixelsPerCount, int latencyMs);
+            bool isEnabled() const;
+
+            // (Thread-safe) Record sent relative mouse motion.
+            void addMotion(int32_t x, int32_t y);
+
+            // (Thread-safe) Returns the predicted viewport shift in window pixels.
+            void getOffset(float* dx, float* dy);
+
+        private:
+            using clock = std::chrono::steady_clock;
+
+            struct Sample {
+                clock::time_point time;
+                int32_t x;
+                int32_t y;
+            };
+
+        private:
+            std::mutex _mutex;
+            std::deque<Sample> _pending;
+            int64_t _pendingX;
+            int64_t _pendingY;
+            clock::duration _latency;
+            float _pixelsPerCount;
+    };
+}
+
+#endif
@@ -0,0 +1,170 @@
+#include "RawMouse.hpp"
+#include "ui.hpp"
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <linux/input.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+using std::cout;
+using std::cerr;
+
+namespace frontend {
+    // Interval in which the reader thread checks whether it should stop
+    constexpr int raw_mouse_poll_timeout_ms = 200;
+
+    // Number of evdev devices to probe when auto-detecting a mouse
+    constexpr int max_event_devices = 32;
+
+    constexpr bool testBit(const unsigned long* bits, int bit) {
+        constexpr int bits_per_long = sizeof(unsigned long) * 8;
+        return (bits[bit / bits_per_long] >> (bit % bits_per_long)) & 1;
+    }
+
+
+    MotionAccumulator::MotionAccumulator() :
+        _scale(1 << fraction_bits), _remainderX(0), _remainderY(0)
+    {}
+
+    void MotionAccumulator::setSensitivity(float sensitivity) {
+        _scale = std::llround(sensitivity * (1 << fraction_bits));
+    }
+
+    void MotionAccumulator::add(int32_t x, int32_t y, int32_t* outX, int32_t* outY) {
+        _remainderX += x * _scale;
+        _remainderY += y * _scale;
+
+        // Truncate towards zero and keep the rest for the next motion
+        *outX = _remainderX / (1 << fraction_bits);
+        *outY = _remainderY / (1 << fraction_bits);
+        _remainderX -= static_cast<int64_t>(*outX) << fraction_bits;
+        _remainderY -= static_cast<int64_t>(*outY) << fraction_bits;
+    }
+
+
+    RawMouse::RawMouse() : _fd(-1), _monotonic(false), _running(false) {}
+
+    RawMouse::~RawMouse() {
+        if (_fd != -1)
+            close(_fd);
+    }
+
+    bool RawMouse::_isMouse(int fd) {
+        unsigned long evBits[EV_MAX / (sizeof(unsigned long) * 8) + 1] = {};
+        unsigned long relBits[REL_MAX / (sizeof(unsigned long) * 8) + 1] = {};
+        unsigned long keyBits[KEY_MAX / (sizeof(unsigned long) * 8) + 1] = {};
+
+        if (ioctl(fd, EVIOCGBIT(0, sizeof(evBits)), evBits) == -1
+                || ioctl(fd, EVIOCGBIT(EV_REL, sizeof(relBits)), relBits) == -1
+                || ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) == -1)
+            return false;
+
+        return testBit(evBits, EV_REL) && testBit(relBits, REL_X) && testBit(relBits, REL_Y)
+            && testBit(keyBits, BTN_LEFT);
+    }
+
+    bool RawMouse::open(const std::string& path) {
+        if (path.empty()) {
+            for (int i = 0; i < max_event_devices && _fd == -1; ++i) {
+                std::string candidate = "/dev/input/event" + std::to_string(i);
+                int fd = ::open(candidate.c_str(), O_RDONLY | O_NONBLOCK);
+
+                if (fd == -1)
+                    continue;
+
+                if (_isMouse(fd)) {
+                    cout << "Using raw mouse device " << candidate << "\n";
+                    _fd = fd;
+                }
+                else
+                    close(fd);
+            }
+
+            if (_fd == -1) {
+                cerr << "No readable mouse device found. Is the user in the input group?\n";
+                return false;
+            }
+        }
+        else {
+            _fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+
+            if (_fd == -1) {
+                cerr << "Failed to open raw mouse device " << path << ": " << std::strerror(errno) << "\n";
+                return false;
+            }
+        }
+
+        char name[256] = "unknown";
+        ioctl(_fd, EVIOCGNAME(sizeof(name)), name);
+        cout << "Raw mouse: " << name << "\n";
+
+        // Report event times in the same clock as the rest of the pipeline
+        int clock = CLOCK_MONOTONIC;
+        _monotonic = ioctl(_fd, EVIOCSCLOCKID, &clock) == 0;
+        if (!_monotonic)
+            cerr << "Failed to switch raw mouse to the monotonic clock, using receive time instead\n";
+
+        return true;
+    }
+
+    void RawMouse::start(UI& ui) {
+        _running = true;
+        _thread = std::thread(_process, this, std::ref(ui));
+    }
+
+    void RawMouse::join() {
+        _running = false;
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    void RawMouse::_process(RawMouse* self, UI& ui) {
+        input_event events[64];
+        int32_t x = 0, y = 0;
+        bool dropped = false;
+        pollfd pfd { .fd = self->_fd, .events = POLLIN, .revents = 0 };
+
+        while (self->_running) {
+            if (poll(&pfd, 1, raw_mouse_poll_timeout_ms) <= 0)
+                continue;
+
+            ssize_t nread = read(self->_fd, events, sizeof(events));
+
+            if (nread == -1) {
+                if (errno == EAGAIN || errno == EINTR)
+                    continue;
+                cerr << "Failed to read raw mouse: " << std::strerror(errno) << "\n";
+                break;
+            }
+
+            for (size_t i = 0; i < nread / sizeof(input_event); ++i) {
+                const input_event& ev = events[i];
+
+                if (ev.type == EV_REL && !dropped) {
+                    if (ev.code == REL_X)
+                        x += ev.value;
+                    else if (ev.code == REL_Y)
+                        y += ev.value;
+                }
+                else if (ev.type == EV_SYN && ev.code == SYN_DROPPED) {
+                    // The kernel buffer overflowed. Discard everything until the next report.
+                    dropped = true;
+                    x = y = 0;
+                }
+                else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                    if (!dropped && (x != 0 || y != 0)) {
+                        int64_t time = self->_monotonic ? ev.input_event_sec * 1000000ll + ev.input_event_usec : 0;
+                        ui.handleRawMotion(x, y, time);
+                    }
+
+                    dropped = false;
+                    x = y = 0;
+                }
+            }
+        }
+    }
+} // namespace frontend
@@ -0,0 +1,58 @@
+#ifndef FRONTEND_RAWMOUSE_HPP
+#define FRONTEND_RAWMOUSE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace frontend {
+    class UI;
+
+    // Scales relative mouse motion in 16.16 fixed-point and carries the sub-count remainder over
+    // to the next motion, so that no motion gets lost to rounding, regardless of the polling rate.
+    class MotionAccumulator {
+        public:
+            MotionAccumulator();
+
+            void setSensitivity(float sensitivity);
+
+            // Add raw motion and return the whole counts that are ready to be sent.
+            void add(int32_t x, int32_t y, int32_t* outX, int32_t* outY);
+
+        private:
+            static constexpr int fraction_bits = 16;
+
+            int64_t _scale;
+            int64_t _remainderX;
+            int64_t _remainderY;
+    };
+
+    // Reads relative mouse motion directly from an evdev device on a dedicated thread, bypassing
+    // the SDL event loop. Motion is forwarded per hardware report (SYN_REPORT) and timestamped
+    // with the kernel's event time.
+    // Requires read access to /dev/input/event*, i.e. usually membership in the input group.
+    class RawMouse {
+        public:
+            RawMouse();
+            ~RawMouse();
+
+            // Open the given evdev device, or the first device that looks like a mouse if path
+            // is empty.
+            bool open(const std::string& path);
+            void start(UI& ui);
+            void join();
+
+        private:
+            static bool _isMouse(int fd);
+            static void _process(RawMouse* self, UI& ui);
+
+        private:
+            int _fd;
+            bool _monotonic;  // Whether event times use the monotonic clock
+            std::thread _thread;
+            std::atomic<bool> _running;
+    };
+}
+
+#endif
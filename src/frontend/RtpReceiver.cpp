@@ -0,0 +1,246 @@
+#include "RtpReceiver.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <iostream>
+
+using std::cout;
+using std::cerr;
+
+namespace frontend {
+    // Number of (possibly coalesced) datagrams received per system call
+    constexpr size_t receive_batch_size = 32;
+
+    // Same socket buffer size as for libavformat's input
+    constexpr int receive_buffer_bytes = 20 * 1024 * 1024;
+
+    constexpr uint8_t start_code[] = { 0, 0, 0, 1 };
+
+    // NAL unit and payload structure types, see RFC 6184
+    constexpr uint8_t nal_idr = 5;
+    constexpr uint8_t nal_sei = 6;
+    constexpr uint8_t nal_stap_a = 24;
+    constexpr uint8_t nal_fu_a = 28;
+
+    // Marks the start of a gradual decoder refresh, e.g. periodic intra refresh
+    constexpr int sei_recovery_point = 6;
+
+    // Larger sequence number jumps in either direction are taken as a new stream, e.g. of a
+    // restarted sender with a new random initial sequence number, rather than loss or reordering
+    constexpr int max_sequence_gap = 3000;
+
+
+    RtpReceiver::RtpReceiver() :
+        _timeoutMs(-1), _expectedSequence(0), _hasSequence(false), _inFragment(false), _packets(0),
+        _lost(0), _resyncs(0), _accessUnits(0)
+    {}
+
+    bool RtpReceiver::open(const char* port) {
+        if (!_socket.listen(net::UDP, "0.0.0.0", port)) {
+            cerr << "Failed to listen for RTP on port " << port << "\n";
+            return false;
+        }
+
+        if (!_socket.setReceiveBufferSize(receive_buffer_bytes))
+            cerr << "Failed to set receive buffer size\n";
+
+        _receiver.init(&_socket, receive_batch_size);
+        cout << "Receiving RTP on port " << port << " in batches\n";
+        return true;
+    }
+
+    bool RtpReceiver::isOpen() const {
+        return _socket.isValid();
+    }
+
+    bool RtpReceiver::read(AVPacket* packet, int timeoutMs) {
+        if (timeoutMs != _timeoutMs) {
+            _socket.setReceiveTimeout(timeoutMs);
+            _timeoutMs = timeoutMs;
+        }
+
+        while (_complete.empty()) {
+            const uint8_t* data;
+            size_t size;
+
+            if (_receiver.next(&data, &size))
+                _processPacket(data, size);
+            else if (!_receiver.receive())
+                return false;
+        }
+
+        const AccessUnit& unit = _complete.front();
+        const bool allocated = av_new_packet(packet, unit.data.size()) == 0;
+
+        if (allocated) {
+            memcpy(packet->data, unit.data.data(), unit.data.size());
+            packet->pts = packet->dts = unit.timestamp;
+            packet->flags = (unit.key ? AV_PKT_FLAG_KEY : 0) | (unit.corrupt ? AV_PKT_FLAG_CORRUPT : 0);
+        }
+
+        _complete.pop_front();
+        return allocated;
+    }
+
+    void RtpReceiver::printStats() const {
+        cout << "Received " << _packets << " RTP packets in " << _receiver.calls() << " system calls, "
+             << _lost << " lost, " << _resyncs << " resyncs, " << _accessUnits << " access units\n";
+    }
+
+    void RtpReceiver::_processPacket(const uint8_t* data, size_t size) {
+        // RTP header, see RFC 3550
+        if (size < 12 || (data[0] >> 6) != 2)
+            return;
+
+        // RTCP multiplexed on the same port, see RTP_PT_IS_RTCP in libavformat's rtp.h
+        if ((data[1] >= 192 && data[1] <= 195) || (data[1] >= 200 && data[1] <= 210))
+            return;
+
+        const bool marker = data[1] & 0x80;
+        const uint16_t sequence = data[2] << 8 | data[3];
+        const uint32_t timestamp = static_cast<uint32_t>(data[4]) << 24 | data[5] << 16 | data[6] << 8 | data[7];
+        size_t offset = 12 + (data[0] & 0x0f) * 4;
+
+        if (data[0] & 0x10) {
+            if (size < offset + 4)
+                return;
+            offset += 4 + (data[offset + 2] << 8 | data[offset + 3]) * 4;
+        }
+
+        if (data[0] & 0x20)
+            size -= std::min<size_t>(data[size - 1], size);
+
+        if (offset >= size)
+            return;
+
+        _packets++;
+        bool lost = false;
+
+        if (_hasSequence) {
+            const int16_t gap = static_cast<int16_t>(sequence - _expectedSequence);
+
+            if (gap < -max_sequence_gap || gap > max_sequence_gap) {
+                // Pass on what is left of the old stream, the decoder recovers at the next keyframe
+                _resyncs++;
+                _current.corrupt = true;
+                _finish();
+            } else if (gap < 0) {
+                // Too late, its access unit was already passed on
+                return;
+            } else if (gap > 0) {
+                _lost += gap;
+                lost = true;
+                _inFragment = false;
+                _current.corrupt = true;
+            }
+        }
+
+        _hasSequence = true;
+        _expectedSequence = sequence + 1;
+
+        // A new timestamp starts a new access unit, even if the marker of the previous one was lost
+        if (timestamp != _current.timestamp && !_current.data.empty())
+            _finish();
+
+        _current.timestamp = timestamp;
+        if (lost)
+            _current.corrupt = true;
+
+        const uint8_t* payload = data + offset;
+        const size_t length = size - offset;
+        const uint8_t type = payload[0] & 0x1f;
+
+        if (type >= 1 && type <= 23) {
+            _appendNal(payload, length);
+        } else if (type == nal_stap_a) {
+            for (size_t pos = 1; pos + 2 <= length;) {
+                const size_t nalSize = payload[pos] << 8 | payload[pos + 1];
+                pos += 2;
+
+                if (nalSize == 0 || pos + nalSize > length) {
+                    _current.corrupt = true;
+                    break;
+                }
+
+                _appendNal(payload + pos, nalSize);
+                pos += nalSize;
+            }
+        } else if (type == nal_fu_a && length > 2) {
+            const bool start = payload[1] & 0x80;
+            const bool end = payload[1] & 0x40;
+
+            if (start) {
+                _beginNal((payload[0] & 0xe0) | (payload[1] & 0x1f));
+                _inFragment = true;
+            }
+
+            // Without the start, the fragment is useless
+            if (_inFragment)
+                _current.data.insert(_current.data.end(), payload + 2, payload + length);
+            else
+                _current.corrupt = true;
+
+            if (end)
+                _inFragment = false;
+        }
+
+        if (marker)
+            _finish();
+    }
+
+    void RtpReceiver::_beginNal(uint8_t header) {
+        if ((header & 0x1f) == nal_idr)
+            _current.key = true;
+
+        _current.data.insert(_current.data.end(), std::begin(start_code), std::end(start_code));
+        _current.data.push_back(header);
+    }
+
+    void RtpReceiver::_appendNal(const uint8_t* nal, size_t size) {
+        if ((nal[0] & 0x1f) == nal_sei && _hasRecoveryPoint(nal + 1, size - 1))
+            _current.key = true;
+
+        _beginNal(nal[0]);
+        _current.data.insert(_current.data.end(), nal + 1, nal + size);
+    }
+
+    void RtpReceiver::_finish() {
+        if (!_current.data.empty()) {
+            _accessUnits++;
+            _complete.push_back(std::move(_current));
+        }
+
+        _current = AccessUnit();
+        _inFragment = false;
+    }
+
+    bool RtpReceiver::_hasRecoveryPoint(const uint8_t* sei, size_t size) {
+        // Sequence of SEI messages up to the RBSP trailing bits. The headers are short enough not
+        // to contain emulation prevention bytes in practice.
+        size_t pos = 0;
+
+        while (pos < size && sei[pos] != 0x80) {
+            int type = 0;
+            int length = 0;
+
+            while (pos < size && sei[pos] == 0xff)
+                type += sei[pos++];
+            if (pos >= size)
+                break;
+            type += sei[pos++];
+
+            while (pos < size && sei[pos] == 0xff)
+                length += sei[pos++];
+            if (pos >= size)
+                break;
+            length += sei[pos++];
+
+            if (type == sei_recovery_point)
+                return true;
+
+            pos += length;
+        }
+
+        return false;
+    }
+}
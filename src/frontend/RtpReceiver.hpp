@@ -0,0 +1,70 @@
+#ifndef FRONTEND_RTPRECEIVER_HPP
+#define FRONTEND_RTPRECEIVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "network/socket.hpp"
+#include "network/udpbatch.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace frontend {
+    // Receives an H.264 RTP stream (RFC 6184, packetization mode 1) with net::UdpBatchReceiver
+    // and reassembles access units in Annex B format. Replaces libavformat's rtp protocol and
+    // depacketizer, which receive one datagram per system call.
+    // Lost packets mark the affected access unit as corrupt, fragments of lost NAL units are
+    // dropped. Reordered packets count as lost. Large sequence number jumps restart the
+    // reassembly, e.g. for a restarted sender.
+    class RtpReceiver {
+        public:
+            RtpReceiver();
+
+            // Listen on the given UDP port on all interfaces.
+            bool open(const char* port);
+            bool isOpen() const;
+
+            // Read the next access unit. Returns false on timeout or error.
+            bool read(AVPacket* packet, int timeoutMs);
+
+            void printStats() const;
+
+        private:
+            struct AccessUnit {
+                std::vector<uint8_t> data;
+                uint32_t timestamp = 0;
+                bool key = false;
+                bool corrupt = false;
+            };
+
+            void _processPacket(const uint8_t* data, size_t size);
+
+            // Append a complete NAL unit
+            void _appendNal(const uint8_t* nal, size_t size);
+
+            // Start a NAL unit given by its header, e.g. of a fragmentation unit
+            void _beginNal(uint8_t header);
+
+            void _finish();
+            static bool _hasRecoveryPoint(const uint8_t* sei, size_t size);
+
+        private:
+            net::Socket _socket;
+            net::UdpBatchReceiver _receiver;
+            AccessUnit _current;
+            std::deque<AccessUnit> _complete;
+            int _timeoutMs;
+            uint16_t _expectedSequence;
+            bool _hasSequence;
+            bool _inFragment;
+            uint64_t _packets;
+            uint64_t _lost;
+            uint64_t _resyncs;
+            uint64_t _accessUnits;
+    };
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "StartupTimeline.hpp"
+#include <iostream>
+#include <syncstream>
+
+namespace frontend {
+    static const char* stage_names[StartupTimeline::NumStages] = {
+        "start",
+        "socket open",
+        "decoder open",
+        "first packet",
+        "first keyframe",
+        "first decoded frame",
+        "first presented frame",
+    };
+
+
+    StartupTimeline::StartupTimeline() {
+        for (auto& stage : _stages)
+            stage = 0;
+    }
+
+    void StartupTimeline::mark(Stage stage) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+
+        if (isMarked(stage))
+            return;
+
+        int64_t expected = 0;
+        int64_t now = duration_cast<microseconds>(clock::now().time_since_epoch()).count();
+
+        if (_stages[stage].compare_exchange_strong(expected, now) && stage == FirstPresent)
+            report();
+    }
+
+    bool StartupTimeline::isMarked(Stage stage) const {
+        return _stages[stage] != 0;
+    }
+
+    void StartupTimeline::report() const {
+        std::osyncstream out(std::cout);
+        const int64_t start = _stages[Start];
+
+        out << "Startup timeline:\n";
+
+        for (int i = 0; i < NumStages; ++i) {
+            int64_t time = _stages[i];
+            out << "\t" << stage_names[i] << ": ";
+
+            if (time == 0)
+                out << "-\n";
+            else
+                out << (time - start) / 1000.0 << "ms\n";
+        }
+    }
+} // namespace frontend
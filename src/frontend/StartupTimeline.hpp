@@ -0,0 +1,43 @@
+#ifndef FRONTEND_STARTUPTIMELINE_HPP
+#define FRONTEND_STARTUPTIMELINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace frontend {
+    // Records when the individual stages of the video startup happened and prints a report as soon
+    // as the first frame was presented.
+    class StartupTimeline {
+        public:
+            enum Stage {
+                Start,          // VideoService::open() called
+                SocketOpen,     // Input opened, i.e. SDP parsed and sockets bound
+                DecoderOpen,    // Stream info available and decoder opened
+                FirstPacket,    // First video packet received
+                FirstKeyframe,  // First video keyframe received
+                FirstFrame,     // First frame decoded
+                FirstPresent,   // First frame presented on screen
+                NumStages
+            };
+
+            StartupTimeline();
+
+            // (Thread-safe) Record the current time for the given stage if it was not recorded yet.
+            // Prints the report when the FirstPresent stage is recorded.
+            void mark(Stage stage);
+
+            // (Thread-safe) Returns true if the given stage was already recorded.
+            bool isMarked(Stage stage) const;
+
+            void report() const;
+
+        private:
+            using clock = std::chrono::steady_clock;
+
+            // Microseconds since clock epoch, 0 if not yet recorded.
+            std::atomic<int64_t> _stages[NumStages];
+    };
+}
+
+#endif
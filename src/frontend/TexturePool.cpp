@@ -0,0 +1,247 @@
+#include "TexturePool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+using std::cout;
+using std::cerr;
+
+namespace frontend {
+    TexturePool::TexturePool() :
+        _presented(nullptr), _renderer(nullptr), _width(0), _height(0), _alignment(0), _misses(0), _enabled(false)
+    {}
+
+    bool TexturePool::init(SDL_Renderer* renderer, AVCodecContext* codec, int numTextures) {
+        if (uploadsDirectly(renderer)) {
+            cout << "Renderer uploads frames directly from decoder buffers, not decoding into textures\n";
+            return false;
+        }
+
+        // Without probing, the pixel format is only known after the first frame. Buffers for
+        // other formats are left to FFmpeg.
+        if (!(codec->codec->capabilities & AV_CODEC_CAP_DR1)
+                || (codec->pix_fmt != AV_PIX_FMT_YUV420P && codec->pix_fmt != AV_PIX_FMT_NONE)) {
+            cerr << "Decoder does not support decoding into textures\n";
+            return false;
+        }
+
+        // Planes are stored back to back, each one must start aligned for SIMD code
+        int width = codec->width;
+        int height = codec->height;
+        int align[AV_NUM_DATA_POINTERS];
+        avcodec_align_dimensions2(codec, &width, &height, align);
+        _alignment = std::max<size_t>({ av_cpu_max_align(), static_cast<size_t>(align[0]),
+                static_cast<size_t>(align[1]) * 2, static_cast<size_t>(align[2]) * 2 });
+
+        _renderer = renderer;
+        _width = codec->width;
+        _height = codec->height;
+        _paddedSize(codec, &_width, &_height);
+        _slots.resize(numTextures);
+
+        for (Slot& slot : _slots) {
+            slot.pool = this;
+
+            // Nothing was handed out to the decoder yet, so the slots can be dropped
+            if (!_create(slot) || !_lock(slot)) {
+                destroy();
+                _slots.clear();
+                return false;
+            }
+        }
+
+        codec->opaque = this;
+        codec->get_buffer2 = _getBuffer;
+        _enabled = true;
+        cout << "Decoding into " << numTextures << " textures of " << _width << "x" << _height << "\n";
+        return true;
+    }
+
+    bool TexturePool::uploadsDirectly(SDL_Renderer* renderer) {
+        SDL_RendererInfo info;
+
+        if (SDL_GetRendererInfo(renderer, &info) != 0)
+            return false;
+
+        // Both call glTexSubImage2D() on the given planes, while locking a texture returns a
+        // separate staging buffer that is uploaded on unlock
+        return strcmp(info.name, "opengl") == 0 || strcmp(info.name, "opengles2") == 0;
+    }
+
+    void TexturePool::destroy() {
+        std::lock_guard lock(_mutex);
+
+        // Keep the slots, as frames may still be released afterwards
+        for (Slot& slot : _slots) {
+            if (slot.texture)
+                SDL_DestroyTexture(slot.texture);
+            slot.texture = nullptr;
+            slot.pixels = nullptr;
+            slot.locked = false;
+        }
+
+        _presented = nullptr;
+        _enabled = false;
+    }
+
+    void TexturePool::_paddedSize(AVCodecContext* codec, int* width, int* height) const {
+        // Width and height including the padding the decoder writes to
+        int align[AV_NUM_DATA_POINTERS];
+        avcodec_align_dimensions2(codec, width, height, align);
+        *width = (*width + 2 * _alignment - 1) & ~(2 * _alignment - 1);
+        *height = (*height + 1) & ~1;
+    }
+
+    bool TexturePool::_create(Slot& slot) {
+        if (slot.texture)
+            SDL_DestroyTexture(slot.texture);
+
+        slot.texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, _width, _height);
+        slot.pixels = nullptr;
+        slot.locked = false;
+
+        if (!slot.texture) {
+            cerr << "Failed to create texture: " << SDL_GetError() << "\n";
+            return false;
+        }
+
+        slot.width = _width;
+        slot.height = _height;
+        return true;
+    }
+
+    bool TexturePool::_lock(Slot& slot) {
+        void* pixels;
+        int pitch;
+
+        if (SDL_LockTexture(slot.texture, nullptr, &pixels, &pitch) != 0) {
+            cerr << "Failed to lock texture: " << SDL_GetError() << "\n";
+            return false;
+        }
+
+        slot.pixels = static_cast<uint8_t*>(pixels);
+        slot.pitch = pitch;
+        slot.locked = true;
+
+        // SDL stores planar textures as Y, U and V planes with half the pitch for U and V, but
+        // neither documents nor guarantees the alignment of the memory
+        if (reinterpret_cast<uintptr_t>(slot.pixels) % _alignment != 0 || pitch % (2 * _alignment) != 0) {
+            cerr << "Texture memory is not aligned to " << _alignment << " bytes, copying frames instead\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    void TexturePool::refill() {
+        std::lock_guard lock(_mutex);
+
+        if (!_enabled)
+            return;
+
+        for (Slot& slot : _slots) {
+            if (slot.inUse || &slot == _presented)
+                continue;
+
+            // The frame size changed, replace the texture
+            if (slot.width != _width || slot.height != _height) {
+                if (!_create(slot)) {
+                    _enabled = false;
+                    return;
+                }
+            }
+
+            if (!slot.locked && !_lock(slot)) {
+                // Leave all frames to FFmpeg from now on
+                _enabled = false;
+                return;
+            }
+        }
+    }
+
+    SDL_Texture* TexturePool::present(const AVFrame* frame) {
+        std::lock_guard lock(_mutex);
+
+        for (Slot& slot : _slots) {
+            if (!slot.texture || slot.pixels != frame->data[0] || !slot.inUse)
+                continue;
+
+            // Uploads the texture, if the renderer requires it
+            if (slot.locked) {
+                SDL_UnlockTexture(slot.texture);
+                slot.locked = false;
+            }
+
+            _presented = &slot;
+            return slot.texture;
+        }
+
+        return nullptr;
+    }
+
+    size_t TexturePool::misses() const {
+        std::lock_guard lock(_mutex);
+        return _misses;
+    }
+
+    int TexturePool::_getBuffer(AVCodecContext* codec, AVFrame* frame, int flags) {
+        TexturePool* self = static_cast<TexturePool*>(codec->opaque);
+        std::unique_lock lock(self->_mutex);
+
+        if (!self->_enabled || frame->format != AV_PIX_FMT_YUV420P) {
+            lock.unlock();
+            return avcodec_default_get_buffer2(codec, frame, flags);
+        }
+
+        // Let the render thread reallocate the textures for the new frame size
+        int width = frame->width;
+        int height = frame->height;
+        self->_paddedSize(codec, &width, &height);
+
+        if (width != self->_width || height != self->_height) {
+            cout << "Resizing decoder textures to " << width << "x" << height << "\n";
+            self->_width = width;
+            self->_height = height;
+        }
+
+        auto it = std::find_if(self->_slots.begin(), self->_slots.end(), [self](const Slot& slot) {
+            return slot.locked && !slot.inUse && slot.width == self->_width && slot.height == self->_height;
+        });
+
+        if (it == self->_slots.end()) {
+            self->_misses++;
+            lock.unlock();
+            return avcodec_default_get_buffer2(codec, frame, flags);
+        }
+
+        Slot& slot = *it;
+        const size_t lumaSize = static_cast<size_t>(slot.pitch) * slot.height;
+        const size_t chromaSize = lumaSize / 4;
+
+        frame->buf[0] = av_buffer_create(slot.pixels, lumaSize + 2 * chromaSize, _release, &slot, 0);
+        if (!frame->buf[0])
+            return AVERROR(ENOMEM);
+
+        slot.inUse = true;
+        frame->data[0] = slot.pixels;
+        frame->data[1] = slot.pixels + lumaSize;
+        frame->data[2] = slot.pixels + lumaSize + chromaSize;
+        frame->linesize[0] = slot.pitch;
+        frame->linesize[1] = slot.pitch / 2;
+        frame->linesize[2] = slot.pitch / 2;
+        frame->extended_data = frame->data;
+        return 0;
+    }
+
+    void TexturePool::_release(void* opaque, [[maybe_unused]] uint8_t* data) {
+        Slot* slot = static_cast<Slot*>(opaque);
+        std::lock_guard lock(slot->pool->_mutex);
+        slot->inUse = false;
+    }
+} // namespace frontend
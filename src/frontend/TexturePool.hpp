@@ -0,0 +1,93 @@
+#ifndef FRONTEND_TEXTUREPOOL_HPP
+#define FRONTEND_TEXTUREPOOL_HPP
+
+#include <SDL_render.h>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace frontend {
+    // Lets the decoder write frames directly into the memory of locked streaming textures, so
+    // presenting a frame does not require SDL_UpdateYUVTexture() to copy it.
+    // Textures may only be used by the render thread. Hence, the render thread locks released
+    // textures in advance, see refill(), the decoder picks one in its get_buffer2() callback, and
+    // present() unlocks the texture of a decoded frame. Unlocking leaves the memory intact, so the
+    // decoder can still use the frame as reference. The texture is locked again once all
+    // references to the frame are gone.
+    // Frames are allocated by FFmpeg as usual, if no locked texture is available, or if the
+    // texture memory does not meet the decoder's alignment requirements.
+    // Only worth it for renderers that copy frames into their own memory on update, e.g. the
+    // software renderer. The OpenGL renderers upload directly from the decoder's buffers, so the
+    // pool is not used with them, also as their texture memory is not SIMD aligned.
+    // If the stream resolution changes, the pool adopts the new frame size and refill() replaces
+    // textures of the old size once the decoder released them.
+    class TexturePool {
+        public:
+            TexturePool();
+            TexturePool(const TexturePool&) = delete;
+            TexturePool& operator=(const TexturePool&) = delete;
+
+            // (Render thread) Create and lock textures for YUV420P frames of the given codec, and
+            // install the get_buffer2() callback. Textures are larger than the frame to satisfy
+            // the decoder's padding requirements, so render them with the source rectangle of
+            // the frame size.
+            // Must be called before decoding starts. The pool must outlive the codec and all
+            // of its frames.
+            bool init(SDL_Renderer* renderer, AVCodecContext* codec, int numTextures);
+
+            // Returns true if the renderer uploads YUV frames to the GPU directly from the given
+            // planes, i.e. SDL_UpdateYUVTexture() does not copy them on the CPU.
+            static bool uploadsDirectly(SDL_Renderer* renderer);
+
+            // (Render thread) Destroy the textures before the renderer is destroyed. Frames that
+            // were decoded into them must not be accessed anymore, only released.
+            void destroy();
+
+            // (Render thread) Lock textures released by the decoder, so it can use them again.
+            // Textures are recreated first, if the frame size changed.
+            void refill();
+
+            // (Render thread) If the frame was decoded into a texture, unlock and return it.
+            // Returns nullptr if the frame must be copied.
+            SDL_Texture* present(const AVFrame* frame);
+
+            // Number of frames that could not be decoded into a texture
+            size_t misses() const;
+
+        private:
+            struct Slot {
+                TexturePool* pool;
+                SDL_Texture* texture = nullptr;
+                int width = 0;
+                int height = 0;
+                uint8_t* pixels = nullptr;  // Valid while locked and until the next lock
+                int pitch = 0;
+                bool locked = false;
+                bool inUse = false;         // Handed out to the decoder and not yet released
+            };
+
+            static int _getBuffer(AVCodecContext* codec, AVFrame* frame, int flags);
+            static void _release(void* opaque, uint8_t* data);
+            bool _create(Slot& slot);
+            bool _lock(Slot& slot);
+
+            // Texture size required for frames of the given size, including padding
+            void _paddedSize(AVCodecContext* codec, int* width, int* height) const;
+
+        private:
+            mutable std::mutex _mutex;
+            std::vector<Slot> _slots;
+            const Slot* _presented;  // Stays unlocked while it is displayed
+            SDL_Renderer* _renderer;
+            int _width;              // Texture size for the current frame size
+            int _height;
+            size_t _alignment;
+            size_t _misses;
+            bool _enabled;
+    };
+}
+
+#endif
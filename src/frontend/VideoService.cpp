@@ -1,65 +1,450 @@
 #include "VideoService.hpp"
 #include "ui.hpp"
+#include "network/feedback.hpp"
+#include "util/clock.hpp"
+#include "util/histogram.hpp"
 #include <iostream>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#ifdef __linux__
+#   include <netinet/in.h>
+#endif
 
 namespace frontend {
-    VideoService::VideoService() : _avgFrametimeUs(0.0), _running(false) {}
+    // Minimum interval between loss reports. The streamer needs some time to react, during which
+    // frames are still corrupted.
+    constexpr auto loss_report_interval = std::chrono::milliseconds(100);
+
+    // Interval in which capture to decode latency statistics are printed
+    constexpr auto latency_stats_interval = std::chrono::seconds(10);
+
+    // Time to wait for the streamer to create the raw frame buffer
+    constexpr int raw_open_timeout_ms = 5000;
+
+    // Interval in which the raw frame loop checks whether it should stop
+    constexpr int raw_wait_timeout_ms = 200;
+
+    // Number of textures the decoder decodes into. Covers the reference frame, the displayed
+    // frame, the frame being decoded and some slack.
+    constexpr int texture_pool_size = 6;
+
+    // Interval in which texture upload statistics are printed
+    constexpr auto upload_stats_interval = std::chrono::seconds(10);
+
+    // Maximum number of packets waiting for the decoder. Beyond that, the reader stops reading
+    // and packets queue up in the socket buffer instead.
+    constexpr size_t max_queued_packets = 1024;
+
+
+    VideoService::VideoService() :
+        _lossSequence(0), _avgFrametimeUs(0.0), _running(false), _readerDone(false), _frameSequence(0),
+        _presentedTexture(nullptr), _copyTexture(nullptr), _presentedSequence(0), _presentedWidth(0),
+        _presentedHeight(0), _copyWidth(0), _copyHeight(0), _copyFormat(AV_PIX_FMT_NONE),
+        _unsupportedFormat(AV_PIX_FMT_NONE), _copiedBytes(0), _copiedFrames(0), _decodedInPlaceFrames(0),
+        _directUpload(false)
+    {}
 
-    bool VideoService::open(const char* url) {
+    bool VideoService::open(const char* url, bool fastStart) {
+        _timeline.mark(StartupTimeline::Start);
+
+        if (strncmp(url, "shmraw:", 7) == 0) {
+            if (!_raw.open(url + 7, raw_open_timeout_ms))
+                return false;
+
+            _timeline.mark(StartupTimeline::SocketOpen);
+            std::cout << "Opened raw frame input /" << url + 7 << ": " << _raw.width() << "x" << _raw.height() << "\n";
+            return true;
+        }
+        _stream.setTimeline(&_timeline);
+
+        // Only relevant if probing is required, i.e. when fast start is disabled or the SDP does
+        // not provide sufficient codec parameters.
         _stream.format()->max_analyze_duration = INT64_MAX - 1;
         _stream.format()->probesize = INT64_MAX - 1;
-        return _stream.open(url);
+        return _stream.open(url, !fastStart);
+    }
+
+    bool VideoService::setFeedback(const char* host, const char* port) {
+        if (!_feedback.connect(net::UDP, host, port)) {
+            std::cerr << "Failed to connect feedback channel to " << host << ":" << port << "\n";
+            return false;
+        }
+
+        std::cout << "Reporting video corruption to " << host << ":" << port << "\n";
+        return true;
+    }
+
+    void VideoService::setCatchUp(int pressureMs, int jumpMs) {
+        _catchUp.configure(pressureMs, jumpMs);
+    }
+
+    void VideoService::setThreadRole(const util::ThreadRole& role) {
+        _threadRole = role;
+    }
+
+    void VideoService::_reportLoss() {
+        auto now = std::chrono::steady_clock::now();
+
+        if (!_feedback.isValid() || now - _lastLossReport < loss_report_interval)
+            return;
+
+        net::LossReport report {
+            .magic = htonl(net::loss_report_magic),
+            .sequence = htonl(_lossSequence++)
+        };
+
+        _feedback.send(reinterpret_cast<const char*>(&report), sizeof(report));
+        _lastLossReport = now;
     }
 
     void VideoService::start(UI& ui) {
         _running = true;
-        _thread = std::thread(_process, this, std::ref(ui));
+
+        if (!_raw.isOpen())
+            _readerThread = std::thread(_read, this);
+
+        _thread = std::thread(_raw.isOpen() ? _processRaw : _process, this, std::ref(ui));
     }
 
     void VideoService::join() {
-        _running = false;
+        {
+            std::lock_guard<std::mutex> guard(_queueMutex);
+            _running = false;
+        }
+        _queueCond.notify_all();
         _thread.join();
+
+        // Returns after the next packet or when the stream ends
+        if (_readerThread.joinable())
+            _readerThread.join();
+
+        _clearQueue();
     }
 
     AVStream& VideoService::getStream() {
         return _stream;
     }
 
-    void VideoService::updateSDLTexture(SDL_Texture* tex) const {
+    int VideoService::width() const {
+        if (_presentedTexture)
+            return _presentedWidth;
+        return _raw.isOpen() ? _raw.width() : _stream.video()->width;
+    }
+
+    int VideoService::height() const {
+        if (_presentedTexture)
+            return _presentedHeight;
+        return _raw.isOpen() ? _raw.height() : _stream.video()->height;
+    }
+
+    bool VideoService::initTexturePool(SDL_Renderer* renderer) {
+        _nextUploadStats = std::chrono::steady_clock::now() + upload_stats_interval;
+
+        // Raw frames are read from shared memory, there is no decoder
+        if (_raw.isOpen())
+            return false;
+
+        return _texturePool.init(renderer, _stream.video(), texture_pool_size);
+    }
+
+    void VideoService::destroyTextures() {
+        std::lock_guard<std::mutex> guard(_frameMutex);
+        _texturePool.destroy();
+
+        if (_copyTexture)
+            SDL_DestroyTexture(_copyTexture);
+
+        _copyTexture = nullptr;
+        _presentedTexture = nullptr;
+    }
+
+    SDL_Texture* VideoService::updateSDLTexture(SDL_Renderer* renderer) {
         std::lock_guard<std::mutex> guard(_frameMutex);
         auto frame = _frame.get();
-        SDL_UpdateYUVTexture(tex, nullptr,
-                frame->data[0], frame->linesize[0],
-                frame->data[1], frame->linesize[1],
-                frame->data[2], frame->linesize[2]);
+
+        // Frames do not change while rendering, e.g. repeatedly with VSync or motion prediction
+        if (frame->data[0] && _frameSequence != _presentedSequence) {
+            _presentedSequence = _frameSequence;
+
+            if (SDL_Texture* decoded = _texturePool.present(frame)) {
+                _presentedTexture = decoded;
+                _decodedInPlaceFrames++;
+            } else {
+                _presentedTexture = _copyFrame(renderer, frame);
+            }
+
+            if (_presentedTexture && (frame->width != _presentedWidth || frame->height != _presentedHeight)) {
+                std::cout << "Video resolution changed to " << frame->width << "x" << frame->height << "\n";
+                _presentedWidth = frame->width;
+                _presentedHeight = frame->height;
+            }
+        }
+
+        // After presenting, so the texture of the current frame stays unlocked
+        _texturePool.refill();
+        _printUploadStats();
+        return _presentedTexture;
+    }
+
+    SDL_Texture* VideoService::_copyFrame(SDL_Renderer* renderer, const AVFrame* frame) {
+        Uint32 format;
+
+        switch (frame->format) {
+            case AV_PIX_FMT_YUV420P:
+            case AV_PIX_FMT_YUVJ420P:
+                format = SDL_PIXELFORMAT_IYUV;
+                break;
+
+            case AV_PIX_FMT_NV12:
+                format = SDL_PIXELFORMAT_NV12;
+                break;
+
+            default:
+                if (frame->format != _unsupportedFormat) {
+                    const char* name = av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame->format));
+                    std::cerr << "Unsupported pixel format: " << (name ? name : "unknown") << "\n";
+                    _unsupportedFormat = frame->format;
+                }
+                return nullptr;
+        }
+
+        if (!_copyTexture || frame->width != _copyWidth || frame->height != _copyHeight || frame->format != _copyFormat) {
+            if (_copyTexture)
+                SDL_DestroyTexture(_copyTexture);
+
+            _copyTexture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, frame->width, frame->height);
+
+            if (!_copyTexture) {
+                std::cerr << "Failed to create frame texture: " << SDL_GetError() << "\n";
+                return nullptr;
+            }
+
+            _copyWidth = frame->width;
+            _copyHeight = frame->height;
+            _copyFormat = frame->format;
+            _directUpload = TexturePool::uploadsDirectly(renderer);
+        }
+
+        if (format == SDL_PIXELFORMAT_NV12) {
+            SDL_UpdateNVTexture(_copyTexture, nullptr,
+                    frame->data[0], frame->linesize[0],
+                    frame->data[1], frame->linesize[1]);
+        } else {
+            SDL_UpdateYUVTexture(_copyTexture, nullptr,
+                    frame->data[0], frame->linesize[0],
+                    frame->data[1], frame->linesize[1],
+                    frame->data[2], frame->linesize[2]);
+        }
+
+        _copiedBytes += static_cast<uint64_t>(frame->width) * frame->height * 3 / 2;
+        _copiedFrames++;
+        return _copyTexture;
+    }
+
+    void VideoService::_printUploadStats() {
+        const auto now = std::chrono::steady_clock::now();
+
+        if (now < _nextUploadStats)
+            return;
+
+        const auto lastStats = _nextUploadStats - upload_stats_interval;
+        const float seconds = std::chrono::duration<float>(now - lastStats).count();
+        // Frames passed to a renderer that uploads directly are not copied on the CPU
+        std::cout << "Texture upload: " << (_directUpload ? "uploaded " : "copied ") << _copiedFrames
+                  << " frames" << (_directUpload ? " directly from decoder buffers, " : ", ")
+                  << _copiedBytes / seconds / (1024 * 1024) << " MB/s, decoded " << _decodedInPlaceFrames
+                  << " frames in place, " << _texturePool.misses() << " pool misses in total\n";
+
+        _copiedBytes = 0;
+        _copiedFrames = 0;
+        _decodedInPlaceFrames = 0;
+        _nextUploadStats = now + upload_stats_interval;
+    }
+
+
+    void VideoService::_read(VideoService* self) {
+        util::ScopedThreadRole role("video reader", self->_threadRole);
+        AVStream& stream = self->_stream;
+        AVPacket* packet = av_packet_alloc();
+
+        while (self->_running) {
+            if (!stream.readPacket(packet))
+                break;
+
+            // Shared memory read timeout
+            if (packet->size == 0)
+                continue;
+
+            std::unique_lock<std::mutex> lock(self->_queueMutex);
+            self->_queueCond.wait(lock, [self] { return self->_queue.size() < max_queued_packets || !self->_running; });
+
+            if (!self->_running)
+                break;
+
+            self->_queue.push_back({ av_packet_clone(packet), util::monotonicTimeUs() });
+            lock.unlock();
+            self->_queueCond.notify_all();
+            av_packet_unref(packet);
+        }
+
+        av_packet_free(&packet);
+        self->_stream.printReceiveStats();
+
+        {
+            std::lock_guard<std::mutex> guard(self->_queueMutex);
+            self->_readerDone = true;
+        }
+        self->_queueCond.notify_all();
+    }
+
+    bool VideoService::_popPacket(QueuedPacket* packet, size_t* queued) {
+        std::unique_lock<std::mutex> lock(_queueMutex);
+        _queueCond.wait(lock, [this] { return !_queue.empty() || _readerDone || !_running; });
+
+        if (_queue.empty() || !_running)
+            return false;
+
+        *packet = _queue.front();
+        _queue.pop_front();
+        *queued = _queue.size();
+        lock.unlock();
+
+        // The reader might wait for space
+        _queueCond.notify_all();
+        return true;
     }
 
+    size_t VideoService::_dropToKeyframe() {
+        std::lock_guard<std::mutex> guard(_queueMutex);
+        size_t keyframe = _queue.size();
+
+        for (size_t i = _queue.size(); i > 0; --i) {
+            if (_queue[i - 1].packet->flags & AV_PKT_FLAG_KEY) {
+                keyframe = i - 1;
+                break;
+            }
+        }
+
+        if (keyframe == _queue.size())
+            return 0;
+
+        for (size_t i = 0; i < keyframe; ++i)
+            av_packet_free(&_queue[i].packet);
+
+        _queue.erase(_queue.begin(), _queue.begin() + keyframe);
+        _queueCond.notify_all();
+        return keyframe;
+    }
+
+    void VideoService::_clearQueue() {
+        std::lock_guard<std::mutex> guard(_queueMutex);
+
+        for (auto& queued : _queue)
+            av_packet_free(&queued.packet);
+
+        _queue.clear();
+    }
 
     void VideoService::_process(VideoService* self, UI& ui) {
         using std::chrono::high_resolution_clock;
         using std::chrono::duration_cast;
         using std::chrono::microseconds;
+        using Action = CatchUpPolicy::Action;
 
+        util::ScopedThreadRole role("video decoder", self->_threadRole);
         AVStream& stream = self->_stream;
         auto video = stream.video();
         auto frame = self->_frame.get();
 
         size_t nFrames = 0;
 
+        // With shared memory transport, frame timestamps are capture times on the same clock
+        util::Histogram latency;
+        int64_t lastPts = AV_NOPTS_VALUE;
+        auto nextLatencyStats = high_resolution_clock::now() + latency_stats_interval;
+
+        // Time packets waited for the decoder
+        util::Histogram queueDelay;
+        bool decodingFast = false;
+        size_t fastPackets = 0;
+        size_t jumps = 0;
+        size_t droppedPackets = 0;
+
+        QueuedPacket queued;
+        size_t queueSize = 0;
+
         while (self->_running) {
+            if (!self->_popPacket(&queued, &queueSize))
+                break;
+
             auto begin = high_resolution_clock::now();
+            const int64_t ageUs = util::monotonicTimeUs() - queued.receiveTimeUs;
+            queueDelay.add(ageUs);
 
-            if (!stream.readPacket())
-                break;
+            Action action = Action::Decode;
+            if (self->_catchUp.isEnabled())
+                action = self->_catchUp.update(ageUs, queueSize);
+
+            if (action == Action::Jump && !(queued.packet->flags & AV_PKT_FLAG_KEY)) {
+                if (size_t dropped = self->_dropToKeyframe()) {
+                    // Frames buffered by the decoder are just as stale
+                    av_packet_free(&queued.packet);
+                    avcodec_flush_buffers(video);
+                    droppedPackets += dropped + 1;
+                    jumps++;
+                    continue;
+                }
+
+                // Ask the streamer for a keyframe or recovery point to jump to, and decode as
+                // fast as possible in the meantime
+                self->_reportLoss();
+            }
+
+            const bool fast = action != Action::Decode;
+            if (fast != decodingFast) {
+                video->skip_frame = fast ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+                video->skip_loop_filter = fast ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+                decodingFast = fast;
+            }
+            if (fast)
+                fastPackets++;
+
+            stream.decodePacket(queued.packet);
+            av_packet_free(&queued.packet);
 
             {
                 std::lock_guard<std::mutex> guard(self->_frameMutex);
 
                 if (!stream.retrieveFrame(video, frame))
                     break;
+
+                if (frame->data[0])
+                    self->_frameSequence++;
             }
 
+            if (frame->data[0])
+                self->_timeline.mark(StartupTimeline::FirstFrame);
+
+            if ((frame->flags & AV_FRAME_FLAG_CORRUPT) || frame->decode_error_flags)
+                self->_reportLoss();
+
             auto end = high_resolution_clock::now();
+
+            if (stream.isSharedMemory() && frame->data[0] && frame->pts != lastPts) {
+                latency.add(util::monotonicTimeUs() - frame->pts);
+                lastPts = frame->pts;
+
+                if (end >= nextLatencyStats) {
+                    latency.print(std::cout, "Capture to decode latency");
+                    latency.reset();
+                    nextLatencyStats += latency_stats_interval;
+                }
+            }
+
             auto deltaUs = duration_cast<microseconds>(end - begin).count();
             nFrames++;
             self->_avgFrametimeUs += (deltaUs - self->_avgFrametimeUs) / nFrames;
@@ -67,9 +452,82 @@ namespace frontend {
             // Notify the main loop to refresh
             ui.notifyTextureUpdate();
         }
+
+        if (latency.count() > 0)
+            latency.print(std::cout, "Capture to decode latency");
+
+        if (queueDelay.count() > 0)
+            queueDelay.print(std::cout, "Decoder queue delay");
+
+        if (self->_catchUp.isEnabled()) {
+            std::cout << "Catch-up: decoded " << fastPackets << " packets fast, jumped " << jumps
+                      << " times, dropped " << droppedPackets << " packets\n";
+        }
+    }
+
+    void VideoService::_processRaw(VideoService* self, UI& ui) {
+        util::ScopedThreadRole role("video", self->_threadRole);
+        net::ShmFrameBuffer& raw = self->_raw;
+        auto frame = self->_frame.get();
+
+        util::Histogram latency;
+        auto nextLatencyStats = std::chrono::steady_clock::now() + latency_stats_interval;
+
+        // The frame references the front buffer in shared memory, so the texture upload reads the
+        // streamer's color conversion output in place
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = raw.width();
+        frame->height = raw.height();
+        for (int i = 0; i < 3; ++i)
+            frame->linesize[i] = raw.linesize(i);
+
+        while (self->_running) {
+            if (!raw.wait(raw_wait_timeout_ms)) {
+                if (raw.isClosed())
+                    break;
+                continue;
+            }
+
+            {
+                // The previous front buffer is handed back to the streamer, so it must not be
+                // uploaded concurrently
+                std::lock_guard<std::mutex> guard(self->_frameMutex);
+                const uint8_t* planes[3];
+
+                raw.acquire();
+                raw.frontBuffer(planes);
+                for (int i = 0; i < 3; ++i)
+                    frame->data[i] = const_cast<uint8_t*>(planes[i]);
+                frame->pts = raw.frontTimeUs();
+                self->_frameSequence++;
+            }
+
+            self->_timeline.mark(StartupTimeline::FirstFrame);
+            latency.add(util::monotonicTimeUs() - frame->pts);
+
+            if (std::chrono::steady_clock::now() >= nextLatencyStats) {
+                latency.print(std::cout, "Capture to frame latency");
+                latency.reset();
+                nextLatencyStats += latency_stats_interval;
+            }
+
+            ui.notifyTextureUpdate();
+        }
+
+        if (latency.count() > 0)
+            latency.print(std::cout, "Capture to frame latency");
+
+        // Do not reference the shared memory after it was unmapped
+        std::lock_guard<std::mutex> guard(self->_frameMutex);
+        for (int i = 0; i < 3; ++i)
+            frame->data[i] = nullptr;
     }
 
     float VideoService::getAvgFrametime() const {
         return _avgFrametimeUs;
     }
+
+    StartupTimeline& VideoService::getTimeline() {
+        return _timeline;
+    }
 } // namespace frontend
@@ -2,8 +2,17 @@
 #define FRONTEND_VIDEOSERVICE_HPP
 
 #include <SDL_render.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <thread>
 #include "av.hpp"
+#include "CatchUpPolicy.hpp"
+#include "StartupTimeline.hpp"
+#include "TexturePool.hpp"
+#include "network/socket.hpp"
+#include "network/shmframebuffer.hpp"
+#include "util/thread_role.hpp"
 
 namespace frontend {
     class UI;
@@ -12,26 +21,118 @@ namespace frontend {
         public:
             VideoService();
 
-            bool open(const char* url);
+            // If fastStart is true, skip stream probing and open the decoder immediately using the
+            // codec parameters provided by the SDP.
+            // If the URL is shmraw:<name>, uncompressed frames are read from the shared memory
+            // triple buffer of a co-located streamer instead, i.e. without decoding.
+            bool open(const char* url, bool fastStart = false);
             void start(UI& ui);
+
+            // Report corrupted frames, e.g. due to packet loss, to the streamer listening on the
+            // given UDP address, so it can refresh the picture. See net::LossReport.
+            bool setFeedback(const char* host, const char* port);
+
+            // Catch up when packets queue up in front of the decoder. See CatchUpPolicy.
+            // Call before start().
+            void setCatchUp(int pressureMs, int jumpMs);
+
+            // Placement of the reader and decoder threads. Call before start().
+            void setThreadRole(const util::ThreadRole& role);
+
             void join();
             AVStream& getStream();
 
-            // (Thread-safe) Update SDL texture with the contents of the current video frame.
-            void updateSDLTexture(SDL_Texture* tex) const;
+            // (Render thread) Size of the frame returned by updateSDLTexture(), or the initial
+            // stream size if there is none yet. Changes with the stream resolution.
+            int width() const;
+            int height() const;
+
+            // (Render thread) Let the decoder write frames directly into streaming textures, so
+            // they need not be copied by updateSDLTexture(). Call before start().
+            // Returns false if frames are copied instead.
+            bool initTexturePool(SDL_Renderer* renderer);
+
+            // (Render thread) Destroy all textures before destroying the renderer.
+            void destroyTextures();
+
+            // (Render thread) Returns the texture containing the current video frame, i.e. either
+            // the texture it was decoded into or a texture it was copied into. The frame is only
+            // copied once, into a texture that is reallocated when the frame size or pixel format
+            // changes. Render the texture with the source rectangle (0, 0, width(), height()).
+            // Returns nullptr if there is no presentable frame yet.
+            SDL_Texture* updateSDLTexture(SDL_Renderer* renderer);
 
             float getAvgFrametime() const;
+            StartupTimeline& getTimeline();
+
+          private:
+            struct QueuedPacket {
+                AVPacket* packet;
+                int64_t receiveTimeUs;
+            };
 
           private:
+            static void _read(VideoService* self);
             static void _process(VideoService* self, UI& ui);
+            static void _processRaw(VideoService* self, UI& ui);
+
+            // Wait for the next packet. Returns false when the stream ended or the service stops.
+            // queued is set to the number of packets still waiting.
+            bool _popPacket(QueuedPacket* packet, size_t* queued);
+
+            // Drop all queued packets before the newest keyframe. Returns the number of dropped
+            // packets, or 0 if there is no keyframe in the queue.
+            size_t _dropToKeyframe();
+            void _clearQueue();
+
+            void _reportLoss();
+            void _printUploadStats();
+
+            // Copy the frame into _copyTexture, reallocating it if necessary
+            SDL_Texture* _copyFrame(SDL_Renderer* renderer, const AVFrame* frame);
 
         private:
+            // Frames may reference the pool's memory, so it is declared first and destroyed last
+            TexturePool _texturePool;
             Frame _frame;
             std::thread _thread;
+            std::thread _readerThread;
             mutable std::mutex _frameMutex;
             AVStream _stream;
+            net::ShmFrameBuffer _raw;
+            StartupTimeline _timeline;
+            net::Socket _feedback;
+            uint32_t _lossSequence;
+            std::chrono::steady_clock::time_point _lastLossReport;
             float _avgFrametimeUs;
             bool _running;
+
+            // Packets read from the network, waiting to be decoded
+            std::mutex _queueMutex;
+            std::condition_variable _queueCond;
+            std::deque<QueuedPacket> _queue;
+            bool _readerDone;
+            CatchUpPolicy _catchUp;
+            util::ThreadRole _threadRole;
+
+            // Incremented with every new frame, guarded by _frameMutex
+            uint64_t _frameSequence;
+
+            // Render thread only
+            SDL_Texture* _presentedTexture;
+            SDL_Texture* _copyTexture;
+            uint64_t _presentedSequence;
+            int _presentedWidth;
+            int _presentedHeight;
+            int _copyWidth;
+            int _copyHeight;
+            int _copyFormat;
+            int _unsupportedFormat;
+            uint64_t _copiedBytes;
+            size_t _copiedFrames;
+            size_t _decodedInPlaceFrames;
+            bool _directUpload;             // The renderer uploads frames without copying them
+            std::chrono::steady_clock::time_point _nextUploadStats;
     };
 }
 
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
 #include "av.hpp"
 
 // Based on https://github.com/leandromoreira/ffmpeg-libav-tutorial
@@ -11,7 +14,14 @@ using std::endl;
 
 
 namespace frontend {
-    AVStream::AVStream() : _video(nullptr), _audio(nullptr), _packet(nullptr), _videoIdx(-1), _audioIdx(-1) {
+    // Time to wait for the streamer to create the shared memory ring
+    constexpr int shm_open_timeout_ms = 5000;
+
+    // Interval in which readPacket() returns when no packets arrive through shared memory
+    constexpr int shm_read_timeout_ms = 200;
+
+
+    AVStream::AVStream() : _video(nullptr), _audio(nullptr), _packet(nullptr), _timeline(nullptr), _decoderThreads(0), _videoIdx(-1), _audioIdx(-1), _batchReceive(false) {
         _formatCtx = avformat_alloc_context();
         _packet = av_packet_alloc();
     }
@@ -26,7 +36,10 @@ namespace frontend {
         av_packet_free(&_packet);
     }
 
-    bool AVStream::open(const char *inputPath) {
+    bool AVStream::open(const char *inputPath, bool probe) {
+        if (strncmp(inputPath, "shm:", 4) == 0)
+            return _openShm(inputPath + 4);
+
         _formatCtx->flags = AVFMT_FLAG_NOBUFFER | AVFMT_FLAG_FLUSH_PACKETS;
         AVDictionary *options = nullptr;
         av_dict_set(&options, "protocol_whitelist", "file,udp,rtp", 0);
@@ -42,12 +55,20 @@ namespace frontend {
             return false;
         }
 
+        if (_timeline)
+            _timeline->mark(StartupTimeline::SocketOpen);
+
         cout << "Opened input " << inputPath << endl;
         if (options)
             av_dict_free(&options);
         cout << "Format: " << _formatCtx->iformat->name << endl;
 
-        if (avformat_find_stream_info(_formatCtx, nullptr) < 0) {
+        if (!probe && !_hasCodecParameters()) {
+            cout << "Insufficient codec parameters, falling back to stream probing\n";
+            probe = true;
+        }
+
+        if (probe && avformat_find_stream_info(_formatCtx, nullptr) < 0) {
             cerr << "Cannot find stream info\n";
             return false;
         }
@@ -77,31 +98,180 @@ namespace frontend {
             cout << "\tCodec: " << codec->long_name << " (" << codec->id << ")" << endl;
             cout << "\tBitrate: " << params->bit_rate << endl;
             cout << "\tChannels: " << params->ch_layout.nb_channels << endl;
-            cout << "\tSample format: " << av_get_sample_fmt_name(static_cast<AVSampleFormat>(params->format)) << endl;
+            if (params->format != AV_SAMPLE_FMT_NONE)
+                cout << "\tSample format: " << av_get_sample_fmt_name(static_cast<AVSampleFormat>(params->format)) << endl;
             cout << "\tSample rate: " << params->sample_rate << endl;
             _audio = _create_codec(codec, params);
         }
 
+        if (_timeline)
+            _timeline->mark(StartupTimeline::DecoderOpen);
+
+        if (_batchReceive) {
+            if (strcmp(_formatCtx->iformat->name, "sdp") != 0 || _audioIdx >= 0 || !_video
+                    || _video->codec_id != AV_CODEC_ID_H264) {
+                cout << "Batch receive requires an SDP with a single H.264 stream, using libavformat\n";
+            } else if (!_openBatchReceive(inputPath)) {
+                return false;
+            }
+        }
+
         return true;
     }
 
-    bool AVStream::readPacket() {
-        if (av_read_frame(_formatCtx, _packet) < 0)
+    bool AVStream::_openBatchReceive(const char *sdpPath) {
+        std::ifstream file(sdpPath);
+        std::string line, port;
+
+        // m=video <port> RTP/AVP <payload type>
+        while (std::getline(file, line)) {
+            if (line.compare(0, 8, "m=video ") == 0) {
+                std::istringstream(line.substr(8)) >> port;
+                break;
+            }
+        }
+
+        if (port.empty()) {
+            cerr << "No video port in " << sdpPath << endl;
+            return false;
+        }
+
+        // The decoder is open, so libavformat can release the port. Packets arriving until the
+        // receiver is listening are lost, the decoder starts at the next keyframe.
+        avformat_close_input(&_formatCtx);
+        return _rtp.open(port.c_str());
+    }
+
+    bool AVStream::_openShm(const char *name) {
+        if (!_shm.open(name, shm_open_timeout_ms))
+            return false;
+
+        if (_timeline)
+            _timeline->mark(StartupTimeline::SocketOpen);
+
+        net::ShmStreamInfo info;
+        if (_shm.metadataSize() >= sizeof(info))
+            memcpy(&info, _shm.metadata(), sizeof(info));
+
+        if (_shm.metadataSize() < sizeof(info) || _shm.metadataSize() < sizeof(info) + info.extradataSize) {
+            cerr << "Invalid stream info in shared memory\n";
+            return false;
+        }
+
+        const AVCodec *codec = avcodec_find_decoder(static_cast<AVCodecID>(info.codecId));
+        if (!codec) {
+            cerr << "Unsupported codec in shared memory stream\n";
             return false;
+        }
+
+        cout << "Opened shared memory input /" << name << endl;
+        cout << "Found video stream:\n";
+        cout << "\tCodec: " << codec->long_name << " (" << codec->id << ")" << endl;
+        cout << "\tResolution: " << info.width << "x" << info.height << endl;
+
+        AVCodecParameters *params = avcodec_parameters_alloc();
+        params->codec_type = AVMEDIA_TYPE_VIDEO;
+        params->codec_id = codec->id;
+        params->width = info.width;
+        params->height = info.height;
+        params->extradata = static_cast<uint8_t*>(av_mallocz(info.extradataSize + AV_INPUT_BUFFER_PADDING_SIZE));
+        params->extradata_size = info.extradataSize;
+        memcpy(params->extradata, _shm.metadata() + sizeof(info), info.extradataSize);
+
+        _video = _create_codec(codec, params);
+        _videoIdx = 0;
+        avcodec_parameters_free(&params);
+
+        if (_timeline)
+            _timeline->mark(StartupTimeline::DecoderOpen);
 
-        if (_packet->stream_index == _videoIdx)
-            avcodec_send_packet(_video, _packet);
-        else if (_packet->stream_index == _audioIdx)
-            avcodec_send_packet(_audio, _packet);
+        return _video != nullptr;
+    }
+
+    bool AVStream::_readShmPacket(AVPacket* packet) {
+        net::ShmRing::Record record;
+
+        if (!_shm.read(&record, shm_read_timeout_ms))
+            return false;
 
+        // Copy the packet, so the streamer can reuse the space while it is being decoded
+        const bool allocated = av_new_packet(packet, record.size) == 0;
+
+        if (allocated) {
+            memcpy(packet->data, record.data, record.size);
+            packet->flags = record.flags;
+            packet->pts = packet->dts = record.timeUs;
+            packet->stream_index = _videoIdx;
+        }
+
+        _shm.release();
+        return allocated;
+    }
+
+    bool AVStream::readPacket() {
+        if (!readPacket(_packet))
+            return false;
+
+        decodePacket(_packet);
         av_packet_unref(_packet);
         return true;
     }
 
+    bool AVStream::readPacket(AVPacket* packet) {
+        if (_shm.isOpen()) {
+            if (!_readShmPacket(packet))
+                return !_shm.isClosed();
+        } else if (_rtp.isOpen()) {
+            if (!_rtp.read(packet, shm_read_timeout_ms))
+                return true;
+            packet->stream_index = _videoIdx;
+        } else if (av_read_frame(_formatCtx, packet) < 0)
+            return false;
+
+        if (_timeline && packet->stream_index == _videoIdx) [[unlikely]] {
+            _timeline->mark(StartupTimeline::FirstPacket);
+            if (packet->flags & AV_PKT_FLAG_KEY)
+                _timeline->mark(StartupTimeline::FirstKeyframe);
+        }
+
+        return true;
+    }
+
+    void AVStream::decodePacket(const AVPacket* packet) {
+        // An empty packet would start draining the decoder
+        if (packet->size == 0)
+            return;
+
+        if (packet->stream_index == _videoIdx)
+            avcodec_send_packet(_video, packet);
+        else if (packet->stream_index == _audioIdx)
+            avcodec_send_packet(_audio, packet);
+    }
+
     bool AVStream::retrieveFrame(AVCodecContext* codec, AVFrame* frame) const {
         return avcodec_receive_frame(codec, frame) != AVERROR_EOF;
     }
 
+    bool AVStream::_hasCodecParameters() const {
+        for (unsigned int i = 0; i < _formatCtx->nb_streams; ++i) {
+            const AVCodecParameters *params = _formatCtx->streams[i]->codecpar;
+
+            if (params->codec_id == AV_CODEC_ID_NONE)
+                return false;
+
+            // Video requires the resolution (a=framesize) and parameter sets (sprop-parameter-sets)
+            if (params->codec_type == AVMEDIA_TYPE_VIDEO
+                    && (params->width <= 0 || params->height <= 0 || params->extradata_size <= 0))
+                return false;
+
+            if (params->codec_type == AVMEDIA_TYPE_AUDIO
+                    && (params->sample_rate <= 0 || params->ch_layout.nb_channels <= 0))
+                return false;
+        }
+
+        return _formatCtx->nb_streams > 0;
+    }
+
     AVCodecContext *AVStream::_create_codec(const AVCodec *codec, const AVCodecParameters *params) {
         AVCodecContext *codecContext = avcodec_alloc_context3(codec);
 
@@ -116,8 +286,8 @@ namespace frontend {
             return nullptr;
         }
 
-        // Set codec to automatically determine how many threads suits best for the decoding job
-        codecContext->thread_count = 0;
+        // By default, let the codec determine how many threads suit best for the decoding job
+        codecContext->thread_count = _decoderThreads;
         codecContext->thread_type = FF_THREAD_SLICE;
         codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
         codecContext->flags |= AV_CODEC_FLAG2_FAST;
@@ -142,11 +312,11 @@ namespace frontend {
         return codecContext;
     }
 
-    AVCodecContext* AVStream::audio() {
+    AVCodecContext* AVStream::audio() const {
         return _audio;
     }
 
-    AVCodecContext* AVStream::video() {
+    AVCodecContext* AVStream::video() const {
         return _video;
     }
 
@@ -154,6 +324,27 @@ namespace frontend {
         return _formatCtx;
     }
 
+    bool AVStream::isSharedMemory() const {
+        return _shm.isOpen();
+    }
+
+    void AVStream::setDecoderThreads(int threads) {
+        _decoderThreads = threads;
+    }
+
+    void AVStream::setTimeline(StartupTimeline* timeline) {
+        _timeline = timeline;
+    }
+
+    void AVStream::setBatchReceive(bool enabled) {
+        _batchReceive = enabled;
+    }
+
+    void AVStream::printReceiveStats() const {
+        if (_rtp.isOpen())
+            _rtp.printStats();
+    }
+
 
     Frame::Frame() {
         _frame = av_frame_alloc();
@@ -6,6 +6,10 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 
+#include "RtpReceiver.hpp"
+#include "StartupTimeline.hpp"
+#include "network/shmring.hpp"
+
 
 namespace frontend {
     // Wrapper around AVFrame with automatic allocation and deallocation.
@@ -28,23 +32,72 @@ namespace frontend {
             AVStream(AVStream &&) = delete;
             ~AVStream();
 
-            bool open(const char *inputPath);
+            // Open the given input. If probe is false, stream probing is skipped and decoders are
+            // opened immediately using the codec parameters provided by the input, e.g. the SDP's
+            // sprop-parameter-sets and framesize attributes. Falls back to probing if they are
+            // insufficient.
+            // If the path is shm:<name>, the video stream is read from the shared memory ring
+            // of a co-located streamer instead. See streamer::ShmOutput.
+            bool open(const char *inputPath, bool probe = true);
+
+            // Read and decode the next packet. Returns false at the end of the stream.
+            // When reading from shared memory, also returns true on timeout without decoding
+            // anything, so the caller can check whether to stop.
             bool readPacket();
+
+            // Read the next packet without decoding it. Returns false at the end of the stream.
+            // When reading from shared memory, also returns true on timeout with an empty packet.
+            // The packet must be unreferenced by the caller.
+            bool readPacket(AVPacket* packet);
+
+            // Send a packet returned by readPacket(AVPacket*) to its decoder. Empty packets are
+            // ignored.
+            void decodePacket(const AVPacket* packet);
             bool retrieveFrame(AVCodecContext* codec, AVFrame* frame) const;
-            AVCodecContext* video();
-            AVCodecContext* audio();
+            AVCodecContext* video() const;
+            AVCodecContext* audio() const;
             AVFormatContext* format();
 
+            // Returns true if the video stream is read from shared memory. In this case, packet
+            // and frame timestamps are the capture time in microseconds, see util::monotonicTimeUs().
+            bool isSharedMemory() const;
+
+            // Number of decoder threads for streams opened afterwards. 0 (default) lets the codec
+            // decide. Threads decode slices of the same frame, so they do not add latency.
+            void setDecoderThreads(int threads);
+
+            // Record first packet and first keyframe of the video stream in the given timeline.
+            void setTimeline(StartupTimeline* timeline);
+
+            // Receive the video stream of an SDP input with RtpReceiver instead of libavformat,
+            // i.e. in batches. Only applies to single H.264 streams, libavformat is only used
+            // to open the decoder then. Call before open().
+            void setBatchReceive(bool enabled);
+
+            // Print receive statistics, if the stream is received in batches
+            void printReceiveStats() const;
+
           private:
-            static AVCodecContext *_create_codec(const AVCodec *codec, const AVCodecParameters *params);
+            AVCodecContext *_create_codec(const AVCodec *codec, const AVCodecParameters *params);
+            bool _hasCodecParameters() const;
+            bool _openShm(const char *name);
+            bool _readShmPacket(AVPacket* packet);
+
+            // Replace libavformat's input by an RtpReceiver on the video port of the SDP
+            bool _openBatchReceive(const char *sdpPath);
 
         private:
             AVFormatContext* _formatCtx;
             AVCodecContext* _video;
             AVCodecContext* _audio;
             AVPacket* _packet;
+            net::ShmRing _shm;
+            RtpReceiver _rtp;
+            StartupTimeline* _timeline;
+            int _decoderThreads;
             int _videoIdx;
             int _audioIdx;
+            bool _batchReceive;
     };
 }
 
@@ -1,64 +1,205 @@
 #include <iostream>
+#include <cstdio>
+#include <string>
 #include "ui.hpp"
 #include "frontend/VideoService.hpp"
 #include "frontend/AudioService.hpp"
+#include "frontend/CursorService.hpp"
+#include "frontend/InputService.hpp"
+#include "frontend/RawMouse.hpp"
+#include "util/config.hpp"
+#include "util/thread_role.hpp"
 
 using std::cout;
 using std::cerr;
 
 
 void help() {
-    cout << "Usage: frontend <video filename/URL> <audio filename/URL> <syncinput IP> <syncinput port> <tcp|udp> [mouse-sensitivity] [vsync]\n";
-    cout << "Live-streams the given video and audio streams while transmitting inputs to the given syncinput server.";
+    cout << "Usage: frontend <video filename/URL> <audio filename/URL> <syncinput IP> <syncinput port> <tcp|udp> [mouse-sensitivity] [flags...]\n";
+    cout << "       frontend --config=<file> [flags...]\n";
+    cout << "Live-streams the given video and audio streams while transmitting inputs to the given syncinput server.\n";
+    cout << "All options can also be set in the config file, either globally or in its [frontend] section. The positional arguments correspond to the options video, audio, syncinput-host, syncinput-port, protocol and mouse-sensitivity.\n";
+    cout << "Flags are given as key=value, --key=value, key (true) or no-key (false). They override the config file.\n";
+    cout << "Flags:\n";
+    cout << "\tconfig=<file>: Read options from the given config file\n";
+    cout << "\tvsync: Enable VSync\n";
+    cout << "\tvsync-method=<method>: Rendering technique with VSync: on-frame, predict or naive. Default: on-frame\n";
+    cout << "\tinput-buffer-us=<us>: With VSync, collect inputs for the given time before sending them. Default: 0\n";
+    cout << "\tfaststart: Skip stream probing and use the codec parameters provided by the SDP\n";
+    cout << "\tdecoder-threads=<n>: Number of decoder threads. Default: 0 (automatic)\n";
+    cout << "\tudp-batch: Receive RTP video in batches with recvmmsg and UDP receive coalescing instead of one datagram per call. Requires an SDP with a single H.264 stream.\n";
+    cout << "\taudio-queue-bytes=<n>: Clear the audio queue when it grows beyond the given size. Default: 3072\n";
+    cout << "\tno-coalesce: Do not merge mouse motion events that queue up while the input connection is backpressured\n";
+    cout << "\traw-mouse[=<device>]: Read mouse motion directly from the given evdev device, or the first mouse found\n";
+    cout << "\tfeedback=<ip>:<port>: Report video corruption to the streamer at the given address\n";
+    cout << "\trecord-input=<file>: Record all sent input events to the given file. See also inputreplay.\n";
+    cout << "\tpredict=<pixels per count>,<latency ms>: Shift the image according to mouse motion that is not yet reflected in the video\n";
+    cout << "\tno-zero-copy: Copy decoded frames into a texture instead of decoding into texture memory. Only affects renderers that copy frames on update, e.g. the software renderer. OpenGL uploads directly from decoder buffers either way.\n";
+    cout << "\tcursor-port=<port>: Receive the cursor from syncinput on this TCP port and draw it locally\n";
+    cout << "\tthread-video=<role>, thread-audio=<role>, thread-render=<role>, thread-events=<role>: Pin the video, audio, render and event threads and set their scheduling, given as <cores>[:<policy>[:<priority>]], e.g. 2-3:fifo:50. Policy is one of other, fifo and rr.\n";
+    cout << "\tmlock: Lock all memory to avoid page faults\n";
+    cout << "\tcatch-up=<pressure ms>,<jump ms>: Decode faster when video packets waited longer than the first value, and skip to the newest keyframe when they waited longer than the second. 0,0 disables catch-up. Default: 50,250\n";
 }
 
 
 int main(int argc, char *argv[]) {
-    if (argc < 6) {
+    util::Config config("frontend");
+    if (!config.parseArgs(argc, argv, { "video", "audio", "syncinput-host", "syncinput-port", "protocol", "mouse-sensitivity" }))
+        return 1;
+
+    if (config.has("help")) {
         help();
-        cerr << "Missing arguments\n";
+        return 0;
+    }
+
+    if (const char* key = config.missing({ "video", "audio", "syncinput-host", "syncinput-port", "protocol" })) {
+        help();
+        cerr << "Missing option: " << key << "\n";
+        return 1;
+    }
+
+    const std::string videoURL = config.getString("video");
+    const std::string audioURL = config.getString("audio");
+    const std::string syncinputIP = config.getString("syncinput-host");
+    const std::string syncinputPort = config.getString("syncinput-port");
+    net::SocketType protocol = net::parseProtocol(config.getString("protocol").c_str());
+    float mouseSensitivity = config.getFloat("mouse-sensitivity", 1.0);
+    bool useVsync = config.getBool("vsync", false);
+    bool fastStart = config.getBool("faststart", false);
+    bool coalesceMotion = config.getBool("coalesce", true);
+    const std::string rawMouseOption = config.getString("raw-mouse", "false");
+    const std::string feedback = config.getString("feedback");
+    const std::string inputRecordPath = config.getString("record-input");
+    const std::string predict = config.getString("predict");
+    const std::string cursorPort = config.getString("cursor-port");
+    const bool zeroCopy = config.getBool("zero-copy", true);
+    const std::string catchUp = config.getString("catch-up", "50,250");
+    const bool lockMemory = config.getBool("mlock", false);
+    const int inputBufferUs = config.getInt("input-buffer-us", 0);
+    const int decoderThreads = config.getInt("decoder-threads", 0);
+    const bool batchReceive = config.getBool("udp-batch", false);
+    const int audioQueueBytes = config.getInt("audio-queue-bytes", 3072);
+    const std::string vsyncMethodName = config.getString("vsync-method", "on-frame");
+    frontend::VsyncMethod vsyncMethod = frontend::VsyncMethod::OnFrame;
+    std::string feedbackHost, feedbackPort;
+    float predictPixelsPerCount = 0;
+    int predictLatencyMs = 0;
+    int catchUpPressureMs = 0;
+    int catchUpJumpMs = 0;
+
+    if (!frontend::parseVsyncMethod(vsyncMethodName.c_str(), &vsyncMethod)) {
+        cerr << "Unknown VSync method: " << vsyncMethodName << "\n";
         return 1;
     }
 
-    const char* videoURL = argv[1];
-    const char* audioURL = argv[2];
-    const char* syncinputIP = argv[3];
-    const char* syncinputPort = argv[4];
-    float mouseSensitivity = 1.0;
-    net::SocketType protocol = net::parseProtocol(argv[5]);
-    bool useVsync = false;
+    // raw-mouse is either a boolean, auto or a device path
+    const bool useRawMouse = rawMouseOption != "false";
+    const std::string rawMouseDevice = rawMouseOption == "true" || rawMouseOption == "auto" ? "" : rawMouseOption;
 
-    if (argc > 6) {
-        mouseSensitivity = std::atof(argv[6]);
+    if (!feedback.empty()) {
+        size_t colon = feedback.rfind(':');
+        if (colon == std::string::npos) {
+            cerr << "Invalid feedback address: " << feedback << "\n";
+            return 1;
+        }
+        feedbackHost = feedback.substr(0, colon);
+        feedbackPort = feedback.substr(colon + 1);
+    }
 
-        if (argc > 7 && strcmp(argv[7], "vsync") == 0) {
-            cout << "VSync enabled\n";
-            useVsync = true;
+    if (!predict.empty()) {
+        if (sscanf(predict.c_str(), "%f,%d", &predictPixelsPerCount, &predictLatencyMs) != 2) {
+            cerr << "Invalid prediction parameters: " << predict << "\n";
+            return 1;
         }
+        cout << "Motion prediction enabled: " << predictPixelsPerCount << " px/count, " << predictLatencyMs << "ms\n";
+    }
+
+    if (sscanf(catchUp.c_str(), "%d,%d", &catchUpPressureMs, &catchUpJumpMs) != 2) {
+        cerr << "Invalid catch-up parameters: " << catchUp << "\n";
+        return 1;
+    }
+
+    util::ThreadRole videoRole, audioRole, renderRole, eventsRole;
+    for (auto [key, role] : { std::pair { "thread-video", &videoRole }, { "thread-audio", &audioRole },
+                              { "thread-render", &renderRole }, { "thread-events", &eventsRole } }) {
+        if (config.has(key) && !util::parseThreadRole(config.getString(key), role))
+            return 1;
     }
 
+    if (!config.check())
+        return 1;
+    config.print(cout);
+
+    if (lockMemory && !util::lockMemory())
+        return 1;
+
     input::InputTransmitter inputTransmitter;
-    if (!inputTransmitter.connect(syncinputIP, syncinputPort, protocol))
+    if (!inputTransmitter.connect(syncinputIP.c_str(), syncinputPort.c_str(), protocol))
+        return 1;
+
+    inputTransmitter.startClockSync();
+
+    frontend::CursorService cursor(inputTransmitter.getClockSync());
+    if (!cursorPort.empty() && !cursor.connect(syncinputIP.c_str(), cursorPort.c_str()))
         return 1;
 
+    net::RecordingWriter inputRecorder;
+    if (!inputRecordPath.empty()) {
+        if (!inputRecorder.open(inputRecordPath.c_str(), 1))
+            return 1;
+        cout << "Recording inputs to " << inputRecordPath << "\n";
+        inputTransmitter.setRecorder(&inputRecorder);
+    }
+
+    frontend::InputService inputService(inputTransmitter);
+    inputService.setCoalesceMotion(coalesceMotion);
+
     frontend::VideoService video;
-    if (!video.open(videoURL))
+    video.getStream().setDecoderThreads(decoderThreads);
+    video.getStream().setBatchReceive(batchReceive);
+    video.setCatchUp(catchUpPressureMs, catchUpJumpMs);
+    video.setThreadRole(videoRole);
+    if (!video.open(videoURL.c_str(), fastStart))
+        return 1;
+
+    if (!feedbackHost.empty() && !video.setFeedback(feedbackHost.c_str(), feedbackPort.c_str()))
         return 1;
 
     // Initialize SDL before opening audio device.
-    frontend::UI ui(inputTransmitter, video, useVsync);
+    frontend::UI ui(inputService, video, useVsync);
+    ui.setZeroCopy(zeroCopy);
+    ui.setThreadRoles(renderRole, eventsRole);
     if (!ui.init())
         return 1;
 
     ui.setMouseSensitivity(mouseSensitivity);
+    ui.setVsyncMethod(vsyncMethod);
+    ui.setInputBuffer(inputBufferUs);
+    ui.setMotionPrediction(predictPixelsPerCount, predictLatencyMs);
+    if (!cursorPort.empty())
+        ui.setCursor(&cursor);
+
+    frontend::RawMouse rawMouse;
+    if (useRawMouse) {
+        if (!rawMouse.open(rawMouseDevice))
+            return 1;
+        ui.setRawMouse(true);
+    }
 
     frontend::AudioService audio;
-    if (!audio.open(audioURL))
+    audio.setMaxQueuedBytes(audioQueueBytes);
+    audio.setThreadRole(audioRole);
+    if (!audio.open(audioURL.c_str(), fastStart))
         return 1;
 
-    cout << "Starting video and audio service\n";
+    cout << "Starting video, audio and input service\n";
     video.start(ui);
     audio.start();
+    inputService.start();
+    if (useRawMouse)
+        rawMouse.start(ui);
+    if (!cursorPort.empty())
+        cursor.start();
 
     cout << "Starting main loop\n";
     ui.run();
@@ -66,6 +207,9 @@ int main(int argc, char *argv[]) {
     cout << "Exiting\n";
     video.join();
     audio.join();
+    rawMouse.join();
+    cursor.join();
+    inputService.join();
 
     return 0;
 }
@@ -1,34 +1,45 @@
 #include "ui.hpp"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <cstring>
 #include <unistd.h>
 #include <syncstream>
 #include "VideoService.hpp"
-
-// Wait the given amount of microseconds until fetching and sending inputs.
-// If this value is <= 0, no buffering takes place and new inputs are sent immediately.
-// Setting this option > 0, e.g. 1000, seems to reduce increased mouse sensitivity. Instead of
-// sending a lot of 1px mouse movement inputs, buffering causes less packets to be sent that in turn
-// report higher delta values. This enables better application of mouse sensitivity scaling, at the
-// cost of increased latency.
-#define INPUT_BUFFER_US 0
-
+#include "util/clock.hpp"
 
 using std::cerr;
 
 namespace frontend {
-    UI::UI(const input::InputTransmitter& transmitter, VideoService& video, bool vsync) :
-        _mouseSensitivity(1.0), _window(nullptr), _renderer(nullptr), _frame(nullptr),
-        _transmitter(transmitter), _video(video), _running(false), _vsync(vsync)
+    bool parseVsyncMethod(const char* str, VsyncMethod* method) {
+        if (strcmp(str, "on-frame") == 0)
+            *method = VsyncMethod::OnFrame;
+        else if (strcmp(str, "predict") == 0)
+            *method = VsyncMethod::Predict;
+        else if (strcmp(str, "naive") == 0)
+            *method = VsyncMethod::Naive;
+        else
+            return false;
+        return true;
+    }
+
+
+    UI::UI(InputService& input, VideoService& video, bool vsync) :
+        _window(nullptr), _renderer(nullptr), _current(nullptr), _cursorTexture(nullptr), _cursor(nullptr),
+        _input(input), _video(video), _vsyncMethod(VsyncMethod::OnFrame), _inputBufferUs(0),
+        _logicalWidth(0), _logicalHeight(0),
+        _focused(false), _rawMouse(false), _zeroCopy(true), _running(false), _vsync(vsync)
     {}
 
     UI::~UI() {
+        _video.destroyTextures();
+
         if (_renderer)
             SDL_DestroyRenderer(_renderer);
         if (_window)
             SDL_DestroyWindow(_window);
-        if (_frame)
-            SDL_DestroyTexture(_frame);
+        if (_cursorTexture)
+            SDL_DestroyTexture(_cursorTexture);
         SDL_Quit();
     }
 
@@ -38,8 +49,8 @@ namespace frontend {
             return false;
         }
 
-        int width = _video.getStream().video()->width;
-        int height = _video.getStream().video()->height;
+        int width = _video.width();
+        int height = _video.height();
         Uint32 flags = SDL_WINDOW_MOUSE_CAPTURE | SDL_WINDOW_FULLSCREEN_DESKTOP;
         _window = SDL_CreateWindow("Frontend", 0, 0, width, height, flags);
 
@@ -48,7 +59,10 @@ namespace frontend {
             return false;
         }
 
+        // Relative motion is sent to the game and must not depend on the logical render size
+        SDL_SetHint(SDL_HINT_MOUSE_RELATIVE_SCALING, "0");
         SDL_SetRelativeMouseMode(SDL_TRUE);
+        _focused = SDL_GetWindowFlags(_window) & SDL_WINDOW_INPUT_FOCUS;
 
         _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED | (_vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
 
@@ -57,12 +71,14 @@ namespace frontend {
             return false;
         }
 
-        _frame = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, width, height);
+        // Render in video coordinates and let SDL scale to the window, keeping the aspect ratio
+        // when the stream resolution changes
+        SDL_RenderSetLogicalSize(_renderer, width, height);
+        _logicalWidth = width;
+        _logicalHeight = height;
 
-        if (!_frame) {
-            cerr << "Failed to create frame texture\n";
-            return false;
-        }
+        if (_zeroCopy)
+            _video.initTexturePool(_renderer);
 
         // Setup user event
         SDL_zero(_userEvent);
@@ -76,9 +92,8 @@ namespace frontend {
     void UI::notifyTextureUpdate() {
         SDL_PushEvent(&_userEvent);
 
-#if VSYNC_METHOD == VSYNC_METHOD_ON_FRAME
-        _frameCond.notify_all();
-#endif
+        if (_vsyncMethod == VsyncMethod::OnFrame)
+            _frameCond.notify_all();
     }
 
     void UI::run() {
@@ -91,13 +106,32 @@ namespace frontend {
     }
 
     void UI::_runInteractive() {
+        util::ScopedThreadRole role("events", _eventsRole);
         SDL_Event event;
 
-        while (_running && SDL_WaitEvent(&event))
-            if (event.type == SDL_USEREVENT)
+        while (_running && SDL_WaitEvent(&event)) {
+            bool newFrame = false;
+            bool moved = false;
+
+            // Handle everything that queued up before rendering once, e.g. with a 1 kHz mouse,
+            // so presenting does not delay input handling
+            do {
+                if (event.type == SDL_USEREVENT) {
+                    newFrame = true;
+                } else {
+                    _processEvent(event);
+                    moved |= event.type == SDL_MOUSEMOTION;
+                }
+            } while (_running && SDL_PollEvent(&event));
+
+            if (newFrame) {
                 _fetchAndRender();
-            else
-                _processEvent(event);
+            } else if (moved && (_predictor.isEnabled() || _cursor)) {
+                // Apply the predicted viewport shift and cursor position immediately instead of
+                // waiting for the next frame
+                _render();
+            }
+        }
     }
 
     void UI::_runSequential() {
@@ -112,59 +146,60 @@ namespace frontend {
     }
 
     void UI::_renderThread(SDL_GLContext gl, UI& ui) {
+        util::ScopedThreadRole role("render", ui._renderRole);
         SDL_GL_MakeCurrent(ui._window, gl);
 
-#if VSYNC_METHOD == VSYNC_METHOD_ON_FRAME
-        const auto maxWaitTime = std::chrono::milliseconds(500);
-
-        // Try adaptive Vsync and fallback to regular vsync
-        // if (SDL_GL_SetSwapInterval(-1) == -1)
-        //    SDL_GL_SetSwapInterval(1);
-
-        std::unique_lock lk(ui._frameMu);
-        while (ui._running) {
-            ui._frameCond.wait_for(lk, maxWaitTime);
-            ui._fetchAndRender();
-        }
-        lk.unlock();
-#elif VSYNC_METHOD == VSYNC_METHOD_PREDICT
-        using std::chrono::high_resolution_clock;
-        using std::chrono::duration_cast;
-        using std::chrono::microseconds;
-
-        float avgUs = 0;
-        size_t num = 0;
-        constexpr long render_time_us = 2000;
-        constexpr size_t max_probes = 240;
-
-        // Measure average vsync interval
-        while (ui._running && num < max_probes) {
-            auto begin = high_resolution_clock::now();
-
-            ui._fetchAndRender();
-
-            auto end = high_resolution_clock::now();
-            auto deltaUs = duration_cast<microseconds>(end - begin).count();
-            num++;
-            avgUs += (deltaUs - avgUs) / num;
-        }
-
-        std::osyncstream(std::cout) << "Average Vsync interval: " << avgUs << "us\n";
-        const unsigned int waitUs = avgUs - render_time_us;
-
-        // Try adaptive Vsync and fallback to regular vsync
-        // if (SDL_GL_SetSwapInterval(-1) == -1)
-        //     SDL_GL_SetSwapInterval(1);
-
-        while (ui._running) {
-            usleep(waitUs);
-            ui._fetchAndRender();
+        if (ui._vsyncMethod == VsyncMethod::OnFrame) {
+            const auto maxWaitTime = std::chrono::milliseconds(500);
+
+            // Try adaptive Vsync and fallback to regular vsync
+            // if (SDL_GL_SetSwapInterval(-1) == -1)
+            //    SDL_GL_SetSwapInterval(1);
+
+            std::unique_lock lk(ui._frameMu);
+            while (ui._running) {
+                ui._frameCond.wait_for(lk, maxWaitTime);
+                ui._fetchAndRender();
+            }
+            lk.unlock();
+        } else if (ui._vsyncMethod == VsyncMethod::Predict) {
+            using std::chrono::high_resolution_clock;
+            using std::chrono::duration_cast;
+            using std::chrono::microseconds;
+
+            float avgUs = 0;
+            size_t num = 0;
+            constexpr long render_time_us = 2000;
+            constexpr size_t max_probes = 240;
+
+            // Measure average vsync interval
+            while (ui._running && num < max_probes) {
+                auto begin = high_resolution_clock::now();
+
+                ui._fetchAndRender();
+
+                auto end = high_resolution_clock::now();
+                auto deltaUs = duration_cast<microseconds>(end - begin).count();
+                num++;
+                avgUs += (deltaUs - avgUs) / num;
+            }
+
+            std::osyncstream(std::cout) << "Average Vsync interval: " << avgUs << "us\n";
+            const unsigned int waitUs = avgUs - render_time_us;
+
+            // Try adaptive Vsync and fallback to regular vsync
+            // if (SDL_GL_SetSwapInterval(-1) == -1)
+            //     SDL_GL_SetSwapInterval(1);
+
+            while (ui._running) {
+                usleep(waitUs);
+                ui._fetchAndRender();
+            }
+        } else {
+            while (ui._running) {
+                ui._fetchAndRender();
+            }
         }
-#elif VSYNC_METHOD == VSYNC_METHOD_NAIVE
-        while (ui._running) {
-            ui._fetchAndRender();
-        }
-#endif
     }
 
     void UI::_runThreaded() {
@@ -174,53 +209,144 @@ namespace frontend {
 
         std::thread renderThread(_renderThread, gl, std::ref(*this));
 
-#if defined(INPUT_BUFFER_US) && (INPUT_BUFFER_US) > 0
-        while (_running) {
-            while (SDL_PollEvent(&event))
+        // After creating the render thread, so it does not inherit the role
+        util::ScopedThreadRole role("events", _eventsRole);
+
+        if (_inputBufferUs > 0) {
+            while (_running) {
+                while (SDL_PollEvent(&event))
+                    _processEvent(event);
+                usleep(_inputBufferUs);
+            }
+        } else {
+            while (_running && SDL_WaitEvent(&event))
                 _processEvent(event);
-            usleep(INPUT_BUFFER_US);
         }
-#else
-        while (_running && SDL_WaitEvent(&event))
-            _processEvent(event);
-#endif
 
         renderThread.join();
     }
 
     void UI::_fetchAndRender() {
-        _video.updateSDLTexture(_frame);
-        SDL_RenderCopy(_renderer, _frame, nullptr, nullptr);
+        _current = _video.updateSDLTexture(_renderer);
+        _render();
+
+        if (_current)
+            _video.getTimeline().mark(StartupTimeline::FirstPresent);
+    }
+
+    void UI::_render() {
+        // Pool textures are larger than the frame
+        const SDL_Rect src { .x = 0, .y = 0, .w = _video.width(), .h = _video.height() };
+
+        if (src.w != _logicalWidth || src.h != _logicalHeight) {
+            SDL_RenderSetLogicalSize(_renderer, src.w, src.h);
+            _logicalWidth = src.w;
+            _logicalHeight = src.h;
+        }
+
+        // Also clears the letterbox bars
+        SDL_RenderClear(_renderer);
+
+        if (!_current) {
+            // No frame yet
+        } else if (_predictor.isEnabled()) {
+            // The offset is in window pixels
+            float dx, dy, scaleX, scaleY;
+            _predictor.getOffset(&dx, &dy);
+            SDL_RenderGetScale(_renderer, &scaleX, &scaleY);
+
+            SDL_Rect dst = src;
+            dst.x = std::round(dx / scaleX);
+            dst.y = std::round(dy / scaleY);
+            SDL_RenderCopy(_renderer, _current, &src, &dst);
+        } else {
+            SDL_RenderCopy(_renderer, _current, &src, nullptr);
+        }
+
+        _renderCursor();
         SDL_RenderPresent(_renderer);
     }
 
+    void UI::_renderCursor() {
+        if (!_cursor)
+            return;
+
+        if (_cursor->updateShape(&_cursorShape)) {
+            if (_cursorTexture)
+                SDL_DestroyTexture(_cursorTexture);
+
+            _cursorTexture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                    _cursorShape.width, _cursorShape.height);
+
+            if (!_cursorTexture) {
+                cerr << "Failed to create cursor texture\n";
+                return;
+            }
+
+            SDL_UpdateTexture(_cursorTexture, nullptr, _cursorShape.pixels.data(), _cursorShape.width * sizeof(uint32_t));
+            SDL_SetTextureBlendMode(_cursorTexture, SDL_BLENDMODE_BLEND);
+        }
+
+        int x, y;
+        if (!_cursorTexture || !_cursor->getPosition(&x, &y))
+            return;
+
+        // The X server keeps the pointer on screen, so should we
+        x = std::clamp(x, 0, _video.width() - 1);
+        y = std::clamp(y, 0, _video.height() - 1);
+
+        // Rendering is in video coordinates, so SDL scales it like the video
+        SDL_Rect dst {
+            .x = x - _cursorShape.hotX,
+            .y = y - _cursorShape.hotY,
+            .w = _cursorShape.width,
+            .h = _cursorShape.height,
+        };
+        SDL_RenderCopy(_renderer, _cursorTexture, nullptr, &dst);
+    }
+
     void UI::_processEvent(const SDL_Event& event) {
         switch (event.type) {
             case SDL_KEYDOWN:
                 if (!event.key.repeat)
-                    _transmitter.sendKey(event.key.keysym, true);
+                    _input.pushKey(event.key.keysym, true);
                 break;
 
             case SDL_KEYUP:
-                _transmitter.sendKey(event.key.keysym, false);
+                _input.pushKey(event.key.keysym, false);
                 break;
 
             case SDL_MOUSEBUTTONDOWN:
-                _transmitter.sendMouseButton(event.button.button, true);
+                _input.pushMouseButton(event.button.button, true);
                 break;
 
             case SDL_MOUSEBUTTONUP:
-                _transmitter.sendMouseButton(event.button.button, false);
+                _input.pushMouseButton(event.button.button, false);
                 break;
 
             case SDL_MOUSEMOTION:
-                _transmitter.sendMouseMotion(
-                        std::round(event.motion.xrel * _mouseSensitivity),
-                        std::round(event.motion.yrel * _mouseSensitivity));
+                if (!_rawMouse) {
+                    int32_t x, y;
+                    _motion.add(event.motion.xrel, event.motion.yrel, &x, &y);
+
+                    if (x == 0 && y == 0)
+                        break;
+
+                    const int64_t now = util::monotonicTimeUs();
+                    _input.pushMouseMotion(x, y, now);
+                    _onMotion(x, y, now);
+                }
                 break;
 
             case SDL_MOUSEWHEEL:
-                _transmitter.sendMouseWheel(event.wheel.x, event.wheel.y);
+                _input.pushMouseWheel(event.wheel.x, event.wheel.y);
+                break;
+
+            case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED)
+                    _focused = true;
+                else if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST)
+                    _focused = false;
                 break;
 
             case SDL_QUIT:
@@ -233,6 +359,66 @@ namespace frontend {
     }
 
     void UI::setMouseSensitivity(float sens) {
-        _mouseSensitivity = sens;
+        _motion.setSensitivity(sens);
+        _rawMotion.setSensitivity(sens);
+    }
+
+    void UI::setVsyncMethod(VsyncMethod method) {
+        _vsyncMethod = method;
+    }
+
+    void UI::setInputBuffer(int us) {
+        _inputBufferUs = us;
+    }
+
+    void UI::setRawMouse(bool enabled) {
+        _rawMouse = enabled;
+    }
+
+    void UI::handleRawMotion(int32_t x, int32_t y, int64_t timeUs) {
+        if (!_focused)
+            return;
+
+        int32_t scaledX, scaledY;
+        _rawMotion.add(x, y, &scaledX, &scaledY);
+
+        if (scaledX == 0 && scaledY == 0)
+            return;
+
+        if (timeUs == 0)
+            timeUs = util::monotonicTimeUs();
+
+        _input.pushMouseMotion(scaledX, scaledY, timeUs);
+        _onMotion(scaledX, scaledY, timeUs);
+    }
+
+    void UI::_onMotion(int32_t x, int32_t y, int64_t timeUs) {
+        if (_predictor.isEnabled())
+            _predictor.addMotion(x, y);
+
+        if (_cursor) {
+            _cursor->addMotion(x, y, timeUs);
+
+            // Move the cursor without waiting for the next frame
+            if (_vsync && _vsyncMethod == VsyncMethod::OnFrame)
+                _frameCond.notify_all();
+        }
+    }
+
+    void UI::setMotionPrediction(float pixelsPerCount, int latencyMs) {
+        _predictor.configure(pixelsPerCount, latencyMs);
+    }
+
+    void UI::setThreadRoles(const util::ThreadRole& render, const util::ThreadRole& events) {
+        _renderRole = render;
+        _eventsRole = events;
+    }
+
+    void UI::setZeroCopy(bool enabled) {
+        _zeroCopy = enabled;
+    }
+
+    void UI::setCursor(CursorService* cursor) {
+        _cursor = cursor;
     }
 } // namespace frontend
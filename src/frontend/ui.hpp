@@ -1,30 +1,37 @@
 #include <SDL2/SDL.h>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include "network/input.hpp"
+#include "CursorService.hpp"
+#include "InputService.hpp"
+#include "MotionPredictor.hpp"
+#include "RawMouse.hpp"
+#include "util/thread_role.hpp"
 
-// Wait for the next frame and render it immediately.
-// Feels much smoother than VSYNC_METHOD_PREDICT but slightly less responsive.
-#define VSYNC_METHOD_ON_FRAME 0
+namespace frontend {
+    class VideoService;
 
-// Measure average vsync interval, then predict when next vsync occurs and render just before it happens.
-// This method feels slightly more responsive than VSYNC_METHOD_ON_FRAME but also a lot more choppy.
-#define VSYNC_METHOD_PREDICT 1
+    // Rendering technique of the render thread when VSync is enabled.
+    enum class VsyncMethod {
+        // Wait for the next frame and render it immediately.
+        // Feels much smoother than Predict but slightly less responsive.
+        OnFrame,
 
-// Naive - Render and wait for vblank.
-// Feels smooth but much less responsive than other methods.
-#define VSYNC_METHOD_NAIVE 2
+        // Measure average vsync interval, then predict when next vsync occurs and render just before it happens.
+        // This method feels slightly more responsive than OnFrame but also a lot more choppy.
+        Predict,
 
-// Vsync method to use. See constants above.
-#define VSYNC_METHOD VSYNC_METHOD_ON_FRAME
+        // Naive - Render and wait for vblank.
+        // Feels smooth but much less responsive than other methods.
+        Naive,
+    };
 
-
-namespace frontend {
-    class VideoService;
+    // Parse on-frame, predict or naive. Returns false if the name is unknown.
+    bool parseVsyncMethod(const char* str, VsyncMethod* method);
 
     class UI {
         public:
-            UI(const input::InputTransmitter& transmitter, VideoService& video, bool vsync);
+            UI(InputService& input, VideoService& video, bool vsync);
             ~UI();
 
             bool init();
@@ -34,6 +41,41 @@ namespace frontend {
 
             void setMouseSensitivity(float sens);
 
+            // Set the rendering technique used with VSync. Default: OnFrame
+            void setVsyncMethod(VsyncMethod method);
+
+            // Wait the given amount of microseconds until fetching and sending inputs when VSync is
+            // enabled. If this value is <= 0 (default), no buffering takes place and new inputs are
+            // sent immediately.
+            // Setting this option > 0, e.g. 1000, seems to reduce increased mouse sensitivity.
+            // Instead of sending a lot of 1px mouse movement inputs, buffering causes less packets
+            // to be sent that in turn report higher delta values. This enables better application
+            // of mouse sensitivity scaling, at the cost of increased latency.
+            void setInputBuffer(int us);
+
+            // Ignore SDL mouse motion in favor of handleRawMotion(). See RawMouse.
+            void setRawMouse(bool enabled);
+
+            // (Thread-safe) Handle unscaled relative mouse motion from a raw input device.
+            // Motion is only forwarded while the window has input focus.
+            // timeUs: Time the motion occurred in the local monotonic clock, or 0 for now.
+            void handleRawMotion(int32_t x, int32_t y, int64_t timeUs);
+
+            // Enable latency hiding by shifting the last frame according to mouse motion that was
+            // not yet reflected in the video. See MotionPredictor::configure().
+            void setMotionPrediction(float pixelsPerCount, int latencyMs);
+
+            // Let the decoder write into texture memory instead of copying frames into a texture.
+            // Must be called before init(). Default: true
+            void setZeroCopy(bool enabled);
+
+            // Draw the cursor forwarded by syncinput on top of the video. nullptr disables it.
+            void setCursor(CursorService* cursor);
+
+            // Placement of the render thread with VSync, and of the thread calling run(), which
+            // handles events and, without VSync, also renders. Call before run().
+            void setThreadRoles(const util::ThreadRole& render, const util::ThreadRole& events);
+
           private:
             // Run like a regular game loop: fetch inputs -> process -> render (wait for vsync).
             // High latency, no tearing.
@@ -44,28 +86,44 @@ namespace frontend {
             void _runInteractive();
 
             // Run rendering in a separate thread to allow vsync and immediate input processing.
-            // See VSYNC_METHOD above on what rendering technique to use.
+            // See VsyncMethod on what rendering technique to use.
             // Medium latency, no tearing.
             void _runThreaded();
 
             void _processEvent(const SDL_Event& ev);
             void _fetchAndRender();
+            void _render();
+            void _renderCursor();
+            // Pass sent mouse motion on to the predictor and the cursor
+            void _onMotion(int32_t x, int32_t y, int64_t timeUs);
             static void _renderThread(SDL_GLContext gl, UI& ui);
 
           private:
-            float _mouseSensitivity;
+            MotionAccumulator _motion;     // SDL mouse motion, event thread only
+            MotionAccumulator _rawMotion;  // Raw mouse motion, RawMouse thread only
             SDL_Window* _window;
             SDL_Renderer* _renderer;
-            SDL_Texture* _frame;
-            const input::InputTransmitter& _transmitter;
+            SDL_Texture* _current;         // Texture of the current frame
+            SDL_Texture* _cursorTexture;
+            CursorService::Shape _cursorShape;
+            CursorService* _cursor;
+            InputService& _input;
             VideoService& _video;
             SDL_Event _userEvent;
+            MotionPredictor _predictor;
+            util::ThreadRole _renderRole;
+            util::ThreadRole _eventsRole;
 
-#if VSYNC_METHOD == VSYNC_METHOD_ON_FRAME
             std::mutex _frameMu;
             std::condition_variable _frameCond;
-#endif
 
+            VsyncMethod _vsyncMethod;
+            int _inputBufferUs;
+            int _logicalWidth;             // Current video size, render thread only
+            int _logicalHeight;
+            std::atomic<bool> _focused;
+            bool _rawMouse;
+            bool _zeroCopy;
             bool _running;
             bool _vsync;
     };
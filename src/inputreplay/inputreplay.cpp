@@ -0,0 +1,93 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include "network/input.hpp"
+#include "network/recording.hpp"
+#include "util/config.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static volatile std::sig_atomic_t running = 1;
+
+
+void help() {
+    cout << "Usage: inputreplay <file> <syncinput IP> <syncinput port> <tcp|udp> [speed]\n";
+    cout << "Replays an input recording created by the frontend to the given syncinput server, preserving the original timing.\n";
+    cout << "Speed is a factor applied to the original timing, e.g. 2 replays twice as fast. 0 replays as fast as possible. Default: 1\n";
+    cout << "The arguments can also be given as file, syncinput-host, syncinput-port, protocol and speed options in the [inputreplay] section of a config file passed with config=<file>.\n";
+}
+
+void stop([[maybe_unused]] int signal) {
+    running = 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    using clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    util::Config config("inputreplay");
+    if (!config.parseArgs(argc, argv, { "file", "syncinput-host", "syncinput-port", "protocol", "speed" }))
+        return 1;
+
+    if (const char* key = config.missing({ "file", "syncinput-host", "syncinput-port", "protocol" })) {
+        help();
+        cerr << "Missing option: " << key << endl;
+        return 1;
+    }
+
+    const std::string path = config.getString("file");
+    const std::string syncinputIP = config.getString("syncinput-host");
+    const std::string syncinputPort = config.getString("syncinput-port");
+    net::SocketType protocol = net::parseProtocol(config.getString("protocol").c_str());
+    double speed = config.getFloat("speed", 1.0);
+
+    if (!config.check())
+        return 1;
+    config.print(cout);
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    net::RecordingReader reader;
+    if (!reader.open(path.c_str()))
+        return 1;
+
+    input::InputTransmitter inputTransmitter;
+    if (!inputTransmitter.connect(syncinputIP.c_str(), syncinputPort.c_str(), protocol))
+        return 1;
+
+    cout << "Replaying " << path << " at speed " << speed << endl;
+
+    net::Record record;
+    size_t numEvents = 0;
+    uint64_t firstTimestamp = 0;
+    auto start = clock::now();
+
+    while (running && reader.next(&record)) {
+        if (record.size != sizeof(input::InputEvent)) {
+            cerr << "Skipping record of invalid size: " << record.size << endl;
+            continue;
+        }
+
+        if (numEvents == 0)
+            firstTimestamp = record.timestampUs;
+
+        if (speed > 0) {
+            auto offset = microseconds(static_cast<int64_t>((record.timestampUs - firstTimestamp) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+
+        // Records are stored in network byte order, hence they can be sent as-is.
+        inputTransmitter.sendRaw(*reinterpret_cast<const input::InputEvent*>(record.data));
+        numEvents++;
+    }
+
+    auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    cout << "Replayed " << numEvents << " events in " << elapsed << "s\n";
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "clocksync.hpp"
+#include <algorithm>
+
+namespace net {
+    ClockSync::ClockSync() : _offset(0), _rtt(0), _synchronized(false) {}
+
+    bool ClockSync::addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3) {
+        const int64_t rtt = (t3 - t0) - (t2 - t1);
+
+        if (rtt < 0 || t3 < t0 || t2 < t1)
+            return false;
+
+        std::lock_guard<std::mutex> guard(_mutex);
+        _samples.push_back({ ((t1 - t0) + (t2 - t3)) / 2, rtt });
+        if (_samples.size() > window_size)
+            _samples.pop_front();
+
+        auto best = std::min_element(_samples.begin(), _samples.end(),
+                [](const Sample& a, const Sample& b) { return a.rtt < b.rtt; });
+
+        _offset = best->offset;
+        _rtt = best->rtt;
+        _synchronized = true;
+        return true;
+    }
+
+    bool ClockSync::isSynchronized() const {
+        return _synchronized;
+    }
+
+    int64_t ClockSync::offset() const {
+        return _offset;
+    }
+
+    int64_t ClockSync::rtt() const {
+        return _rtt;
+    }
+
+    int64_t ClockSync::toRemote(int64_t localUs) const {
+        return localUs + _offset;
+    }
+
+    int64_t ClockSync::toLocal(int64_t remoteUs) const {
+        return remoteUs - _offset;
+    }
+} // namespace net
@@ -0,0 +1,59 @@
+#ifndef NET_CLOCKSYNC_HPP
+#define NET_CLOCKSYNC_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace net {
+    // Estimates the offset between the local and a remote monotonic clock from NTP-style
+    // ping/pong exchanges.
+    // Per exchange:
+    //   t0: Ping sent (local clock)
+    //   t1: Ping received (remote clock)
+    //   t2: Pong sent (remote clock)
+    //   t3: Pong received (local clock)
+    // Queueing delay only ever increases the RTT, so the offset of the sample with the lowest RTT
+    // among the most recent samples is used, which filters out most of the network jitter.
+    class ClockSync {
+        public:
+            ClockSync();
+
+            // (Thread-safe) Add an exchange. Returns false if the sample is invalid.
+            bool addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3);
+
+            // (Thread-safe) Returns true if at least one valid sample has been added.
+            bool isSynchronized() const;
+
+            // (Thread-safe) Returns the estimated offset remote - local in microseconds.
+            int64_t offset() const;
+
+            // (Thread-safe) Returns the round trip time of the sample the offset is based on.
+            int64_t rtt() const;
+
+            // (Thread-safe) Convert a local timestamp to the remote clock.
+            int64_t toRemote(int64_t localUs) const;
+
+            // (Thread-safe) Convert a remote timestamp to the local clock.
+            int64_t toLocal(int64_t remoteUs) const;
+
+        private:
+            struct Sample {
+                int64_t offset;
+                int64_t rtt;
+            };
+
+            // Number of recent samples to pick the best one from
+            static constexpr size_t window_size = 8;
+
+        private:
+            std::mutex _mutex;
+            std::deque<Sample> _samples;
+            std::atomic<int64_t> _offset;
+            std::atomic<int64_t> _rtt;
+            std::atomic<bool> _synchronized;
+    };
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include "cursor.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+// htonl
+#ifdef __linux__
+#	include <netinet/in.h>
+#elif _WIN32
+#	include <WinSock2.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#   define MSG_NOSIGNAL 0
+#endif
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace input {
+    bool CursorTransmitter::connect(const char* host, const char* port, int maxTries) {
+        cout << "Connecting cursor channel to " << host << ":" << port << "..." << endl;
+
+        for (int i = 0; i < maxTries; ++i) {
+            if (_socket.connect(net::TCP, host, port)) {
+                _socket.setNagleAlgorithm(false);
+                return true;
+            }
+
+            cerr << "Failed to connect. Retrying in 1s.\n";
+            sleep(1);
+        }
+
+        cerr << "Failed to establish cursor connection\n";
+        return false;
+    }
+
+    bool CursorTransmitter::listen(const char* host, const char* port) {
+        if (!_listener.listen(net::TCP, host, port)) {
+            cerr << "Failed to start cursor listener: " << std::strerror(errno) << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool CursorTransmitter::accept(int timeoutMs) {
+        // The receive timeout applies to accept() as well
+        _listener.setReceiveTimeout(timeoutMs);
+        _socket = _listener.accept();
+
+        if (!_socket.isValid())
+            return false;
+
+        _listener.close();
+        _socket.setNagleAlgorithm(false);
+        return true;
+    }
+
+    bool CursorTransmitter::setReceiveTimeout(int ms) const {
+        return _socket.setReceiveTimeout(ms);
+    }
+
+    bool CursorTransmitter::sendPosition(int32_t x, int32_t y, int64_t lastMotionUs) const {
+        const Timestamp lastMotion = makeTimestamp(lastMotionUs);
+        const CursorMessage msg {
+            .type = htonl(CursorMessagePosition),
+            .serial = 0,
+            .x = static_cast<int32_t>(htonl(x)),
+            .y = static_cast<int32_t>(htonl(y)),
+            .width = 0,
+            .height = 0,
+            .lastMotion = Timestamp { .high = htonl(lastMotion.high), .low = htonl(lastMotion.low) }
+        };
+        return _send(&msg, sizeof(msg));
+    }
+
+    bool CursorTransmitter::sendShape(uint32_t serial, int32_t hotX, int32_t hotY, uint32_t width, uint32_t height,
+            const std::vector<uint32_t>& pixels) const {
+        if (pixels.empty())
+            width = height = 0;
+
+        const CursorMessage msg {
+            .type = htonl(CursorMessageShape),
+            .serial = htonl(serial),
+            .x = static_cast<int32_t>(htonl(hotX)),
+            .y = static_cast<int32_t>(htonl(hotY)),
+            .width = htonl(width),
+            .height = htonl(height),
+            .lastMotion = {}
+        };
+
+        if (!_send(&msg, sizeof(msg)))
+            return false;
+
+        if (pixels.empty())
+            return true;
+
+        std::vector<uint32_t> out(width * height);
+        for (size_t i = 0; i < out.size(); ++i)
+            out[i] = htonl(pixels[i]);
+
+        return _send(out.data(), out.size() * sizeof(uint32_t));
+    }
+
+    bool CursorTransmitter::recv(CursorMessage* msg, std::vector<uint32_t>* pixels) const {
+        if (!_recv(msg, sizeof(*msg)))
+            return false;
+
+        msg->type = ntohl(msg->type);
+        msg->serial = ntohl(msg->serial);
+        msg->x = ntohl(msg->x);
+        msg->y = ntohl(msg->y);
+        msg->width = ntohl(msg->width);
+        msg->height = ntohl(msg->height);
+        msg->lastMotion.high = ntohl(msg->lastMotion.high);
+        msg->lastMotion.low = ntohl(msg->lastMotion.low);
+
+        if (msg->type != CursorMessageShape || msg->width == 0 || msg->height == 0)
+            return true;
+
+        if (msg->width > max_cursor_size || msg->height > max_cursor_size) {
+            cerr << "Cursor too large: " << msg->width << "x" << msg->height << endl;
+            return false;
+        }
+
+        // Pixels follow immediately, so they are waited for even if the receive timeout expires
+        pixels->resize(msg->width * msg->height);
+        size_t received = 0;
+        const size_t size = pixels->size() * sizeof(uint32_t);
+
+        while (received < size) {
+            int n = _socket.recv(reinterpret_cast<char*>(pixels->data()) + received, size - received, MSG_WAITALL);
+
+            if (n > 0)
+                received += n;
+            else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                return false;
+        }
+
+        for (uint32_t& pixel : *pixels)
+            pixel = ntohl(pixel);
+
+        return true;
+    }
+
+    bool CursorTransmitter::_send(const void* data, size_t size) const {
+        const char* bytes = static_cast<const char*>(data);
+
+        while (size > 0) {
+            int n = _socket.send(bytes, size, MSG_NOSIGNAL);
+
+            if (n <= 0) {
+                cerr << "Failed to send cursor update: " << std::strerror(errno) << endl;
+                return false;
+            }
+
+            bytes += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+    bool CursorTransmitter::_recv(void* data, size_t size) const {
+        char* bytes = static_cast<char*>(data);
+        size_t received = 0;
+
+        while (received < size) {
+            int n = _socket.recv(bytes + received, size - received, MSG_WAITALL);
+
+            if (n > 0) {
+                received += n;
+            } else if (n == 0) {
+                cout << "Cursor connection closed\n";
+                return false;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Only a timeout if nothing arrived yet. Once a message started, e.g. re-chunked
+                // by a proxy, the rest follows and is waited for.
+                if (received == 0)
+                    return false;
+            } else {
+                cerr << "Failed to receive cursor update: " << std::strerror(errno) << endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
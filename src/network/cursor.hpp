@@ -0,0 +1,76 @@
+#ifndef CURSOR_PROTOCOL_HPP
+#define CURSOR_PROTOCOL_HPP
+
+#include <cstdint>
+#include <vector>
+#include "network/socket.hpp"
+#include "network/input.hpp"
+
+namespace input {
+    // Largest cursor image that is accepted, larger ones are dropped.
+    constexpr uint32_t max_cursor_size = 256;
+
+    enum CursorMessageType : uint32_t {
+        CursorMessagePosition,
+        CursorMessageShape,
+    };
+
+    // Sent by syncinput to the frontend over a separate TCP connection, so the frontend can draw
+    // the cursor itself instead of waiting for it to show up in the video.
+    // Shapes are identified by the cursor serial of XFixes. Each shape is only transferred once,
+    // afterwards a shape message without pixels selects the cached shape.
+    struct CursorMessage {
+        uint32_t type;
+
+        // Position: Unused. Shape: Serial of the shape.
+        uint32_t serial;
+
+        // Position: Pointer position in stream coordinates. Shape: Hotspot.
+        int32_t x;
+        int32_t y;
+
+        // Shape: Size of the image, followed by width * height ARGB pixels with straight alpha.
+        // Both are 0 if the shape was sent before.
+        uint32_t width;
+        uint32_t height;
+
+        // Position: Timestamp of the last mouse motion event injected before the position was
+        // read, i.e. the position includes all motion up to this event. In syncinput's clock.
+        Timestamp lastMotion;
+    };
+
+    // Transfers cursor updates in network byte order over TCP.
+    class CursorTransmitter
+    {
+        public:
+            bool connect(const char* host, const char* port, int maxTries = 5);
+
+            // Bind to the given address. Call accept() afterwards to wait for the frontend.
+            bool listen(const char* host, const char* port);
+            // Returns false if no connection arrived within the timeout.
+            bool accept(int timeoutMs);
+
+            // Returns false if the connection is broken.
+            bool sendPosition(int32_t x, int32_t y, int64_t lastMotionUs) const;
+            // Pass an empty pixel vector to select a shape that was sent before.
+            bool sendShape(uint32_t serial, int32_t hotX, int32_t hotY, uint32_t width, uint32_t height,
+                    const std::vector<uint32_t>& pixels) const;
+
+            // Receive a message in host byte order. Shape pixels are written to pixels.
+            // Returns false on error, when the connection was closed, or when the receive timeout
+            // expired.
+            bool recv(CursorMessage* msg, std::vector<uint32_t>* pixels) const;
+
+            bool setReceiveTimeout(int ms) const;
+
+        private:
+            bool _send(const void* data, size_t size) const;
+            bool _recv(void* data, size_t size) const;
+
+        private:
+            net::Socket _listener;
+            net::Socket _socket;
+    };
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef NET_FEEDBACK_HPP
+#define NET_FEEDBACK_HPP
+
+#include <cstdint>
+
+namespace net {
+    constexpr uint32_t loss_report_magic = 0x4c4f5353;  // "LOSS"
+
+    // Sent by the frontend to the streamer over UDP when the video stream got corrupted, e.g.
+    // due to packet loss. The streamer reacts by refreshing the picture.
+    // All fields are in network byte order.
+    struct LossReport {
+        uint32_t magic;
+        uint32_t sequence;  // Incremented with every report
+    };
+}
+
+#endif
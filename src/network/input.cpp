@@ -1,4 +1,5 @@
 #include "input.hpp"
+#include "util/clock.hpp"
 #include <cstring>
 #include <iostream>
 #include <unistd.h>
@@ -19,67 +20,203 @@ void cerrWithErrno(const char* text) {
 }
 
 namespace input {
+    // Number of clock sync exchanges between log messages
+    constexpr int clock_sync_log_interval = 10;
+
+    Timestamp makeTimestamp(int64_t us) {
+        return Timestamp {
+            .high = static_cast<uint32_t>(static_cast<uint64_t>(us) >> 32),
+            .low = static_cast<uint32_t>(us)
+        };
+    }
+
+    int64_t timestampToUs(const Timestamp& timestamp) {
+        return static_cast<int64_t>((static_cast<uint64_t>(timestamp.high) << 32) | timestamp.low);
+    }
+
+    static Timestamp htonTimestamp(int64_t us) {
+        Timestamp timestamp = makeTimestamp(us);
+        return Timestamp { .high = htonl(timestamp.high), .low = htonl(timestamp.low) };
+    }
+
+    static void ntohTimestamp(Timestamp* timestamp) {
+        timestamp->high = ntohl(timestamp->high);
+        timestamp->low = ntohl(timestamp->low);
+    }
+
+
+    InputTransmitter::~InputTransmitter() {
+        stopClockSync();
+    }
+
     void InputTransmitter::sendMouseButton(uint8_t button, bool pressed) const {
-        _send(InputEvent {
-            .type = htonl(EventMouseButton),
+        send(InputEvent {
+            .type = EventMouseButton,
+            .timestamp = {},
             .button = MouseButton {
-                .button = htonl(button),
-                .pressed = htonl(pressed)
+                .button = button,
+                .pressed = pressed
             }
         });
     }
 
     void InputTransmitter::sendMouseMotion(int32_t x, int32_t y) const {
-        _send(InputEvent {
-            .type = htonl(EventMouseMotion),
-            .motion = MouseMotion {
-                .x = static_cast<int32_t>(htonl(x)),
-                .y = static_cast<int32_t>(htonl(y))
-            }
+        send(InputEvent {
+            .type = EventMouseMotion,
+            .timestamp = {},
+            .motion = MouseMotion { .x = x, .y = y }
         });
     }
 
     void InputTransmitter::sendMouseWheel(int32_t x, int32_t y) const {
-        _send(InputEvent {
-            .type = htonl(EventMouseWheel),
-            .wheel = MouseWheel {
-                .x = static_cast<int32_t>(htonl(x)),
-                .y = static_cast<int32_t>(htonl(y))
-            }
+        send(InputEvent {
+            .type = EventMouseWheel,
+            .timestamp = {},
+            .wheel = MouseWheel { .x = x, .y = y }
         });
     }
 
     void InputTransmitter::sendKey(const SDL_Keysym& key, bool pressed) const {
+        send(makeKeyEvent(key, pressed));
+    }
+
+    InputEvent makeKeyEvent(const SDL_Keysym& key, bool pressed) {
         // Apparently this key does not produce a meaningful keysym, so we handle it manually.
         auto sym = (key.scancode == SDL_SCANCODE_GRAVE) ? SDLK_BACKQUOTE : key.sym;
 
-        _send(InputEvent {
-            .type = htonl(EventKey),
+        return InputEvent {
+            .type = EventKey,
+            .timestamp = {},
             .key = Key {
-                .key = static_cast<int32_t>(htonl(sym)),
-                .pressed = htonl(pressed)
+                .key = sym,
+                .pressed = pressed,
+                .scancode = key.scancode
             }
+        };
+    }
+
+    void InputTransmitter::send(const InputEvent& event) const {
+        InputEvent out;
+        memset(&out, 0, sizeof(out));
+        out.type = htonl(event.type);
+
+        switch (event.type) {
+            case InputEventType::EventMouseMotion:
+                out.motion.x = htonl(event.motion.x);
+                out.motion.y = htonl(event.motion.y);
+                break;
+
+            case InputEventType::EventMouseButton:
+                out.button.button = htonl(event.button.button);
+                out.button.pressed = htonl(event.button.pressed);
+                break;
+
+            case InputEventType::EventMouseWheel:
+                out.wheel.x = htonl(event.wheel.x);
+                out.wheel.y = htonl(event.wheel.y);
+                break;
+
+            case InputEventType::EventKey:
+                out.key.key = htonl(event.key.key);
+                out.key.pressed = htonl(event.key.pressed);
+                out.key.scancode = htonl(event.key.scancode);
+                break;
+
+            default:
+                cerr << "Not an input event: " << event.type << endl;
+                return;
+        }
+
+        _sendEvent(out, timestampToUs(event.timestamp));
+    }
+
+    void InputTransmitter::sendPing() const {
+        _send(InputEvent {
+            .type = htonl(EventPing),
+            .timestamp = htonTimestamp(util::monotonicTimeUs()),
+            .pong = {}
         });
     }
 
+    void InputTransmitter::sendPong(const InputEvent& ping, int64_t receiveTimeUs) const {
+        _send(InputEvent {
+            .type = htonl(EventPong),
+            .timestamp = htonTimestamp(util::monotonicTimeUs()),
+            .pong = Pong {
+                .origin = htonTimestamp(timestampToUs(ping.timestamp)),
+                .receive = htonTimestamp(receiveTimeUs)
+            }
+        });
+    }
+
+    void InputTransmitter::_sendEvent(InputEvent event, int64_t timeUs) const {
+        if (timeUs == 0)
+            timeUs = util::monotonicTimeUs();
+        event.timestamp = htonTimestamp(_clockSync.toRemote(timeUs));
+
+        if (_recorder)
+            _recorder->write(0, reinterpret_cast<const char *>(&event), sizeof(InputEvent));
+
+        _send(event);
+    }
+
     void InputTransmitter::_send(const InputEvent& event) const {
-        if (_socket.send(reinterpret_cast<const char *>(&event), sizeof(InputEvent)) == -1)
+        std::lock_guard<std::mutex> guard(_sendMutex);
+        int nsent;
+
+        if (_datagramListener) {
+            // Nobody to answer yet
+            if (_peer.length == 0)
+                return;
+            nsent = _socket.sendTo(reinterpret_cast<const char *>(&event), sizeof(InputEvent), _peer);
+        }
+        else
+            nsent = _socket.send(reinterpret_cast<const char *>(&event), sizeof(InputEvent));
+
+        if (nsent == -1)
             cerrWithErrno("An error occurred during send: ");
     }
 
+    void InputTransmitter::sendRaw(const InputEvent& event) const {
+        _sendEvent(event, 0);
+    }
+
+    void InputTransmitter::setRecorder(net::RecordingWriter* recorder) {
+        _recorder = recorder;
+    }
+
     bool InputTransmitter::recv(InputEvent* event) const {
-        int nrecv = _socket.recv(reinterpret_cast<char*>(event), sizeof(InputEvent), MSG_WAITALL);
+        int nrecv;
+
+        while (true) {
+            if (_datagramListener)
+                nrecv = _socket.recvFrom(reinterpret_cast<char*>(event), sizeof(InputEvent), &_peer);
+            else
+                nrecv = _socket.recv(reinterpret_cast<char*>(event), sizeof(InputEvent), MSG_WAITALL);
+
+            // A stray datagram on the listening port must not end the session
+            if (!_datagramListener || nrecv == -1 || nrecv == sizeof(InputEvent))
+                break;
+
+            cerr << "Ignoring datagram of size " << nrecv << endl;
+        }
 
         if (nrecv == 0) {
             cout << "Connection closed\n";
             return false;
         }
         else if (nrecv == -1) {
-            cerrWithErrno("An error occurred during recv: ");
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                cerrWithErrno("An error occurred during recv: ");
+            return false;
+        }
+        else if (nrecv != sizeof(InputEvent)) {
+            cerr << "Received truncated event of size " << nrecv << endl;
             return false;
         }
 
         event->type = ntohl(event->type);
+        ntohTimestamp(&event->timestamp);
 
         switch (event->type) {
             case InputEventType::EventMouseMotion:
@@ -100,6 +237,12 @@ namespace input {
             case InputEventType::EventKey:
                 event->key.key = ntohl(event->key.key);
                 event->key.pressed = ntohl(event->key.pressed);
+                event->key.scancode = ntohl(event->key.scancode);
+                break;
+
+            case InputEventType::EventPong:
+                ntohTimestamp(&event->pong.origin);
+                ntohTimestamp(&event->pong.receive);
                 break;
         }
 
@@ -135,6 +278,7 @@ namespace input {
 
         if (type == net::UDP) {
             _socket = std::move(listener);
+            _datagramListener = true;
             return true;
         }
 
@@ -150,4 +294,64 @@ namespace input {
         _socket.setNagleAlgorithm(false);
         return true;
     }
+
+    void InputTransmitter::startClockSync(int intervalMs) {
+        if (_clockSyncRunning)
+            return;
+
+        // Wake up regularly to check if we should stop
+        _socket.setReceiveTimeout(intervalMs);
+        _clockSyncRunning = true;
+        _clockSyncThread = std::thread(_clockSyncProcess, this, intervalMs);
+    }
+
+    void InputTransmitter::stopClockSync() {
+        if (!_clockSyncThread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> guard(_clockSyncMutex);
+            _clockSyncRunning = false;
+        }
+        _clockSyncCondition.notify_all();
+        _clockSyncThread.join();
+    }
+
+    const net::ClockSync& InputTransmitter::getClockSync() const {
+        return _clockSync;
+    }
+
+    void InputTransmitter::_clockSyncProcess(InputTransmitter* self, int intervalMs) {
+        const auto interval = std::chrono::milliseconds(intervalMs);
+        int numSamples = 0;
+
+        while (self->_clockSyncRunning) {
+            const auto deadline = std::chrono::steady_clock::now() + interval;
+            self->sendPing();
+
+            // Pongs of earlier pings that arrive late are still valid samples, albeit with a
+            // high RTT, which the filter in ClockSync takes care of.
+            InputEvent event;
+            errno = 0;
+
+            if (self->recv(&event)) {
+                const int64_t t3 = util::monotonicTimeUs();
+
+                if (event.type == EventPong
+                        && self->_clockSync.addSample(timestampToUs(event.pong.origin),
+                            timestampToUs(event.pong.receive), timestampToUs(event.timestamp), t3)
+                        && numSamples++ % clock_sync_log_interval == 0) {
+                    cout << "Clock sync: offset " << self->_clockSync.offset() << "us, RTT "
+                         << self->_clockSync.rtt() << "us\n";
+                }
+            }
+            else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                cerr << "Clock sync stopped\n";
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(self->_clockSyncMutex);
+            self->_clockSyncCondition.wait_until(lock, deadline, [self] { return !self->_clockSyncRunning; });
+        }
+    }
 } // namespace input
@@ -3,7 +3,13 @@
 
 #include <SDL_keyboard.h>
 #include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "network/socket.hpp"
+#include "network/recording.hpp"
+#include "network/clocksync.hpp"
 
 namespace input {
     // NOTE: We use int32 for everything to have complete control over alignment and endianness.
@@ -24,43 +30,117 @@ namespace input {
     };
 
     struct Key {
-        int32_t key;
+        int32_t key;       // SDL keycode
         uint32_t pressed;
+        int32_t scancode;  // SDL scancode, i.e. the physical key
+    };
+
+    // Microseconds of a monotonic clock, split in two halves to keep 4 byte alignment.
+    struct Timestamp {
+        uint32_t high;
+        uint32_t low;
+    };
+
+    // Response to an EventPing
+    struct Pong {
+        Timestamp origin;   // Timestamp of the ping, i.e. its send time in the frontend's clock
+        Timestamp receive;  // Receive time of the ping in syncinput's clock
     };
 
     enum InputEventType : uint32_t {
         EventMouseMotion,
         EventMouseWheel,
         EventMouseButton,
-        EventKey
+        EventKey,
+        EventPing,  // Clock synchronization request, no payload
+        EventPong
     };
 
     struct InputEvent {
         uint32_t type;
+
+        // Send time of the event. For input events, this is expressed in syncinput's clock, i.e.
+        // corrected by the estimated clock offset. For pings and pongs, it is the sender's clock.
+        Timestamp timestamp;
+
         union {
             MouseMotion motion;
             MouseWheel wheel;
             MouseButton button;
             Key key;
+            Pong pong;
         };
     };
 
+    Timestamp makeTimestamp(int64_t us);
+    int64_t timestampToUs(const Timestamp& timestamp);
+
+    // Create a key event in host byte order
+    InputEvent makeKeyEvent(const SDL_Keysym& key, bool pressed);
+
     class InputTransmitter
     {
         public:
+            ~InputTransmitter();
+
             bool connect(const char* host, const char* port, net::SocketType type, int maxTries = 5);
             bool listen(const char* host, const char* port, net::SocketType type);
             void sendMouseButton(uint8_t button, bool pressed) const;
             void sendMouseMotion(int32_t x, int32_t y) const;
             void sendMouseWheel(int32_t x, int32_t y) const;
             void sendKey(const SDL_Keysym& key, bool pressed) const;
+
+            // Send an input event in host byte order.
+            // If the timestamp is non-zero, it is interpreted as the time the input occurred in the
+            // local monotonic clock, otherwise the current time is used.
+            void send(const InputEvent& event) const;
+            void sendPing() const;
+
+            // Answer a ping received at the given time in the local clock.
+            void sendPong(const InputEvent& ping, int64_t receiveTimeUs) const;
+
+            // Returns false on error, when the connection was closed, or when the receive timeout
+            // expired. Datagrams of the wrong size are skipped.
             bool recv(InputEvent* event) const;
 
+            // Send an event that is already in network byte order, e.g. from a recording.
+            // The timestamp is replaced with the current time.
+            void sendRaw(const InputEvent& event) const;
+
+            // Record all sent input events to the given recording. Pass nullptr to stop recording.
+            void setRecorder(net::RecordingWriter* recorder);
+
+            // Start a thread that periodically pings the remote to estimate the clock offset.
+            // Input events are then timestamped in the remote's clock.
+            // Until the first pong arrives, both clocks are assumed to be equal, which holds when
+            // both sides run on the same host.
+            // This thread becomes the only reader of the connection.
+            void startClockSync(int intervalMs = 1000);
+            void stopClockSync();
+            const net::ClockSync& getClockSync() const;
+
         private:
+            // Stamp, record and send an input event in network byte order.
+            // If timeUs is 0, the current time is used.
+            void _sendEvent(InputEvent event, int64_t timeUs) const;
             void _send(const InputEvent& event) const;
 
+            static void _clockSyncProcess(InputTransmitter* self, int intervalMs);
+
         private:
             net::Socket _socket;
+            net::RecordingWriter* _recorder = nullptr;
+            mutable std::mutex _sendMutex;
+
+            // Only used when listening on UDP to send pongs back to the last sender
+            bool _datagramListener = false;
+            mutable net::Address _peer;
+
+            net::ClockSync _clockSync;
+            std::thread _clockSyncThread;
+            std::atomic<bool> _clockSyncRunning = false;
+            std::mutex _clockSyncMutex;
+            std::condition_variable _clockSyncCondition;
     };
 }
 
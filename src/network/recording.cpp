@@ -0,0 +1,164 @@
+#include "recording.hpp"
+#include "util/clock.hpp"
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+using std::cerr;
+using std::endl;
+
+namespace net {
+    constexpr size_t record_alignment = 8;
+
+    static size_t alignRecord(size_t size) {
+        return (size + record_alignment - 1) & ~(record_alignment - 1);
+    }
+
+    uint64_t recordingTimeUs() {
+        return util::monotonicTimeUs();
+    }
+
+
+    RecordingWriter::RecordingWriter() : _file(nullptr) {}
+
+    RecordingWriter::~RecordingWriter() {
+        close();
+    }
+
+    bool RecordingWriter::open(const char* path, uint32_t numChannels) {
+        close();
+        _file = fopen(path, "wb");
+
+        if (!_file) {
+            cerr << "Failed to open recording " << path << ": " << std::strerror(errno) << endl;
+            return false;
+        }
+
+        FileHeader header;
+        memcpy(header.magic, recording_magic, sizeof(header.magic));
+        header.numChannels = numChannels;
+        header.reserved = 0;
+
+        if (fwrite(&header, sizeof(header), 1, _file) != 1) {
+            cerr << "Failed to write recording header\n";
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void RecordingWriter::close() {
+        if (_file) {
+            fclose(_file);
+            _file = nullptr;
+        }
+    }
+
+    bool RecordingWriter::isOpen() const {
+        return _file != nullptr;
+    }
+
+    bool RecordingWriter::write(uint32_t channel, const char* data, uint32_t size, uint64_t timestampUs) {
+        static const char padding[record_alignment] = {};
+
+        RecordHeader header;
+        header.timestampUs = timestampUs ? timestampUs : recordingTimeUs();
+        header.channel = channel;
+        header.size = size;
+
+        size_t paddingSize = alignRecord(size) - size;
+
+        return fwrite(&header, sizeof(header), 1, _file) == 1
+            && fwrite(data, 1, size, _file) == size
+            && fwrite(padding, 1, paddingSize, _file) == paddingSize;
+    }
+
+
+    RecordingReader::RecordingReader() : _data(nullptr), _size(0), _offset(0) {}
+
+    RecordingReader::~RecordingReader() {
+        close();
+    }
+
+    bool RecordingReader::open(const char* path) {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1) {
+            cerr << "Failed to open recording " << path << ": " << std::strerror(errno) << endl;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+            cerr << "Invalid recording " << path << endl;
+            ::close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            cerr << "Failed to map recording " << path << ": " << std::strerror(errno) << endl;
+            return false;
+        }
+
+        _data = static_cast<const char*>(data);
+        _size = st.st_size;
+
+        if (memcmp(_data, recording_magic, sizeof(recording_magic)) != 0) {
+            cerr << "Invalid recording " << path << endl;
+            close();
+            return false;
+        }
+
+        // Records are read sequentially
+        madvise(data, _size, MADV_SEQUENTIAL);
+        rewind();
+        return true;
+    }
+
+    void RecordingReader::close() {
+        if (_data) {
+            munmap(const_cast<char*>(_data), _size);
+            _data = nullptr;
+            _size = 0;
+            _offset = 0;
+        }
+    }
+
+    uint32_t RecordingReader::numChannels() const {
+        return reinterpret_cast<const FileHeader*>(_data)->numChannels;
+    }
+
+    bool RecordingReader::next(Record* record) {
+        if (_offset + sizeof(RecordHeader) > _size)
+            return false;
+
+        auto header = reinterpret_cast<const RecordHeader*>(_data + _offset);
+
+        if (_offset + sizeof(RecordHeader) + header->size > _size) {
+            cerr << "Truncated record at offset " << _offset << endl;
+            return false;
+        }
+
+        record->timestampUs = header->timestampUs;
+        record->channel = header->channel;
+        record->size = header->size;
+        record->data = _data + _offset + sizeof(RecordHeader);
+        _offset += sizeof(RecordHeader) + alignRecord(header->size);
+        return true;
+    }
+
+    void RecordingReader::rewind() {
+        _offset = sizeof(FileHeader);
+    }
+} // namespace net
@@ -0,0 +1,92 @@
+#ifndef NETWORK_RECORDING_HPP
+#define NETWORK_RECORDING_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+namespace net {
+    // Compact recording format for timestamped packets.
+    //
+    // File layout:
+    //     FileHeader
+    //     RecordHeader, payload (padded to 8 byte alignment)
+    //     RecordHeader, payload (padded to 8 byte alignment)
+    //     ...
+    //
+    // All values are stored in host byte order. Payloads are stored as-is.
+
+    constexpr char recording_magic[8] = { 'C', 'G', 'B', 'R', 'E', 'C', '0', '1' };
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t numChannels;
+        uint32_t reserved;
+    };
+
+    struct RecordHeader {
+        uint64_t timestampUs;  // Arrival time in microseconds, relative to an arbitrary epoch
+        uint32_t channel;      // User defined channel, e.g. the index of the receiving port
+        uint32_t size;         // Payload size in bytes
+    };
+
+    struct Record {
+        uint64_t timestampUs;
+        uint32_t channel;
+        uint32_t size;
+        const char* data;
+    };
+
+    // Returns the current monotonic time in microseconds.
+    uint64_t recordingTimeUs();
+
+    class RecordingWriter
+    {
+        public:
+            RecordingWriter();
+            ~RecordingWriter();
+
+            RecordingWriter(const RecordingWriter&) = delete;
+            RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+            bool open(const char* path, uint32_t numChannels);
+            void close();
+            bool isOpen() const;
+
+            // Write a packet. Uses the current time if timestampUs is 0.
+            bool write(uint32_t channel, const char* data, uint32_t size, uint64_t timestampUs = 0);
+
+        private:
+            FILE* _file;
+    };
+
+    // Memory-maps a recording and iterates over its records.
+    class RecordingReader
+    {
+        public:
+            RecordingReader();
+            ~RecordingReader();
+
+            RecordingReader(const RecordingReader&) = delete;
+            RecordingReader& operator=(const RecordingReader&) = delete;
+
+            bool open(const char* path);
+            void close();
+
+            uint32_t numChannels() const;
+
+            // Read the next record. Returns false when the end was reached.
+            // The record's data pointer stays valid until the reader is closed.
+            bool next(Record* record);
+
+            // Restart at the first record.
+            void rewind();
+
+        private:
+            const char* _data;
+            size_t _size;
+            size_t _offset;
+    };
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "sharedmemory.hpp"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::endl;
+
+namespace net {
+    // Interval in which open() checks whether the segment was created
+    constexpr auto open_retry_interval = std::chrono::milliseconds(10);
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+            "Atomics in shared memory must be lock-free");
+
+
+    SharedMemory::SharedMemory() : _data(nullptr), _size(0), _name{}, _owner(false) {}
+
+    SharedMemory::~SharedMemory() {
+        close();
+    }
+
+    bool SharedMemory::create(const char* name, size_t size) {
+        close();
+        snprintf(_name, sizeof(_name), "/%s", name);
+        shm_unlink(_name);
+
+        int fd = shm_open(_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            cerr << "Failed to create shared memory " << _name << ": " << std::strerror(errno) << endl;
+            return false;
+        }
+
+        void* data = MAP_FAILED;
+        if (ftruncate(fd, size) == 0)
+            data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            cerr << "Failed to allocate shared memory " << _name << ": " << std::strerror(errno) << endl;
+            shm_unlink(_name);
+            return false;
+        }
+
+        _data = static_cast<uint8_t*>(data);
+        _size = size;
+        _owner = true;
+        return true;
+    }
+
+    bool SharedMemory::open(const char* name, size_t minSize, int timeoutMs) {
+        close();
+        snprintf(_name, sizeof(_name), "/%s", name);
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        // The segment is created with size 0 and resized afterwards
+        while (true) {
+            int fd = shm_open(_name, O_RDWR, 0);
+
+            if (fd != -1) {
+                struct stat st;
+
+                if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= minSize) {
+                    void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    ::close(fd);
+
+                    if (data == MAP_FAILED) {
+                        cerr << "Failed to map shared memory " << _name << ": " << std::strerror(errno) << endl;
+                        return false;
+                    }
+
+                    _data = static_cast<uint8_t*>(data);
+                    _size = st.st_size;
+                    return true;
+                }
+
+                ::close(fd);
+            } else if (errno != ENOENT) {
+                cerr << "Failed to open shared memory " << _name << ": " << std::strerror(errno) << endl;
+                return false;
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                cerr << "Timeout while waiting for shared memory " << _name << endl;
+                return false;
+            }
+
+            std::this_thread::sleep_for(open_retry_interval);
+        }
+    }
+
+    void SharedMemory::close() {
+        if (!_data)
+            return;
+
+        munmap(_data, _size);
+
+        if (_owner)
+            shm_unlink(_name);
+
+        _data = nullptr;
+        _size = 0;
+        _owner = false;
+    }
+
+    bool SharedMemory::isOpen() const {
+        return _data != nullptr;
+    }
+
+    uint8_t* SharedMemory::data() const {
+        return _data;
+    }
+
+    size_t SharedMemory::size() const {
+        return _size;
+    }
+
+
+    void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int64_t timeoutUs) {
+        timespec timeout { .tv_sec = timeoutUs / 1000000, .tv_nsec = (timeoutUs % 1000000) * 1000 };
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+    }
+
+    void futexWake(std::atomic<uint32_t>* word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+} // namespace net
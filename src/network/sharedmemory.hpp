@@ -0,0 +1,44 @@
+#ifndef NET_SHAREDMEMORY_HPP
+#define NET_SHAREDMEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace net {
+    // Named POSIX shared memory segment, mapped read-write.
+    class SharedMemory {
+        public:
+            SharedMemory();
+            SharedMemory(const SharedMemory&) = delete;
+            SharedMemory& operator=(const SharedMemory&) = delete;
+            ~SharedMemory();
+
+            // Create the segment /name with the given size, replacing an existing one.
+            // The segment is zero-initialized and removed again by close().
+            bool create(const char* name, size_t size);
+
+            // Attach to the segment /name. Waits up to timeoutMs for it to be created with at
+            // least minSize bytes.
+            bool open(const char* name, size_t minSize, int timeoutMs);
+
+            void close();
+            bool isOpen() const;
+
+            uint8_t* data() const;
+            size_t size() const;
+
+        private:
+            uint8_t* _data;
+            size_t _size;
+            char _name[64];
+            bool _owner;
+    };
+
+    // Futex operations on words in shared memory, i.e. not process-private.
+    // Wait until the word is woken up or timeoutUs elapsed, if it still equals expected.
+    void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int64_t timeoutUs);
+    void futexWake(std::atomic<uint32_t>* word);
+}
+
+#endif
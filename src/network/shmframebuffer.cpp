@@ -0,0 +1,244 @@
+#include "shmframebuffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using std::cerr;
+using std::endl;
+
+namespace net {
+    constexpr uint32_t shm_frame_magic = 0x46524d53;  // "FRMS"
+    constexpr uint32_t shm_frame_version = 1;
+
+    // Layout of the segment: header page, 3 page-aligned buffers
+    constexpr size_t header_size = 4096;
+    constexpr size_t page_size = 4096;
+
+    // Row alignment, matching the widest SIMD stores of the color conversion
+    constexpr int linesize_alignment = 64;
+
+    constexpr int num_buffers = 3;
+    constexpr int num_planes = 3;
+
+    // The state word holds the index of the middle buffer and whether it contains a frame the
+    // consumer did not acquire yet. Initially, the producer owns buffer 0, the consumer buffer 2.
+    constexpr uint32_t index_mask = 0x3;
+    constexpr uint32_t fresh_bit = 0x4;
+    constexpr uint32_t initial_back = 0;
+    constexpr uint32_t initial_middle = 1;
+    constexpr uint32_t initial_front = 2;
+
+    // Interval in which open() checks whether the producer initialized the segment
+    constexpr auto ready_retry_interval = std::chrono::milliseconds(1);
+
+    // Avoid false sharing between producer and consumer
+    constexpr size_t cache_line_size = 64;
+
+    struct ShmFrameHeader {
+        uint32_t magic;
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t linesize[num_planes];
+        uint32_t planeOffset[num_planes];
+        uint64_t bufferSize;
+        std::atomic<uint32_t> ready;
+        std::atomic<uint32_t> closed;
+
+        alignas(cache_line_size) std::atomic<uint32_t> state;
+        std::atomic<uint32_t> sequence;  // Futex word, incremented with every frame
+        std::atomic<uint32_t> waiting;
+        int64_t timeUs[num_buffers];
+    };
+
+    static_assert(sizeof(ShmFrameHeader) <= header_size);
+
+    static size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+
+    ShmFrameBuffer::ShmFrameBuffer() :
+        _header(nullptr), _skipped(0), _back(initial_back), _front(initial_front), _producer(false)
+    {}
+
+    ShmFrameBuffer::~ShmFrameBuffer() {
+        close();
+    }
+
+    bool ShmFrameBuffer::create(const char* name, int width, int height) {
+        close();
+
+        const int chromaWidth = (width + 1) / 2;
+        const int chromaHeight = (height + 1) / 2;
+        const int linesize[] = {
+            static_cast<int>(alignUp(width, linesize_alignment)),
+            static_cast<int>(alignUp(chromaWidth, linesize_alignment)),
+            static_cast<int>(alignUp(chromaWidth, linesize_alignment)),
+        };
+        const size_t planeSize[] = {
+            static_cast<size_t>(linesize[0]) * height,
+            static_cast<size_t>(linesize[1]) * chromaHeight,
+            static_cast<size_t>(linesize[2]) * chromaHeight,
+        };
+        const size_t bufferSize = alignUp(planeSize[0] + planeSize[1] + planeSize[2], page_size);
+
+        if (!_memory.create(name, header_size + num_buffers * bufferSize))
+            return false;
+
+        _header = reinterpret_cast<ShmFrameHeader*>(_memory.data());
+        _producer = true;
+        _back = initial_back;
+
+        _header->magic = shm_frame_magic;
+        _header->version = shm_frame_version;
+        _header->width = width;
+        _header->height = height;
+        _header->bufferSize = bufferSize;
+
+        size_t offset = 0;
+        for (int i = 0; i < num_planes; ++i) {
+            _header->linesize[i] = linesize[i];
+            _header->planeOffset[i] = offset;
+            offset += planeSize[i];
+        }
+
+        _header->state.store(initial_middle, std::memory_order_relaxed);
+        _header->ready.store(1, std::memory_order_release);
+        return true;
+    }
+
+    bool ShmFrameBuffer::open(const char* name, int timeoutMs) {
+        close();
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        if (!_memory.open(name, header_size, timeoutMs))
+            return false;
+
+        auto header = reinterpret_cast<ShmFrameHeader*>(_memory.data());
+
+        // The producer might not have initialized the header yet
+        while (!header->ready.load(std::memory_order_acquire)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                cerr << "Timeout while waiting for shared memory frame buffer " << name << endl;
+                _memory.close();
+                return false;
+            }
+
+            std::this_thread::sleep_for(ready_retry_interval);
+        }
+
+        if (header->magic != shm_frame_magic || header->version != shm_frame_version
+                || _memory.size() < header_size + num_buffers * header->bufferSize) {
+            cerr << "Invalid shared memory frame buffer " << name << endl;
+            _memory.close();
+            return false;
+        }
+
+        _header = header;
+        _front = initial_front;
+        return true;
+    }
+
+    void ShmFrameBuffer::close() {
+        if (!_header)
+            return;
+
+        if (_producer) {
+            _header->closed.store(1, std::memory_order_seq_cst);
+            futexWake(&_header->sequence);
+        }
+
+        _memory.close();
+        _header = nullptr;
+        _producer = false;
+    }
+
+    bool ShmFrameBuffer::isOpen() const {
+        return _header != nullptr;
+    }
+
+    bool ShmFrameBuffer::isClosed() const {
+        return _header->closed.load(std::memory_order_acquire);
+    }
+
+    int ShmFrameBuffer::width() const {
+        return _header->width;
+    }
+
+    int ShmFrameBuffer::height() const {
+        return _header->height;
+    }
+
+    int ShmFrameBuffer::linesize(int plane) const {
+        return _header->linesize[plane];
+    }
+
+    uint64_t ShmFrameBuffer::skipped() const {
+        return _skipped;
+    }
+
+    uint8_t* ShmFrameBuffer::_buffer(uint32_t index) const {
+        return _memory.data() + header_size + index * _header->bufferSize;
+    }
+
+    void ShmFrameBuffer::backBuffer(uint8_t* planes[3]) const {
+        for (int i = 0; i < num_planes; ++i)
+            planes[i] = _buffer(_back) + _header->planeOffset[i];
+    }
+
+    void ShmFrameBuffer::publish(int64_t timeUs) {
+        _header->timeUs[_back] = timeUs;
+
+        const uint32_t previous = _header->state.exchange(_back | fresh_bit, std::memory_order_acq_rel);
+        _back = previous & index_mask;
+
+        if (previous & fresh_bit)
+            ++_skipped;
+
+        _header->sequence.fetch_add(1, std::memory_order_seq_cst);
+
+        // Pairs with the consumer setting waiting before re-checking the state
+        if (_header->waiting.load(std::memory_order_seq_cst))
+            futexWake(&_header->sequence);
+    }
+
+    bool ShmFrameBuffer::wait(int timeoutMs) {
+        using clock = std::chrono::steady_clock;
+
+        const auto deadline = clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while (true) {
+            const uint32_t sequence = _header->sequence.load(std::memory_order_acquire);
+
+            if (_header->state.load(std::memory_order_acquire) & fresh_bit)
+                return true;
+
+            const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock::now()).count();
+
+            if (_header->closed.load(std::memory_order_acquire) || remaining <= 0)
+                return false;
+
+            _header->waiting.store(1, std::memory_order_seq_cst);
+            if (!(_header->state.load(std::memory_order_seq_cst) & fresh_bit))
+                futexWait(&_header->sequence, sequence, remaining);
+            _header->waiting.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void ShmFrameBuffer::acquire() {
+        const uint32_t previous = _header->state.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & index_mask;
+    }
+
+    void ShmFrameBuffer::frontBuffer(const uint8_t* planes[3]) const {
+        for (int i = 0; i < num_planes; ++i)
+            planes[i] = _buffer(_front) + _header->planeOffset[i];
+    }
+
+    int64_t ShmFrameBuffer::frontTimeUs() const {
+        return _header->timeUs[_front];
+    }
+} // namespace net
@@ -0,0 +1,76 @@
+#ifndef NET_SHMFRAMEBUFFER_HPP
+#define NET_SHMFRAMEBUFFER_HPP
+
+#include <cstdint>
+#include "sharedmemory.hpp"
+
+namespace net {
+    struct ShmFrameHeader;
+
+    // Triple buffer of uncompressed yuv420p frames in named POSIX shared memory, for passing
+    // frames between co-located processes without encoding or copying.
+    // The producer always owns a back buffer to write into and never waits. The consumer owns
+    // the front buffer, which stays untouched until it acquires the next frame, i.e. it can be
+    // read in place. Frames published while the consumer is busy replace each other, so the
+    // consumer always gets the most recent one.
+    class ShmFrameBuffer {
+        public:
+            ShmFrameBuffer();
+            ShmFrameBuffer(const ShmFrameBuffer&) = delete;
+            ShmFrameBuffer& operator=(const ShmFrameBuffer&) = delete;
+            ~ShmFrameBuffer();
+
+            // (Producer) Create the segment /name for frames of the given size
+            bool create(const char* name, int width, int height);
+
+            // (Consumer) Attach to the segment /name. Waits up to timeoutMs for the producer to
+            // create it.
+            bool open(const char* name, int timeoutMs);
+
+            // Detaches from the segment. The producer marks the buffer closed and removes the name.
+            void close();
+
+            bool isOpen() const;
+
+            // Returns true if the producer closed the buffer.
+            bool isClosed() const;
+
+            int width() const;
+            int height() const;
+            int linesize(int plane) const;
+
+            // (Producer) Returns the planes of the back buffer.
+            void backBuffer(uint8_t* planes[3]) const;
+
+            // (Producer) Publish the back buffer as the latest frame and get a new back buffer.
+            void publish(int64_t timeUs);
+
+            // (Producer) Number of frames replaced before the consumer acquired them.
+            uint64_t skipped() const;
+
+            // (Consumer) Wait up to timeoutMs for a new frame. Returns false on timeout or if
+            // the buffer was closed.
+            bool wait(int timeoutMs);
+
+            // (Consumer) Make the latest frame the front buffer. Must only be called if wait()
+            // returned true. The previous front buffer is handed back to the producer.
+            void acquire();
+
+            // (Consumer) Returns the planes of the front buffer.
+            void frontBuffer(const uint8_t* planes[3]) const;
+            int64_t frontTimeUs() const;
+
+        private:
+            uint8_t* _buffer(uint32_t index) const;
+
+        private:
+            SharedMemory _memory;
+            ShmFrameHeader* _header;
+            uint64_t _skipped;
+            uint32_t _back;
+            uint32_t _front;
+            bool _producer;
+    };
+}
+
+#endif
@@ -0,0 +1,246 @@
+#include "shmring.hpp"
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using std::cerr;
+using std::endl;
+
+namespace net {
+    constexpr uint32_t shm_ring_magic = 0x52494e47;  // "RING"
+    constexpr uint32_t shm_ring_version = 1;
+
+    // Layout of the segment: header page, metadata, ring
+    constexpr size_t header_size = 4096;
+    constexpr size_t max_metadata_size = 4096;
+    constexpr size_t ring_offset = header_size + max_metadata_size;
+
+    constexpr size_t record_alignment = 8;
+    constexpr uint32_t wrap_marker = UINT32_MAX;
+
+    // Interval in which open() checks whether the producer initialized the segment
+    constexpr auto ready_retry_interval = std::chrono::milliseconds(1);
+
+    // Avoid false sharing between producer and consumer
+    constexpr size_t cache_line_size = 64;
+
+    struct ShmRingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity;
+        uint64_t metadataSize;
+        std::atomic<uint32_t> ready;
+        std::atomic<uint32_t> closed;
+
+        // Written by the producer
+        alignas(cache_line_size) std::atomic<uint64_t> writePos;
+        std::atomic<uint32_t> writeSequence;  // Futex word, incremented with every record
+
+        // Written by the consumer
+        alignas(cache_line_size) std::atomic<uint64_t> readPos;
+        std::atomic<uint32_t> waiting;
+    };
+
+    static_assert(sizeof(ShmRingHeader) <= header_size);
+
+    struct RecordHeader {
+        uint32_t size;
+        uint32_t flags;
+        int64_t timeUs;
+    };
+
+    static uint64_t alignRecord(uint64_t size) {
+        return (size + record_alignment - 1) & ~(record_alignment - 1);
+    }
+
+    ShmRing::ShmRing() : _header(nullptr), _pendingRelease(0), _dropped(0), _producer(false) {}
+
+    ShmRing::~ShmRing() {
+        close();
+    }
+
+    bool ShmRing::create(const char* name, size_t capacity, const void* metadata, size_t metadataSize) {
+        close();
+
+        if (metadataSize > max_metadata_size) {
+            cerr << "Shared memory metadata too large: " << metadataSize << " bytes\n";
+            return false;
+        }
+
+        capacity = std::bit_ceil(capacity);
+        if (!_memory.create(name, ring_offset + capacity))
+            return false;
+
+        _header = reinterpret_cast<ShmRingHeader*>(_memory.data());
+        _producer = true;
+
+        // The segment is zero-initialized, i.e. all positions and flags are 0
+        _header->magic = shm_ring_magic;
+        _header->version = shm_ring_version;
+        _header->capacity = capacity;
+        _header->metadataSize = metadataSize;
+        if (metadataSize > 0)
+            memcpy(_memory.data() + header_size, metadata, metadataSize);
+        _header->ready.store(1, std::memory_order_release);
+        return true;
+    }
+
+    bool ShmRing::open(const char* name, int timeoutMs) {
+        close();
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        if (!_memory.open(name, ring_offset, timeoutMs))
+            return false;
+
+        auto header = reinterpret_cast<ShmRingHeader*>(_memory.data());
+
+        // The producer might not have initialized the header yet
+        while (!header->ready.load(std::memory_order_acquire)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                cerr << "Timeout while waiting for shared memory ring " << name << endl;
+                _memory.close();
+                return false;
+            }
+
+            std::this_thread::sleep_for(ready_retry_interval);
+        }
+
+        if (header->magic != shm_ring_magic || header->version != shm_ring_version
+                || _memory.size() < ring_offset + header->capacity) {
+            cerr << "Invalid shared memory ring " << name << endl;
+            _memory.close();
+            return false;
+        }
+
+        _header = header;
+        return true;
+    }
+
+    void ShmRing::close() {
+        if (!_header)
+            return;
+
+        if (_producer) {
+            _header->closed.store(1, std::memory_order_seq_cst);
+            futexWake(&_header->writeSequence);
+        }
+
+        _memory.close();
+        _header = nullptr;
+        _pendingRelease = 0;
+        _producer = false;
+    }
+
+    bool ShmRing::isOpen() const {
+        return _header != nullptr;
+    }
+
+    bool ShmRing::isClosed() const {
+        return _header->closed.load(std::memory_order_acquire);
+    }
+
+    const uint8_t* ShmRing::metadata() const {
+        return _memory.data() + header_size;
+    }
+
+    size_t ShmRing::metadataSize() const {
+        return _header->metadataSize;
+    }
+
+    uint64_t ShmRing::dropped() const {
+        return _dropped;
+    }
+
+    uint8_t* ShmRing::_ring() const {
+        return _memory.data() + ring_offset;
+    }
+
+    bool ShmRing::write(const void* data, uint32_t size, uint32_t flags, int64_t timeUs) {
+        const uint64_t capacity = _header->capacity;
+        const uint64_t length = sizeof(RecordHeader) + alignRecord(size);
+        const uint64_t pos = _header->writePos.load(std::memory_order_relaxed);
+        const uint64_t offset = pos & (capacity - 1);
+
+        // Records are contiguous, i.e. skip the rest of the ring if the record does not fit
+        const uint64_t padding = offset + length > capacity ? capacity - offset : 0;
+        const uint64_t used = pos - _header->readPos.load(std::memory_order_acquire);
+
+        if (padding + length > capacity - used) {
+            ++_dropped;
+            return false;
+        }
+
+        if (padding >= sizeof(RecordHeader))
+            reinterpret_cast<RecordHeader*>(_ring() + offset)->size = wrap_marker;
+
+        const uint64_t start = pos + padding;
+        auto header = reinterpret_cast<RecordHeader*>(_ring() + (start & (capacity - 1)));
+        header->size = size;
+        header->flags = flags;
+        header->timeUs = timeUs;
+        memcpy(header + 1, data, size);
+
+        _header->writePos.store(start + length, std::memory_order_release);
+        _header->writeSequence.fetch_add(1, std::memory_order_seq_cst);
+
+        // Pairs with the consumer setting waiting before re-checking writePos
+        if (_header->waiting.load(std::memory_order_seq_cst))
+            futexWake(&_header->writeSequence);
+
+        return true;
+    }
+
+    bool ShmRing::read(Record* record, int timeoutMs) {
+        using clock = std::chrono::steady_clock;
+
+        release();
+
+        const uint64_t capacity = _header->capacity;
+        uint64_t pos = _header->readPos.load(std::memory_order_relaxed);
+        const auto deadline = clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while (true) {
+            const uint32_t sequence = _header->writeSequence.load(std::memory_order_acquire);
+
+            if (pos != _header->writePos.load(std::memory_order_acquire))
+                break;
+
+            const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock::now()).count();
+
+            if (_header->closed.load(std::memory_order_acquire) || remaining <= 0)
+                return false;
+
+            _header->waiting.store(1, std::memory_order_seq_cst);
+            if (pos == _header->writePos.load(std::memory_order_seq_cst))
+                futexWait(&_header->writeSequence, sequence, remaining);
+            _header->waiting.store(0, std::memory_order_relaxed);
+        }
+
+        const uint64_t offset = pos & (capacity - 1);
+        auto header = reinterpret_cast<const RecordHeader*>(_ring() + offset);
+
+        if (capacity - offset < sizeof(RecordHeader) || header->size == wrap_marker) {
+            pos += capacity - offset;
+            header = reinterpret_cast<const RecordHeader*>(_ring());
+        }
+
+        record->data = reinterpret_cast<const uint8_t*>(header + 1);
+        record->size = header->size;
+        record->flags = header->flags;
+        record->timeUs = header->timeUs;
+        _pendingRelease = pos + sizeof(RecordHeader) + alignRecord(header->size);
+        return true;
+    }
+
+    void ShmRing::release() {
+        if (_pendingRelease) {
+            _header->readPos.store(_pendingRelease, std::memory_order_release);
+            _pendingRelease = 0;
+        }
+    }
+} // namespace net
@@ -0,0 +1,86 @@
+#ifndef NET_SHMRING_HPP
+#define NET_SHMRING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "sharedmemory.hpp"
+
+namespace net {
+    struct ShmRingHeader;
+
+    // Single-producer single-consumer ring of variable-sized records in named POSIX shared
+    // memory, for transferring data between co-located processes without the network stack.
+    // The consumer sleeps on a futex in the shared segment, which the producer only wakes if
+    // the consumer is actually waiting.
+    // The producer never blocks, i.e. records are dropped if the consumer falls behind.
+    // Additionally, the producer can publish a metadata blob once, e.g. codec parameters.
+    class ShmRing {
+        public:
+            struct Record {
+                const uint8_t* data;
+                uint32_t size;
+                uint32_t flags;
+                int64_t timeUs;
+            };
+
+        public:
+            ShmRing();
+            ShmRing(const ShmRing&) = delete;
+            ShmRing& operator=(const ShmRing&) = delete;
+            ~ShmRing();
+
+            // (Producer) Create the segment /name, replacing an existing one. The capacity is
+            // rounded up to a power of two.
+            bool create(const char* name, size_t capacity, const void* metadata, size_t metadataSize);
+
+            // (Consumer) Attach to the segment /name. Waits up to timeoutMs for the producer to
+            // create it.
+            bool open(const char* name, int timeoutMs);
+
+            // Detaches from the segment. The producer marks the ring closed and removes the name.
+            void close();
+
+            bool isOpen() const;
+
+            // Returns true if the producer closed the ring.
+            bool isClosed() const;
+
+            const uint8_t* metadata() const;
+            size_t metadataSize() const;
+
+            // (Producer) Append a record. Returns false if it does not fit, i.e. it was dropped.
+            bool write(const void* data, uint32_t size, uint32_t flags, int64_t timeUs);
+
+            // (Producer) Number of records dropped because the ring was full.
+            uint64_t dropped() const;
+
+            // (Consumer) Wait up to timeoutMs for the next record. Its data points into the ring
+            // and remains valid until release() is called. Returns false on timeout or if the
+            // ring was closed.
+            bool read(Record* record, int timeoutMs);
+
+            // (Consumer) Release the record returned by the last read().
+            void release();
+
+        private:
+            uint8_t* _ring() const;
+
+        private:
+            SharedMemory _memory;
+            ShmRingHeader* _header;
+            uint64_t _pendingRelease;
+            uint64_t _dropped;
+            bool _producer;
+    };
+
+    // Stream description published as ring metadata by the streamer's shared-memory output,
+    // followed by extradataSize bytes of codec extradata, i.e. the H.264 parameter sets.
+    struct ShmStreamInfo {
+        uint32_t codecId;  // AVCodecID
+        int32_t width;
+        int32_t height;
+        uint32_t extradataSize;
+    };
+}
+
+#endif
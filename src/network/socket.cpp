@@ -1,4 +1,5 @@
 #include "socket.hpp"
+#include <cstdint>
 #include <cstring>
 #include <cctype>
 #include <algorithm>
@@ -9,10 +10,20 @@
 #ifdef __linux__
 #   include <sys/socket.h>
 #   include <netinet/tcp.h>
+#   include <netinet/udp.h>
+#   include <sys/time.h>
 #   include <unistd.h>
 #   include <netdb.h>
 #   define closesocket(socket) close(socket)
 constexpr int INVALID_SOCKET = -1;
+
+// Missing in older glibc headers
+#   ifndef UDP_SEGMENT
+#       define UDP_SEGMENT 103
+#   endif
+#   ifndef UDP_GRO
+#       define UDP_GRO 104
+#   endif
 #endif
 
 namespace net {
@@ -106,6 +117,23 @@ namespace net {
         setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
     }
 
+    bool Socket::setReceiveBufferSize(int bytes) const {
+        return setsockopt(_socket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&bytes), sizeof(bytes)) == 0;
+    }
+
+    bool Socket::setSendBufferSize(int bytes) const {
+        return setsockopt(_socket, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&bytes), sizeof(bytes)) == 0;
+    }
+
+    bool Socket::setReceiveTimeout(int ms) const {
+#ifdef _WIN32
+        DWORD timeout = ms;
+#else
+        timeval timeout { .tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000 };
+#endif
+        return setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == 0;
+    }
+
     void Socket::close() {
         if (!isValid())
             return;
@@ -137,6 +165,49 @@ namespace net {
         return ::recv(_socket, buffer, bufsize, flags);
     }
 
+    int Socket::sendTo(const char* buffer, unsigned int bufsize, const Address& address, int flags) const {
+        return ::sendto(_socket, buffer, bufsize, flags,
+                reinterpret_cast<const sockaddr*>(&address.storage), address.length);
+    }
+
+    int Socket::recvFrom(char* buffer, unsigned int bufsize, Address* address, int flags) const {
+        address->length = sizeof(address->storage);
+        return ::recvfrom(_socket, buffer, bufsize, flags,
+                reinterpret_cast<sockaddr*>(&address->storage), &address->length);
+    }
+
+    int Socket::sendSegments(const char* buffer, unsigned int bufsize, unsigned int segmentSize) const {
+#ifdef __linux__
+        iovec iov { .iov_base = const_cast<char*>(buffer), .iov_len = bufsize };
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] {};
+        msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        const uint16_t size = segmentSize;
+        memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+
+        return ::sendmsg(_socket, &msg, 0);
+#else
+        return -1;
+#endif
+    }
+
+    bool Socket::setReceiveCoalescing(bool enabled) const {
+#ifdef __linux__
+        const int val = enabled;
+        return setsockopt(_socket, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0;
+#else
+        return !enabled;
+#endif
+    }
+
     Socket Socket::accept() const {
         return Socket(::accept(_socket, nullptr, nullptr));
     }
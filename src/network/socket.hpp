@@ -4,6 +4,7 @@
 #include <string>
 
 #ifdef __linux__
+#   include <sys/socket.h>
 typedef int SOCKET;
 #elif defined(_WIN32)
 #   include <winsock2.h>
@@ -21,6 +22,12 @@ namespace net {
 
     SocketType parseProtocol(std::string str);
 
+    // Peer address of a datagram socket
+    struct Address {
+        sockaddr_storage storage;
+        socklen_t length = 0;
+    };
+
     class Socket
     {
         public:
@@ -37,12 +44,27 @@ namespace net {
             SOCKET handle() const;
             void close();
             void setNagleAlgorithm(bool active) const;
+            bool setReceiveBufferSize(int bytes) const;
+            bool setSendBufferSize(int bytes) const;
+            bool setReceiveTimeout(int ms) const;
             bool isValid() const;
 
             bool connect(SocketType type, const char* host, const char* port);
             bool listen(SocketType type, const char* host, const char* port);
             int send(const char* buffer, unsigned int bufsize, int flags = 0) const;
             int recv(char* buffer, unsigned int bufsize, int flags = 0) const;
+            int sendTo(const char* buffer, unsigned int bufsize, const Address& address, int flags = 0) const;
+            int recvFrom(char* buffer, unsigned int bufsize, Address* address, int flags = 0) const;
+
+            // Send the buffer as consecutive datagrams of segmentSize bytes, the last one may be
+            // shorter, in a single call using UDP generic segmentation offload (UDP_SEGMENT,
+            // Linux >= 4.18). Returns -1 if it is not supported. See UdpBatchSender.
+            int sendSegments(const char* buffer, unsigned int bufsize, unsigned int segmentSize) const;
+
+            // Let the kernel coalesce consecutive datagrams of a flow into a single buffer on
+            // receive (UDP_GRO, Linux >= 5.0). See UdpBatchReceiver.
+            bool setReceiveCoalescing(bool enabled) const;
+
             Socket accept() const;
 
         protected:
@@ -0,0 +1,237 @@
+#include "udpbatch.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#   include <netinet/in.h>
+#   include <netinet/udp.h>
+#   include <sys/socket.h>
+
+#   ifndef UDP_GRO
+#       define UDP_GRO 104
+#   endif
+#endif
+
+namespace net {
+#ifdef __linux__
+    // Control message space per datagram for the UDP_GRO segment size
+    constexpr size_t control_size = CMSG_SPACE(sizeof(int));
+#endif
+
+
+    UdpBatchSender::UdpBatchSender() :
+        _socket(nullptr), _datagrams(0), _calls(0), _dropped(0), _segmentation(false)
+    {}
+
+    void UdpBatchSender::init(const Socket* socket, bool segmentation) {
+        _socket = socket;
+        _segmentation = segmentation;
+    }
+
+    void UdpBatchSender::add(const uint8_t* data, size_t size) {
+        _offsets.push_back(_buffer.size());
+        _buffer.insert(_buffer.end(), data, data + size);
+    }
+
+    bool UdpBatchSender::flush() {
+        bool success = true;
+        const size_t num = _offsets.size();
+        auto sizeOf = [this, num](size_t i) {
+            return (i + 1 < num ? _offsets[i + 1] : _buffer.size()) - _offsets[i];
+        };
+
+        for (size_t first = 0; first < num;) {
+            const size_t segmentSize = sizeOf(first);
+            size_t count = 1;
+            size_t bytes = segmentSize;
+
+            if (_segmentation) {
+                // Extend the run by datagrams of the same size
+                while (first + count < num && count < max_segments && sizeOf(first + count) == segmentSize
+                        && bytes + segmentSize <= max_run_bytes) {
+                    bytes += segmentSize;
+                    count++;
+                }
+
+                // The last segment may be shorter
+                if (first + count < num && count < max_segments && sizeOf(first + count) < segmentSize
+                        && bytes + sizeOf(first + count) <= max_run_bytes) {
+                    bytes += sizeOf(first + count);
+                    count++;
+                }
+            }
+
+            success &= _sendRun(first, count, segmentSize);
+            first += count;
+        }
+
+        _buffer.clear();
+        _offsets.clear();
+        return success;
+    }
+
+    bool UdpBatchSender::_sendRun(size_t first, size_t count, size_t segmentSize) {
+        const char* data = reinterpret_cast<const char*>(_buffer.data() + _offsets[first]);
+        const size_t end = first + count < _offsets.size() ? _offsets[first + count] : _buffer.size();
+        const size_t bytes = end - _offsets[first];
+
+        if (count > 1) {
+            _calls++;
+            if (_socket->sendSegments(data, bytes, segmentSize) == static_cast<int>(bytes)) {
+                _datagrams += count;
+                return true;
+            }
+
+            // The receiver is not up yet. The ICMP error is reported on the connected socket,
+            // where an unconnected sendto() would not notice, so drop the run silently.
+            if (errno == ECONNREFUSED) {
+                _dropped += count;
+                return true;
+            }
+
+            // Not supported by the kernel or the device, e.g. EIO without checksum offload.
+            // Anything else, e.g. a transient ENOBUFS, only fails this run.
+            if (errno != EIO && errno != EINVAL && errno != EOPNOTSUPP && errno != ENOPROTOOPT)
+                return false;
+
+            std::cerr << "UDP segmentation offload failed (" << strerror(errno) << "), sending datagrams individually\n";
+            _segmentation = false;
+        }
+
+        bool success = true;
+        for (size_t i = first; i < first + count; ++i) {
+            const size_t next = i + 1 < _offsets.size() ? _offsets[i + 1] : _buffer.size();
+            const int size = next - _offsets[i];
+            _calls++;
+
+            if (_socket->send(reinterpret_cast<const char*>(_buffer.data() + _offsets[i]), size) == size)
+                _datagrams++;
+            else if (errno == ECONNREFUSED)
+                _dropped++;
+            else
+                success = false;
+        }
+
+        return success;
+    }
+
+    bool UdpBatchSender::segmentation() const {
+        return _segmentation;
+    }
+
+    uint64_t UdpBatchSender::datagrams() const {
+        return _datagrams;
+    }
+
+    uint64_t UdpBatchSender::calls() const {
+        return _calls;
+    }
+
+    uint64_t UdpBatchSender::dropped() const {
+        return _dropped;
+    }
+
+
+    UdpBatchReceiver::UdpBatchReceiver() :
+        _socket(nullptr), _numReceived(0), _slot(0), _offset(0), _datagrams(0), _calls(0), _coalescing(false)
+    {}
+
+    void UdpBatchReceiver::init(const Socket* socket, size_t numBuffers) {
+        _socket = socket;
+        _buffers.resize(numBuffers * buffer_size);
+        _slots.resize(numBuffers);
+        _coalescing = socket->setReceiveCoalescing(true);
+
+#ifdef __linux__
+        _messages.resize(numBuffers);
+        _iovs.resize(numBuffers);
+        _control.resize(numBuffers * control_size);
+#endif
+
+        if (!_coalescing)
+            std::cerr << "UDP receive coalescing not supported, receiving datagrams individually\n";
+    }
+
+    bool UdpBatchReceiver::receive() {
+        _numReceived = _slot = _offset = 0;
+
+#ifdef __linux__
+        const size_t num = _slots.size();
+
+        // Reset, as the kernel updates the lengths
+        for (size_t i = 0; i < num; ++i) {
+            _iovs[i] = { .iov_base = _buffers.data() + i * buffer_size, .iov_len = buffer_size };
+            _messages[i].msg_hdr = {};
+            _messages[i].msg_hdr.msg_iov = &_iovs[i];
+            _messages[i].msg_hdr.msg_iovlen = 1;
+            _messages[i].msg_hdr.msg_control = _control.data() + i * control_size;
+            _messages[i].msg_hdr.msg_controllen = control_size;
+        }
+
+        // Wait for the first datagram only, then take whatever else is queued
+        const int received = recvmmsg(_socket->handle(), _messages.data(), num, MSG_WAITFORONE, nullptr);
+        _calls++;
+
+        if (received <= 0)
+            return false;
+
+        for (int i = 0; i < received; ++i) {
+            Slot& slot = _slots[i];
+            slot.size = _messages[i].msg_len;
+            slot.segmentSize = 0;
+
+            msghdr& hdr = _messages[i].msg_hdr;
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                    int segmentSize;
+                    memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+                    slot.segmentSize = segmentSize;
+                }
+            }
+        }
+
+        _numReceived = received;
+        return true;
+#else
+        const int received = _socket->recv(reinterpret_cast<char*>(_buffers.data()), buffer_size);
+        _calls++;
+
+        if (received <= 0)
+            return false;
+
+        _slots[0] = { .size = static_cast<size_t>(received), .segmentSize = 0 };
+        _numReceived = 1;
+        return true;
+#endif
+    }
+
+    bool UdpBatchReceiver::next(const uint8_t** data, size_t* size) {
+        while (_slot < _numReceived) {
+            const Slot& slot = _slots[_slot];
+
+            if (_offset < slot.size) {
+                const size_t remaining = slot.size - _offset;
+                *size = slot.segmentSize > 0 ? std::min(slot.segmentSize, remaining) : remaining;
+                *data = _buffers.data() + _slot * buffer_size + _offset;
+                _offset += *size;
+                _datagrams++;
+                return true;
+            }
+
+            _slot++;
+            _offset = 0;
+        }
+
+        return false;
+    }
+
+    uint64_t UdpBatchReceiver::datagrams() const {
+        return _datagrams;
+    }
+
+    uint64_t UdpBatchReceiver::calls() const {
+        return _calls;
+    }
+}
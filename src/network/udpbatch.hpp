@@ -0,0 +1,99 @@
+#ifndef NET_UDPBATCH_HPP
+#define NET_UDPBATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "socket.hpp"
+
+namespace net {
+    // Collects datagrams and sends them with as few system calls as possible. Runs of datagrams
+    // of equal size, optionally followed by a shorter one, are sent in a single call using UDP
+    // generic segmentation offload, i.e. the kernel splits them. This matches RTP packetization,
+    // where a frame is fragmented into packets of maximum size followed by a remainder.
+    // Falls back to one call per datagram, if the kernel does not support segmentation.
+    // Datagrams refused by the receiver, i.e. while it is not listening yet, are dropped.
+    class UdpBatchSender {
+        public:
+            UdpBatchSender();
+
+            // The socket must be connected and outlive the sender.
+            void init(const Socket* socket, bool segmentation);
+
+            // Queue a datagram until the next flush().
+            void add(const uint8_t* data, size_t size);
+
+            // Send all queued datagrams. Returns false if sending failed.
+            bool flush();
+
+            bool segmentation() const;
+            uint64_t datagrams() const;
+            uint64_t calls() const;
+            uint64_t dropped() const;
+
+        private:
+            bool _sendRun(size_t first, size_t count, size_t segmentSize);
+
+        private:
+            // Limits of the kernel per segmentation call
+            static constexpr size_t max_segments = 64;
+            static constexpr size_t max_run_bytes = 65000;
+
+        private:
+            const Socket* _socket;
+            std::vector<uint8_t> _buffer;   // Queued datagrams, back to back
+            std::vector<size_t> _offsets;   // Start of each datagram in _buffer
+            uint64_t _datagrams;
+            uint64_t _calls;
+            uint64_t _dropped;
+            bool _segmentation;
+    };
+
+    // Receives datagrams in batches with recvmmsg(). If the kernel coalesced datagrams of the same
+    // flow (UDP_GRO), they are split up again, so the caller sees the original datagrams.
+    class UdpBatchReceiver {
+        public:
+            UdpBatchReceiver();
+
+            // Allocate buffers for up to numBuffers coalesced datagrams per batch and enable
+            // receive coalescing on the socket, if available. The socket must outlive the receiver.
+            void init(const Socket* socket, size_t numBuffers);
+
+            // Receive a batch, waiting up to the socket's receive timeout for the first datagram.
+            // Returns false on timeout or error.
+            bool receive();
+
+            // Returns the next datagram of the current batch, or false if it is exhausted.
+            bool next(const uint8_t** data, size_t* size);
+
+            uint64_t datagrams() const;
+            uint64_t calls() const;
+
+        private:
+            struct Slot {
+                size_t size = 0;         // Received bytes
+                size_t segmentSize = 0;  // Size of the coalesced datagrams, 0 if not coalesced
+            };
+
+            // Coalesced datagrams never exceed the maximum IP packet size
+            static constexpr size_t buffer_size = 65536;
+
+        private:
+            const Socket* _socket;
+            std::vector<uint8_t> _buffers;
+            std::vector<Slot> _slots;
+#ifdef __linux__
+            std::vector<mmsghdr> _messages;
+            std::vector<iovec> _iovs;
+            std::vector<char> _control;
+#endif
+            size_t _numReceived;
+            size_t _slot;                // Current slot of the batch
+            size_t _offset;              // Position in the current slot
+            uint64_t _datagrams;
+            uint64_t _calls;
+            bool _coalescing;
+    };
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "udppacer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "util/clock.hpp"
+
+namespace net {
+    UdpPacer::UdpPacer() :
+        _sender(nullptr), _commits(0), _burstSize(1), _windowUs(0), _running(false)
+    {}
+
+    UdpPacer::~UdpPacer() {
+        stop();
+    }
+
+    void UdpPacer::start(UdpBatchSender* sender, int64_t windowUs, size_t burstSize) {
+        _sender = sender;
+        _windowUs = windowUs;
+        _burstSize = burstSize;
+        _running = true;
+        _thread = std::thread(_process, this);
+    }
+
+    void UdpPacer::stop() {
+        if (!_thread.joinable())
+            return;
+
+        commit();
+
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            _running = false;
+        }
+
+        _cond.notify_all();
+        _thread.join();
+    }
+
+    bool UdpPacer::isRunning() const {
+        return _thread.joinable();
+    }
+
+    void UdpPacer::add(const uint8_t* data, size_t size) {
+        std::vector<uint8_t> buffer;
+
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            if (!_free.empty()) {
+                buffer = std::move(_free.back());
+                _free.pop_back();
+            }
+        }
+
+        buffer.assign(data, data + size);
+        _pending.push_back({ .data = std::move(buffer) });
+    }
+
+    void UdpPacer::commit() {
+        if (_pending.empty())
+            return;
+
+        const int64_t now = util::monotonicTimeUs();
+        Frame frame { .size = 0, .bytes = 0, .deadlineUs = now + _windowUs };
+
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            for (Datagram& datagram : _pending) {
+                datagram.committedUs = now;
+                frame.size += datagram.data.size();
+                frame.bytes += datagram.data.size();
+                _queue.push_back(std::move(datagram));
+            }
+            if (frame.bytes > 0)
+                _frames.push_back(frame);
+            _commits++;
+        }
+
+        _pending.clear();
+        _cond.notify_all();
+    }
+
+    void UdpPacer::printDelay(std::ostream& out) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _delay.print(out, "Pacing delay");
+        _delay.reset();
+    }
+
+    void UdpPacer::_process(UdpPacer* self) {
+        std::vector<Datagram> burst;
+        std::unique_lock<std::mutex> lock(self->_mutex);
+
+        while (true) {
+            self->_cond.wait(lock, [self] { return !self->_queue.empty() || !self->_running; });
+
+            // Only stops once the queue is drained
+            if (self->_queue.empty())
+                break;
+
+            const int64_t now = util::monotonicTimeUs();
+            size_t bytes = 0;
+            size_t frameSize = 0;
+
+            while (!self->_queue.empty() && burst.size() < self->_burstSize) {
+                Datagram& datagram = self->_queue.front();
+                const size_t size = datagram.data.size();
+                self->_delay.add(now - datagram.committedUs);
+                bytes += size;
+                burst.push_back(std::move(datagram));
+                self->_queue.pop_front();
+
+                if (size == 0)
+                    continue;
+
+                Frame& frame = self->_frames.front();
+                frameSize = frame.size;
+                frame.bytes -= size;
+                if (frame.bytes == 0)
+                    self->_frames.pop_front();
+            }
+
+            lock.unlock();
+
+            for (const Datagram& datagram : burst)
+                self->_sender->add(datagram.data.data(), datagram.data.size());
+
+            if (!self->_sender->flush())
+                std::cerr << "Failed to send paced packets\n";
+
+            lock.lock();
+            for (Datagram& datagram : burst)
+                self->_free.push_back(std::move(datagram.data));
+            burst.clear();
+
+            // A commit during the wait may require a higher rate, so the wait is recomputed.
+            // Stopping drains the rest without pacing.
+            while (self->_running) {
+                const int64_t waitUs = now + self->_leakTimeUs(bytes, frameSize, now) - util::monotonicTimeUs();
+                const uint64_t commits = self->_commits;
+
+                if (waitUs <= 0 || !self->_cond.wait_for(lock, std::chrono::microseconds(waitUs),
+                            [self, commits] { return !self->_running || self->_commits != commits; }))
+                    break;
+            }
+        }
+    }
+
+    int64_t UdpPacer::_leakTimeUs(size_t bytes, size_t frameSize, int64_t sentUs) const {
+        if (frameSize == 0)
+            return 0;
+
+        // Frame i meets its deadline if everything up to and including it, plus the burst that
+        // was just sent, leaks until then. The highest of these rates meets all deadlines.
+        int64_t waitUs = _windowUs * static_cast<int64_t>(bytes) / static_cast<int64_t>(frameSize);
+        size_t cumulative = bytes;
+
+        for (const Frame& frame : _frames) {
+            const int64_t remainingUs = frame.deadlineUs - sentUs;
+            if (remainingUs <= 0)
+                return 0;
+
+            cumulative += frame.bytes;
+            waitUs = std::min(waitUs, remainingUs * static_cast<int64_t>(bytes) / static_cast<int64_t>(cumulative));
+        }
+
+        return waitUs;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef NET_UDPPACER_HPP
+#define NET_UDPPACER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "udpbatch.hpp"
+#include "util/histogram.hpp"
+
+namespace net {
+    // Leaky bucket in front of a UdpBatchSender. Datagrams are collected per frame and sent by
+    // a separate thread in bursts of a few datagrams. Each frame has to be sent within the send
+    // window after its commit(). Each frame leaks at the rate that spreads it over the window,
+    // or faster if that is needed to meet the deadlines of all queued frames. I.e. a keyframe of
+    // hundreds of packets is spread over the window instead of hitting the receiver's socket
+    // buffer at line rate, while a frame that fits into a single burst goes out right away, or
+    // right after the frame in front of it.
+    // A new frame never slows down the frames in front of it, so pacing never delays a frame by
+    // more than the window.
+    class UdpPacer {
+        public:
+            UdpPacer();
+            UdpPacer(const UdpPacer&) = delete;
+            UdpPacer& operator=(const UdpPacer&) = delete;
+            ~UdpPacer();
+
+            // Start the send thread. The sender must outlive the pacer and must not be used
+            // otherwise until stop().
+            void start(UdpBatchSender* sender, int64_t windowUs, size_t burstSize);
+
+            // Send the remaining datagrams and stop the send thread.
+            void stop();
+
+            bool isRunning() const;
+
+            // Queue a datagram until the next commit().
+            void add(const uint8_t* data, size_t size);
+
+            // Hand the datagrams added since the last commit to the send thread, to be sent
+            // within the window.
+            void commit();
+
+            // Print the queueing delay of the datagrams sent since the last call, i.e. the time
+            // from commit() to the send call. (Thread-safe)
+            void printDelay(std::ostream& out);
+
+        private:
+            struct Datagram {
+                std::vector<uint8_t> data;
+                int64_t committedUs = 0;
+            };
+
+            struct Frame {
+                size_t size;            // Total bytes
+                size_t bytes;           // Bytes not yet sent
+                int64_t deadlineUs;
+            };
+
+            static void _process(UdpPacer* self);
+
+            // Time to wait after sending the given number of bytes of a frame of the given size at
+            // the given time, such that the remaining frames still meet their deadlines.
+            // Requires the lock.
+            int64_t _leakTimeUs(size_t bytes, size_t frameSize, int64_t sentUs) const;
+
+        private:
+            UdpBatchSender* _sender;
+            std::thread _thread;
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            std::vector<Datagram> _pending;             // Added, not yet committed
+            std::deque<Datagram> _queue;                // Committed, waiting to be sent
+            std::deque<Frame> _frames;                  // Frames of the datagrams in _queue
+            std::vector<std::vector<uint8_t>> _free;    // Buffers of sent datagrams for reuse
+            util::Histogram _delay;
+            uint64_t _commits;
+            size_t _burstSize;
+            int64_t _windowUs;
+            bool _running;
+    };
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#include <poll.h>
+#include "network/socket.hpp"
+#include "network/recording.hpp"
+#include "util/config.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Maximum UDP payload size
+constexpr int max_packet_size = 65536;
+
+// Socket receive buffer size. Same as in the frontend.
+constexpr int receive_buffer_size = 20971520;
+
+// Minimum gap between packets when replaying at speed 0, i.e. at most 20000 packets per second or about
+// 235 Mbit/s. Sending at loopback rate overflows the frontend's socket buffer within a keyframe.
+constexpr int64_t fast_replay_packet_gap_us = 50;
+
+static volatile std::sig_atomic_t running = 1;
+
+
+void help() {
+    cout << "Usage: rtpreplay record <file> <ip> <port,port,...>\n";
+    cout << "       rtpreplay replay <file> <ip> <port,port,...> [speed]\n";
+    cout << "Records incoming UDP packets (RTP/RTCP) on the given ports including their arrival times, or replays a recording to the given ports.\n";
+    cout << "Each port defines a channel in the recording, hence the same port order must be used for recording and replaying.\n";
+    cout << "Speed is a factor applied to the original timing, e.g. 2 replays twice as fast. Default: 1\n";
+    cout << "Speed 0 replays as fast as possible, but at most one packet every " << fast_replay_packet_gap_us << " us. A receiver that decodes slower than that still drops packets, check its loss statistics.\n";
+    cout << "The arguments can also be given as mode, file, host, ports and speed options in the [rtpreplay] section of a config file passed with config=<file>.\n";
+}
+
+void stop([[maybe_unused]] int signal) {
+    running = 0;
+}
+
+std::vector<std::string> splitPorts(const char* str) {
+    std::vector<std::string> ports;
+    std::string s = str;
+    size_t start = 0, end;
+
+    while ((end = s.find(',', start)) != std::string::npos) {
+        ports.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+
+    ports.push_back(s.substr(start));
+    return ports;
+}
+
+
+int record(const char* path, const char* host, const std::vector<std::string>& ports) {
+    std::vector<net::Socket> sockets(ports.size());
+    std::vector<pollfd> fds(ports.size());
+
+    for (size_t i = 0; i < ports.size(); ++i) {
+        if (!sockets[i].listen(net::UDP, host, ports[i].c_str())) {
+            cerr << "Failed to listen on " << host << ":" << ports[i] << endl;
+            return 1;
+        }
+
+        sockets[i].setReceiveBufferSize(receive_buffer_size);
+        fds[i].fd = sockets[i].handle();
+        fds[i].events = POLLIN;
+    }
+
+    net::RecordingWriter writer;
+    if (!writer.open(path, ports.size()))
+        return 1;
+
+    cout << "Recording to " << path << ", press Ctrl-C to stop\n";
+
+    std::vector<char> buffer(max_packet_size);
+    size_t numPackets = 0, numBytes = 0;
+
+    while (running) {
+        if (poll(fds.data(), fds.size(), 100) <= 0)
+            continue;
+
+        // Take the timestamp as early as possible
+        uint64_t now = net::recordingTimeUs();
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!(fds[i].revents & POLLIN))
+                continue;
+
+            int nrecv = sockets[i].recv(buffer.data(), buffer.size());
+            if (nrecv <= 0)
+                continue;
+
+            if (!writer.write(i, buffer.data(), nrecv, now)) {
+                cerr << "Failed to write record\n";
+                return 1;
+            }
+
+            numPackets++;
+            numBytes += nrecv;
+        }
+    }
+
+    cout << "Recorded " << numPackets << " packets, " << numBytes << " bytes\n";
+    return 0;
+}
+
+
+int replay(const char* path, const char* host, const std::vector<std::string>& ports, double speed) {
+    using clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    net::RecordingReader reader;
+    if (!reader.open(path))
+        return 1;
+
+    if (reader.numChannels() != ports.size())
+        cerr << "Warning: Recording has " << reader.numChannels() << " channels, but " << ports.size() << " ports were given\n";
+
+    std::vector<net::Socket> sockets(ports.size());
+
+    for (size_t i = 0; i < ports.size(); ++i) {
+        if (!sockets[i].connect(net::UDP, host, ports[i].c_str())) {
+            cerr << "Failed to connect to " << host << ":" << ports[i] << endl;
+            return 1;
+        }
+    }
+
+    cout << "Replaying " << path << " at speed " << speed << endl;
+
+    net::Record record;
+    size_t numPackets = 0;
+    uint64_t firstTimestamp = 0;
+    auto start = clock::now();
+
+    while (running && reader.next(&record)) {
+        if (numPackets == 0)
+            firstTimestamp = record.timestampUs;
+
+        if (record.channel >= sockets.size())
+            continue;
+
+        if (speed > 0) {
+            auto offset = microseconds(static_cast<int64_t>((record.timestampUs - firstTimestamp) / speed));
+            std::this_thread::sleep_until(start + offset);
+        } else {
+            // Scheduled relative to the start, so oversleeping once does not slow down the replay
+            std::this_thread::sleep_until(start + microseconds(static_cast<int64_t>(numPackets) * fast_replay_packet_gap_us));
+        }
+
+        if (sockets[record.channel].send(record.data, record.size) == -1)
+            cerr << "Failed to send packet: " << std::strerror(errno) << endl;
+
+        numPackets++;
+    }
+
+    auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    cout << "Replayed " << numPackets << " packets in " << elapsed << "s\n";
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    util::Config config("rtpreplay");
+    if (!config.parseArgs(argc, argv, { "mode", "file", "host", "ports", "speed" }))
+        return 1;
+
+    if (const char* key = config.missing({ "mode", "file", "host", "ports" })) {
+        help();
+        cerr << "Missing option: " << key << endl;
+        return 1;
+    }
+
+    const std::string mode = config.getString("mode");
+    const std::string path = config.getString("file");
+    const std::string host = config.getString("host");
+    auto ports = splitPorts(config.getString("ports").c_str());
+    const double speed = config.getFloat("speed", 1.0);
+
+    if (!config.check())
+        return 1;
+    config.print(cout);
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    if (mode == "record")
+        return record(path.c_str(), host.c_str(), ports);
+    else if (mode == "replay")
+        return replay(path.c_str(), host.c_str(), ports, speed);
+
+    help();
+    cerr << "Unknown mode: " << mode << endl;
+    return 1;
+}
@@ -0,0 +1,148 @@
+#include "capture.hpp"
+#include <X11/Xutil.h>
+#include <iostream>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+using std::cerr;
+using std::endl;
+
+namespace streamer {
+    ShmImage::ShmImage() : _display(nullptr), _image(nullptr) {
+        _shm.shmid = -1;
+        _shm.shmaddr = nullptr;
+    }
+
+    ShmImage::~ShmImage() {
+        destroy();
+    }
+
+    bool ShmImage::create(Display* display, Visual* visual, int depth, int width, int height) {
+        destroy();
+        _display = display;
+
+        if (!XShmQueryExtension(_display)) {
+            cerr << "XShm extension not available\n";
+            return false;
+        }
+
+        _image = XShmCreateImage(_display, visual, depth, ZPixmap, nullptr, &_shm, width, height);
+
+        if (!_image || _image->bits_per_pixel != 32) {
+            cerr << "Failed to create a 32 bit shared memory image\n";
+            destroy();
+            return false;
+        }
+
+        _shm.shmid = shmget(IPC_PRIVATE, _image->bytes_per_line * _image->height, IPC_CREAT | 0600);
+
+        if (_shm.shmid == -1) {
+            cerr << "Failed to allocate shared memory segment\n";
+            destroy();
+            return false;
+        }
+
+        void* addr = shmat(_shm.shmid, nullptr, 0);
+
+        // Mark for deletion right away, so it does not leak if we crash. It stays alive while attached.
+        shmctl(_shm.shmid, IPC_RMID, nullptr);
+
+        if (addr == reinterpret_cast<void*>(-1)) {
+            cerr << "Failed to attach shared memory segment\n";
+            destroy();
+            return false;
+        }
+
+        _shm.shmaddr = _image->data = static_cast<char*>(addr);
+        _shm.readOnly = False;
+
+        if (!XShmAttach(_display, &_shm)) {
+            cerr << "Failed to attach shared memory segment\n";
+            destroy();
+            return false;
+        }
+
+        XSync(_display, False);
+        return true;
+    }
+
+    void ShmImage::destroy() {
+        if (_shm.shmaddr) {
+            XShmDetach(_display, &_shm);
+            shmdt(_shm.shmaddr);
+            _shm.shmaddr = nullptr;
+        }
+
+        if (_image) {
+            _image->data = nullptr;  // Owned by the shared memory segment
+            XDestroyImage(_image);
+            _image = nullptr;
+        }
+    }
+
+    bool ShmImage::get(Drawable drawable) {
+        return XShmGetImage(_display, drawable, _image, 0, 0, AllPlanes);
+    }
+
+    XImage* ShmImage::image() const {
+        return _image;
+    }
+
+
+    X11Capture::X11Capture() : _display(nullptr) {}
+
+    X11Capture::~X11Capture() {
+        close();
+    }
+
+    bool X11Capture::open(const char* display, int width, int height) {
+        close();
+        _display = XOpenDisplay(display);
+
+        if (!_display) {
+            cerr << "Failed to open display " << (display ? display : "") << endl;
+            return false;
+        }
+
+        int screen = DefaultScreen(_display);
+        if (!_image.create(_display, DefaultVisual(_display, screen), DefaultDepth(_display, screen), width, height)) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void X11Capture::close() {
+        _image.destroy();
+
+        if (_display) {
+            XCloseDisplay(_display);
+            _display = nullptr;
+        }
+    }
+
+    bool X11Capture::grab() {
+        return _image.get(DefaultRootWindow(_display));
+    }
+
+    bool X11Capture::changed() const {
+        return true;
+    }
+
+    const uint8_t* X11Capture::data() const {
+        return reinterpret_cast<const uint8_t*>(_image.image()->data);
+    }
+
+    int X11Capture::stride() const {
+        return _image.image()->bytes_per_line;
+    }
+
+    int X11Capture::width() const {
+        return _image.image()->width;
+    }
+
+    int X11Capture::height() const {
+        return _image.image()->height;
+    }
+} // namespace streamer
@@ -0,0 +1,76 @@
+#ifndef STREAMER_CAPTURE_HPP
+#define STREAMER_CAPTURE_HPP
+
+#include <cstdint>
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+namespace streamer {
+    // Screen capture backend. Frames are 32 bit BGRX.
+    class ICapture {
+        public:
+            virtual ~ICapture() = default;
+
+            // Capture the current screen content. The result is available through data() until
+            // the next call.
+            virtual bool grab() = 0;
+
+            // Returns false if the screen content did not change since the previous grab(), i.e.
+            // the previous frame can be reused. Backends without change tracking always return true.
+            virtual bool changed() const = 0;
+
+            virtual const uint8_t* data() const = 0;
+            virtual int stride() const = 0;
+            virtual int width() const = 0;
+            virtual int height() const = 0;
+    };
+
+    // 32 bit XImage whose pixels are stored in a shared memory segment attached to the X server,
+    // so XShmGetImage() transfers them without going through the socket.
+    class ShmImage {
+        public:
+            ShmImage();
+            ShmImage(const ShmImage&) = delete;
+            ShmImage& operator=(const ShmImage&) = delete;
+            ~ShmImage();
+
+            bool create(Display* display, Visual* visual, int depth, int width, int height);
+            void destroy();
+
+            // Read the top left area of the given drawable, which must be at least as large as the image.
+            bool get(Drawable drawable);
+
+            XImage* image() const;
+
+        private:
+            Display* _display;
+            XImage* _image;
+            XShmSegmentInfo _shm;
+    };
+
+    // Captures the root window of an X display into a shared memory segment using XShm.
+    class X11Capture final : public ICapture {
+        public:
+            X11Capture();
+            X11Capture(const X11Capture&) = delete;
+            X11Capture& operator=(const X11Capture&) = delete;
+            ~X11Capture() final;
+
+            bool open(const char* display, int width, int height);
+            void close();
+
+            bool grab() final;
+            bool changed() const final;
+
+            const uint8_t* data() const final;
+            int stride() const final;
+            int width() const final;
+            int height() const final;
+
+        private:
+            Display* _display;
+            ShmImage _image;
+    };
+}
+
+#endif
@@ -0,0 +1,428 @@
+#include "colorconv.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define COLORCONV_X86
+#   include <immintrin.h>
+#endif
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+// BT.601 limited range, 8 bit fixed-point coefficients:
+//   Y = (( 66 R + 129 G +  25 B + 128) >> 8) + 16
+//   U = ((-38 R -  74 G + 112 B + 128) >> 8) + 128
+//   V = ((112 R -  94 G -  18 B + 128) >> 8) + 128
+// Chroma is computed from the sum of a 2x2 block, hence the additional shift by 2.
+// Since the formulas are linear, the sum can be taken before or after the multiplication,
+// which the SIMD kernels use to postpone the horizontal additions.
+// Pixels are stored as BGRX in memory. All kernels produce bit-identical results.
+
+namespace streamer {
+    using RowPairFunc = void(*)(const uint8_t*, const uint8_t*, int, uint8_t*, uint8_t*, uint8_t*, uint8_t*);
+
+    static inline uint8_t lumaScalar(const uint8_t* p) {
+        return ((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16;
+    }
+
+    // Converts the pixels [x, width) of the row pair. x must be even.
+    static void convertScalar(const uint8_t* src0, const uint8_t* src1, int x, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        for (; x < width; x += 2) {
+            // Duplicate the last column if the width is odd
+            const int x1 = std::min(x + 1, width - 1);
+            const uint8_t* p[] = { src0 + x * 4, src0 + x1 * 4, src1 + x * 4, src1 + x1 * 4 };
+
+            y0[x] = lumaScalar(p[0]);
+            y1[x] = lumaScalar(p[2]);
+            if (x1 != x) {
+                y0[x1] = lumaScalar(p[1]);
+                y1[x1] = lumaScalar(p[3]);
+            }
+
+            const int b = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+            const int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+            const int r = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+
+            u[x / 2] = ((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128;
+            v[x / 2] = ((112 * r - 94 * g - 18 * b + 512) >> 10) + 128;
+        }
+    }
+
+    static void convertRowPairScalar(const uint8_t* src0, const uint8_t* src1, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        convertScalar(src0, src1, 0, width, y0, y1, u, v);
+    }
+
+#ifdef COLORCONV_X86
+    // Coefficients in BGRX order for use with madd
+#   define COEFFS_Y     25,  129,  66, 0
+#   define COEFFS_U    112,  -74, -38, 0
+#   define COEFFS_V    -18,  -94, 112, 0
+
+    // Packs 4 coefficients into 64 bit for broadcasting
+    static constexpr int64_t packCoeffs(int16_t b, int16_t g, int16_t r, int16_t x) {
+        return static_cast<int64_t>(static_cast<uint16_t>(b))
+            | static_cast<int64_t>(static_cast<uint16_t>(g)) << 16
+            | static_cast<int64_t>(static_cast<uint16_t>(r)) << 32
+            | static_cast<int64_t>(static_cast<uint16_t>(x)) << 48;
+    }
+
+#   define TARGET_SSSE3 __attribute__((target("ssse3")))
+#   define TARGET_AVX2 __attribute__((target("avx2")))
+#   define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+
+    // Returns the luma of 4 pixels given as 16 bit integers
+    TARGET_SSSE3 static inline __m128i lumaSSSE3(__m128i lo, __m128i hi) {
+        const __m128i coeff = _mm_setr_epi16(COEFFS_Y, COEFFS_Y);
+        __m128i sum = _mm_hadd_epi32(_mm_madd_epi16(lo, coeff), _mm_madd_epi16(hi, coeff));
+        return _mm_add_epi32(_mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8), _mm_set1_epi32(16));
+    }
+
+    // Returns 4 chroma samples as bytes in the lower 32 bit, given 4 pixel pairs of summed rows
+    TARGET_SSSE3 static inline int32_t chromaSSSE3(const __m128i* sums, __m128i coeff) {
+        __m128i sum = _mm_hadd_epi32(
+                _mm_hadd_epi32(_mm_madd_epi16(sums[0], coeff), _mm_madd_epi16(sums[1], coeff)),
+                _mm_hadd_epi32(_mm_madd_epi16(sums[2], coeff), _mm_madd_epi16(sums[3], coeff)));
+        sum = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(512)), 10), _mm_set1_epi32(128));
+        __m128i packed = _mm_packs_epi32(sum, sum);
+        return _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+    }
+
+    // 8 pixels per iteration
+    TARGET_SSSE3 static void convertRowPairSSSE3(const uint8_t* src0, const uint8_t* src1, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i coeffU = _mm_setr_epi16(COEFFS_U, COEFFS_U);
+        const __m128i coeffV = _mm_setr_epi16(COEFFS_V, COEFFS_V);
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i sums[4];
+            __m128i luma0[2];
+            __m128i luma1[2];
+
+            for (int i = 0; i < 2; ++i) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + x * 4) + i);
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + x * 4) + i);
+                const __m128i alo = _mm_unpacklo_epi8(a, zero);
+                const __m128i ahi = _mm_unpackhi_epi8(a, zero);
+                const __m128i blo = _mm_unpacklo_epi8(b, zero);
+                const __m128i bhi = _mm_unpackhi_epi8(b, zero);
+
+                luma0[i] = lumaSSSE3(alo, ahi);
+                luma1[i] = lumaSSSE3(blo, bhi);
+                sums[i * 2] = _mm_add_epi16(alo, blo);
+                sums[i * 2 + 1] = _mm_add_epi16(ahi, bhi);
+            }
+
+            const __m128i packed0 = _mm_packs_epi32(luma0[0], luma0[1]);
+            const __m128i packed1 = _mm_packs_epi32(luma1[0], luma1[1]);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(packed0, packed0));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(packed1, packed1));
+
+            const int32_t chromaU = chromaSSSE3(sums, coeffU);
+            const int32_t chromaV = chromaSSSE3(sums, coeffV);
+            memcpy(u + x / 2, &chromaU, sizeof(chromaU));
+            memcpy(v + x / 2, &chromaV, sizeof(chromaV));
+        }
+
+        convertScalar(src0, src1, x, width, y0, y1, u, v);
+    }
+
+    // Returns the luma of 8 pixels given as 16 bit integers
+    TARGET_AVX2 static inline __m256i lumaAVX2(__m256i lo, __m256i hi) {
+        const __m256i coeff = _mm256_setr_epi16(COEFFS_Y, COEFFS_Y, COEFFS_Y, COEFFS_Y);
+        __m256i sum = _mm256_hadd_epi32(_mm256_madd_epi16(lo, coeff), _mm256_madd_epi16(hi, coeff));
+        return _mm256_add_epi32(_mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8), _mm256_set1_epi32(16));
+    }
+
+    // Packs 16 luma values to bytes
+    TARGET_AVX2 static inline __m128i packLumaAVX2(__m256i first, __m256i second) {
+        // packs operates on 128 bit lanes, i.e. the 64 bit blocks must be reordered
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), 0xd8);
+        return _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+    }
+
+    // Returns 8 chroma samples as bytes in the lower 64 bit, given 8 pixel pairs of summed rows
+    TARGET_AVX2 static inline __m128i chromaAVX2(const __m256i* sums, __m256i coeff) {
+        // The unpack and hadd instructions operate on 128 bit lanes, which interleaves the samples
+        // of both lanes. The permutation restores their order.
+        __m256i sum = _mm256_hadd_epi32(
+                _mm256_hadd_epi32(_mm256_madd_epi16(sums[0], coeff), _mm256_madd_epi16(sums[1], coeff)),
+                _mm256_hadd_epi32(_mm256_madd_epi16(sums[2], coeff), _mm256_madd_epi16(sums[3], coeff)));
+        sum = _mm256_permutevar8x32_epi32(sum, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+        sum = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(512)), 10), _mm256_set1_epi32(128));
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        return _mm_packus_epi16(packed, packed);
+    }
+
+    // 16 pixels per iteration
+    TARGET_AVX2 static void convertRowPairAVX2(const uint8_t* src0, const uint8_t* src1, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i coeffU = _mm256_setr_epi16(COEFFS_U, COEFFS_U, COEFFS_U, COEFFS_U);
+        const __m256i coeffV = _mm256_setr_epi16(COEFFS_V, COEFFS_V, COEFFS_V, COEFFS_V);
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i sums[4];
+            __m256i luma0[2];
+            __m256i luma1[2];
+
+            for (int i = 0; i < 2; ++i) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + x * 4) + i);
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + x * 4) + i);
+                const __m256i alo = _mm256_unpacklo_epi8(a, zero);
+                const __m256i ahi = _mm256_unpackhi_epi8(a, zero);
+                const __m256i blo = _mm256_unpacklo_epi8(b, zero);
+                const __m256i bhi = _mm256_unpackhi_epi8(b, zero);
+
+                luma0[i] = lumaAVX2(alo, ahi);
+                luma1[i] = lumaAVX2(blo, bhi);
+                sums[i * 2] = _mm256_add_epi16(alo, blo);
+                sums[i * 2 + 1] = _mm256_add_epi16(ahi, bhi);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x), packLumaAVX2(luma0[0], luma0[1]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x), packLumaAVX2(luma1[0], luma1[1]));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), chromaAVX2(sums, coeffU));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), chromaAVX2(sums, coeffV));
+        }
+
+        convertScalar(src0, src1, x, width, y0, y1, u, v);
+    }
+
+    // GCC 12's AVX-512 headers trigger false positives (GCC bug 105593)
+#   if defined(__GNUC__) && !defined(__clang__)
+#       pragma GCC diagnostic push
+#       pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#       pragma GCC diagnostic ignored "-Wuninitialized"
+#   endif
+
+    // Returns the luma sums of 8 pixels given as 16 bit integers
+    TARGET_AVX512 static inline __m256i lumaAVX512(__m512i pixels) {
+        const __m512i sum = _mm512_madd_epi16(pixels, _mm512_set1_epi64(packCoeffs(COEFFS_Y)));
+        return _mm512_cvtepi64_epi32(_mm512_add_epi32(sum, _mm512_srli_epi64(sum, 32)));
+    }
+
+    // Returns 16 luma bytes given 16 luma sums
+    TARGET_AVX512 static inline __m128i packLumaAVX512(__m256i first, __m256i second) {
+        __m512i sum = _mm512_inserti64x4(_mm512_castsi256_si512(first), second, 1);
+        sum = _mm512_add_epi32(_mm512_srli_epi32(_mm512_add_epi32(sum, _mm512_set1_epi32(128)), 8), _mm512_set1_epi32(16));
+        return _mm512_cvtepi32_epi8(sum);
+    }
+
+    // Returns 16 chroma samples given 4 blocks of 8 pixels of summed rows. Each 128 bit lane of
+    // a block contains 2 pixels, i.e. the 4 products of a lane add up to one chroma sample.
+    TARGET_AVX512 static inline __m128i chromaAVX512(const __m512i* sums, __m512i coeff) {
+        const __m512i a = _mm512_madd_epi16(sums[0], coeff);
+        const __m512i b = _mm512_madd_epi16(sums[1], coeff);
+        const __m512i c = _mm512_madd_epi16(sums[2], coeff);
+        const __m512i d = _mm512_madd_epi16(sums[3], coeff);
+        const __m512i ab = _mm512_add_epi32(_mm512_unpacklo_epi32(a, b), _mm512_unpackhi_epi32(a, b));
+        const __m512i cd = _mm512_add_epi32(_mm512_unpacklo_epi32(c, d), _mm512_unpackhi_epi32(c, d));
+
+        // Lane k now holds the samples k, 4 + k, 8 + k and 12 + k
+        __m512i sum = _mm512_add_epi32(_mm512_unpacklo_epi64(ab, cd), _mm512_unpackhi_epi64(ab, cd));
+        sum = _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15), sum);
+        sum = _mm512_add_epi32(_mm512_srai_epi32(_mm512_add_epi32(sum, _mm512_set1_epi32(512)), 10), _mm512_set1_epi32(128));
+        return _mm512_cvtepi32_epi8(sum);
+    }
+
+    // 32 pixels per iteration
+    TARGET_AVX512 static void convertRowPairAVX512(const uint8_t* src0, const uint8_t* src1, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        const __m512i coeffU = _mm512_set1_epi64(packCoeffs(COEFFS_U));
+        const __m512i coeffV = _mm512_set1_epi64(packCoeffs(COEFFS_V));
+
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m512i sums[4];
+            __m256i luma0[4];
+            __m256i luma1[4];
+
+            for (int i = 0; i < 4; ++i) {
+                const __m512i a = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + x * 4) + i));
+                const __m512i b = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + x * 4) + i));
+
+                luma0[i] = lumaAVX512(a);
+                luma1[i] = lumaAVX512(b);
+                sums[i] = _mm512_add_epi16(a, b);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x), packLumaAVX512(luma0[0], luma0[1]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x + 16), packLumaAVX512(luma0[2], luma0[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x), packLumaAVX512(luma1[0], luma1[1]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x + 16), packLumaAVX512(luma1[2], luma1[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(u + x / 2), chromaAVX512(sums, coeffU));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(v + x / 2), chromaAVX512(sums, coeffV));
+        }
+
+        convertScalar(src0, src1, x, width, y0, y1, u, v);
+    }
+
+#   if defined(__GNUC__) && !defined(__clang__)
+#       pragma GCC diagnostic pop
+#   endif
+#endif
+
+    static bool isSupported(ColorKernel kernel) {
+        switch (kernel) {
+#ifdef COLORCONV_X86
+            case ColorKernel::AVX512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+            case ColorKernel::AVX2:
+                return __builtin_cpu_supports("avx2");
+            case ColorKernel::SSSE3:
+                return __builtin_cpu_supports("ssse3");
+#endif
+            case ColorKernel::Scalar:
+            case ColorKernel::Swscale:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static RowPairFunc getRowPairFunc(ColorKernel kernel) {
+        switch (kernel) {
+#ifdef COLORCONV_X86
+            case ColorKernel::AVX512:
+                return convertRowPairAVX512;
+            case ColorKernel::AVX2:
+                return convertRowPairAVX2;
+            case ColorKernel::SSSE3:
+                return convertRowPairSSSE3;
+#endif
+            default:
+                return convertRowPairScalar;
+        }
+    }
+
+    const char* colorKernelName(ColorKernel kernel) {
+        switch (kernel) {
+            case ColorKernel::Auto: return "auto";
+            case ColorKernel::AVX512: return "avx512";
+            case ColorKernel::AVX2: return "avx2";
+            case ColorKernel::SSSE3: return "ssse3";
+            case ColorKernel::Scalar: return "scalar";
+            case ColorKernel::Swscale: return "swscale";
+        }
+        return "unknown";
+    }
+
+    bool parseColorKernel(const char* name, ColorKernel* kernel) {
+        for (auto k : { ColorKernel::Auto, ColorKernel::AVX512, ColorKernel::AVX2,
+                ColorKernel::SSSE3, ColorKernel::Scalar, ColorKernel::Swscale }) {
+            if (strcmp(name, colorKernelName(k)) == 0) {
+                *kernel = k;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ColorKernel detectColorKernel() {
+        for (auto kernel : { ColorKernel::AVX512, ColorKernel::AVX2, ColorKernel::SSSE3 })
+            if (isSupported(kernel))
+                return kernel;
+        return ColorKernel::Scalar;
+    }
+
+    void convertRowPair(ColorKernel kernel, const uint8_t* src0, const uint8_t* src1, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        getRowPairFunc(kernel)(src0, src1, width, y0, y1, u, v);
+    }
+
+
+    ColorConverter::ColorConverter() : _pool(nullptr), _kernel(ColorKernel::Scalar), _width(0) {}
+
+    ColorConverter::~ColorConverter() {
+        for (auto& band : _bands)
+            sws_freeContext(band.sws);
+    }
+
+    bool ColorConverter::init(int width, int height, util::WorkerPool* pool, ColorKernel kernel) {
+        if (kernel == ColorKernel::Auto)
+            kernel = detectColorKernel();
+
+        if (!isSupported(kernel)) {
+            std::cerr << "Color conversion kernel " << colorKernelName(kernel) << " is not supported by this CPU\n";
+            return false;
+        }
+
+        _pool = pool;
+        _kernel = kernel;
+        _width = width;
+
+        // Chroma is subsampled vertically, so bands must start at even rows
+        const int numBands = pool->size();
+        const int bandHeight = ((height + numBands - 1) / numBands + 1) & ~1;
+
+        for (int y = 0; y < height; y += bandHeight) {
+            Band band { .y = y, .height = std::min(bandHeight, height - y), .sws = nullptr };
+
+            if (kernel == ColorKernel::Swscale) {
+                band.sws = sws_getContext(width, band.height, AV_PIX_FMT_BGR0,
+                        width, band.height, AV_PIX_FMT_YUV420P, SWS_POINT, nullptr, nullptr, nullptr);
+
+                if (!band.sws) {
+                    std::cerr << "Failed to create color conversion context\n";
+                    return false;
+                }
+            }
+
+            _bands.push_back(band);
+        }
+
+        return true;
+    }
+
+    ColorKernel ColorConverter::kernel() const {
+        return _kernel;
+    }
+
+    void ColorConverter::convert(const uint8_t* src, int srcStride, AVFrame* dst) {
+        _pool->run(_bands.size(), [&](int i) {
+            _convertBand(_bands[i], src, srcStride, dst);
+        });
+    }
+
+    void ColorConverter::_convertBand(const Band& band, const uint8_t* src, int srcStride, AVFrame* dst) const {
+        if (band.sws) {
+            const uint8_t* bandSrc[] = { src + band.y * srcStride };
+            const int bandSrcStride[] = { srcStride };
+            uint8_t* bandDst[] = {
+                dst->data[0] + band.y * dst->linesize[0],
+                dst->data[1] + band.y / 2 * dst->linesize[1],
+                dst->data[2] + band.y / 2 * dst->linesize[2],
+            };
+
+            sws_scale(band.sws, bandSrc, bandSrcStride, 0, band.height, bandDst, dst->linesize);
+            return;
+        }
+
+        const RowPairFunc func = getRowPairFunc(_kernel);
+
+        for (int y = band.y; y < band.y + band.height; y += 2) {
+            // Duplicate the last row if the height is odd
+            const int y1 = std::min(y + 1, band.y + band.height - 1);
+
+            func(src + y * srcStride, src + y1 * srcStride, _width,
+                    dst->data[0] + y * dst->linesize[0],
+                    dst->data[0] + y1 * dst->linesize[0],
+                    dst->data[1] + y / 2 * dst->linesize[1],
+                    dst->data[2] + y / 2 * dst->linesize[2]);
+        }
+    }
+} // namespace streamer
@@ -0,0 +1,69 @@
+#ifndef STREAMER_COLORCONV_HPP
+#define STREAMER_COLORCONV_HPP
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include <cstdint>
+#include <vector>
+#include "util/worker_pool.hpp"
+
+struct SwsContext;
+
+namespace streamer {
+    // Conversion kernels, in order of preference
+    enum class ColorKernel {
+        Auto,
+        AVX512,
+        AVX2,
+        SSSE3,
+        Scalar,
+        Swscale,
+    };
+
+    const char* colorKernelName(ColorKernel kernel);
+
+    // Parse a kernel name as returned by colorKernelName(). Returns false if the name is unknown.
+    bool parseColorKernel(const char* name, ColorKernel* kernel);
+
+    // Returns the fastest kernel supported by the CPU
+    ColorKernel detectColorKernel();
+
+    // Converts a pair of BGRX rows to two rows of Y and one row of U and V (BT.601, limited range).
+    // Chroma is the rounded average of each 2x2 block.
+    void convertRowPair(ColorKernel kernel, const uint8_t* src0, const uint8_t* src1, int width,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v);
+
+    // Converts captured BGRX frames to yuv420p in horizontal bands, processed in parallel by the
+    // given worker pool. Reads directly from the capture buffer, i.e. no intermediate copy.
+    class ColorConverter {
+        public:
+            ColorConverter();
+            ColorConverter(const ColorConverter&) = delete;
+            ColorConverter& operator=(const ColorConverter&) = delete;
+            ~ColorConverter();
+
+            bool init(int width, int height, util::WorkerPool* pool, ColorKernel kernel = ColorKernel::Auto);
+            void convert(const uint8_t* src, int srcStride, AVFrame* dst);
+
+            ColorKernel kernel() const;
+
+        private:
+            struct Band {
+                int y;
+                int height;
+                SwsContext* sws;
+            };
+
+            void _convertBand(const Band& band, const uint8_t* src, int srcStride, AVFrame* dst) const;
+
+        private:
+            std::vector<Band> _bands;
+            util::WorkerPool* _pool;
+            ColorKernel _kernel;
+            int _width;
+    };
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include "capture.hpp"
+#include "colorconv.hpp"
+#include "util/config.hpp"
+#include "util/histogram.hpp"
+#include "util/worker_pool.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+void help() {
+    cout << "Usage: colorconv_bench <width> <height> [flags...]\n";
+    cout << "Measures the BGRX to yuv420p conversion time of all color conversion kernels supported by this CPU.\n";
+    cout << "Kernels are compared against the scalar reference, which is bit-exact to the SIMD kernels but not to swscale.\n";
+    cout << "Flags:\n";
+    cout << "\tconfig=<file>: Read options from the [colorconv_bench] section of the given config file\n";
+    cout << "\tframes=<n>: Number of frames to convert per kernel. Default: 500\n";
+    cout << "\tthreads=<n>: Number of worker threads. Default: number of cores\n";
+    cout << "\tpin=<core>: Pin worker threads to the cores starting at the given core\n";
+    cout << "\tdisplay=<display>: Convert a frame captured from the given X display, i.e. read directly from the XShm buffer, instead of random data\n";
+}
+
+AVFrame* allocFrame(int width, int height) {
+    AVFrame* frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+
+    return frame;
+}
+
+// Returns the maximum absolute difference between the planes of two yuv420p frames
+int maxDifference(const AVFrame* a, const AVFrame* b) {
+    int diff = 0;
+
+    for (int plane = 0; plane < 3; ++plane) {
+        const int width = plane == 0 ? a->width : (a->width + 1) / 2;
+        const int height = plane == 0 ? a->height : (a->height + 1) / 2;
+
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* rowA = a->data[plane] + y * a->linesize[plane];
+            const uint8_t* rowB = b->data[plane] + y * b->linesize[plane];
+
+            for (int x = 0; x < width; ++x)
+                diff = std::max(diff, std::abs(rowA[x] - rowB[x]));
+        }
+    }
+
+    return diff;
+}
+
+
+int main(int argc, char *argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    util::Config config("colorconv_bench");
+    if (!config.parseArgs(argc, argv, { "width", "height" }))
+        return 1;
+
+    if (const char* key = config.missing({ "width", "height" })) {
+        help();
+        cerr << "Missing option: " << key << endl;
+        return 1;
+    }
+
+    const int width = config.getInt("width", 0);
+    const int height = config.getInt("height", 0);
+    const std::string displayName = config.getString("display");
+    const char* display = displayName.empty() ? nullptr : displayName.c_str();
+    const int numFrames = config.getInt("frames", 500);
+    int threads = config.getInt("threads", 0);
+    const int firstCore = config.getInt("pin", -1);
+
+    if (width <= 0 || height <= 0 || numFrames <= 0) {
+        cerr << "Invalid parameters\n";
+        return 1;
+    }
+
+    if (!config.check())
+        return 1;
+    config.print(cout);
+
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Source frame
+    streamer::X11Capture capture;
+    std::vector<uint8_t> buffer;
+    const uint8_t* src;
+    int srcStride;
+
+    if (display) {
+        if (!capture.open(display, width, height) || !capture.grab())
+            return 1;
+
+        src = capture.data();
+        srcStride = capture.stride();
+    } else {
+        std::mt19937 rng(0);
+        buffer.resize(static_cast<size_t>(width) * height * 4);
+        std::generate(buffer.begin(), buffer.end(), [&]() { return static_cast<uint8_t>(rng()); });
+        src = buffer.data();
+        srcStride = width * 4;
+    }
+
+    util::WorkerPool workers;
+    workers.start(threads, firstCore);
+    if (firstCore >= 0)
+        util::pinThreadToCore(firstCore + threads - 1);
+
+    AVFrame* reference = allocFrame(width, height);
+    AVFrame* frame = allocFrame(width, height);
+
+    if (!reference || !frame) {
+        cerr << "Failed to allocate frames\n";
+        return 1;
+    }
+
+    cout << "Converting " << numFrames << " frames of " << width << "x" << height
+        << " using " << threads << " threads" << (display ? ", captured" : ", random data") << endl;
+
+    streamer::ColorConverter scalar;
+    if (!scalar.init(width, height, &workers, streamer::ColorKernel::Scalar))
+        return 1;
+    scalar.convert(src, srcStride, reference);
+
+    for (auto kernel : { streamer::ColorKernel::Swscale, streamer::ColorKernel::Scalar,
+            streamer::ColorKernel::SSSE3, streamer::ColorKernel::AVX2, streamer::ColorKernel::AVX512 }) {
+        streamer::ColorConverter converter;
+        if (!converter.init(width, height, &workers, kernel))
+            continue;
+
+        // Warm up caches and page in the destination
+        converter.convert(src, srcStride, frame);
+
+        util::Histogram times;
+        const auto start = clock::now();
+
+        for (int i = 0; i < numFrames; ++i) {
+            const auto frameStart = clock::now();
+            converter.convert(src, srcStride, frame);
+            times.add(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - frameStart).count());
+        }
+
+        const double totalMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        cout << streamer::colorKernelName(kernel) << ": " << totalMs / numFrames << " ms/frame"
+            << ", p99 " << times.percentile(99) << "us"
+            << ", max " << times.max() << "us"
+            << ", max difference " << maxDifference(reference, frame) << endl;
+    }
+
+    av_frame_free(&frame);
+    av_frame_free(&reference);
+    return 0;
+}
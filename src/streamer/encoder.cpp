@@ -0,0 +1,131 @@
+#include "encoder.hpp"
+#include <iostream>
+#include <string>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace streamer {
+    Encoder::Encoder() :
+        _codec(nullptr), _frame(nullptr), _lastForcedPts(0), _minForcedInterval(0), _numForced(0),
+        _refreshRequested(false)
+    {}
+
+    Encoder::~Encoder() {
+        if (_codec)
+            avcodec_free_context(&_codec);
+        if (_frame)
+            av_frame_free(&_frame);
+    }
+
+    bool Encoder::open(const EncoderOptions& options) {
+        const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+
+        if (!codec) {
+            cerr << "libx264 encoder not available\n";
+            return false;
+        }
+
+        _codec = avcodec_alloc_context3(codec);
+        _codec->width = options.width;
+        _codec->height = options.height;
+        _codec->pix_fmt = AV_PIX_FMT_YUV420P;
+        _codec->time_base = AVRational { 1, options.fps };
+        _codec->framerate = AVRational { options.fps, 1 };
+        _codec->bit_rate = options.bitrate;
+        _codec->max_b_frames = 0;
+        _codec->refs = 1;
+        _codec->thread_count = options.threads;
+        _codec->thread_type = FF_THREAD_SLICE;  // x264 sliced threads
+        _codec->slices = options.threads;
+
+        // Parameter sets are needed in the SDP to open the decoder without probing, but also
+        // in-band, because with intra refresh there is no IDR a late joiner could start from.
+        _codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        std::string params = "repeat-headers=1";
+
+        if (options.intraRefresh) {
+            // Limit frame size fluctuations by capping the VBV buffer to a single frame.
+            _codec->rc_max_rate = options.bitrate;
+            _codec->rc_buffer_size = options.bitrate / options.fps;
+
+            // One refresh wave per second
+            _codec->gop_size = options.fps;
+            params += ":intra-refresh=1";
+        }
+        else {
+            _codec->gop_size = options.fps * 2;
+            av_opt_set_int(_codec->priv_data, "forced-idr", 1, 0);
+        }
+
+        // Loss reports arrive for every corrupted frame until the forced IDR reached the frontend.
+        // At most one IDR per second keeps a burst of reports from causing a burst of IDRs.
+        _minForcedInterval = options.fps;
+        _lastForcedPts = -_minForcedInterval;
+
+        av_opt_set(_codec->priv_data, "preset", "ultrafast", 0);
+        av_opt_set(_codec->priv_data, "tune", "zerolatency", 0);
+        av_opt_set(_codec->priv_data, "x264-params", params.c_str(), 0);
+
+        if (avcodec_open2(_codec, codec, nullptr) < 0) {
+            cerr << "Failed to open encoder\n";
+            return false;
+        }
+
+        _frame = av_frame_alloc();
+        _frame->format = _codec->pix_fmt;
+        _frame->width = _codec->width;
+        _frame->height = _codec->height;
+
+        if (av_frame_get_buffer(_frame, 0) < 0) {
+            cerr << "Failed to allocate frame\n";
+            return false;
+        }
+
+        cout << "Opened encoder: " << options.width << "x" << options.height << "@" << options.fps
+             << ", " << options.bitrate << " bit/s, "
+             << (options.intraRefresh ? "periodic intra refresh" : "periodic IDR") << endl;
+        return true;
+    }
+
+    AVFrame* Encoder::frame() {
+        // The encoder might still reference the previous frame
+        av_frame_make_writable(_frame);
+        return _frame;
+    }
+
+    bool Encoder::send(int64_t pts) {
+        _frame->pts = pts;
+        _frame->pict_type = AV_PICTURE_TYPE_NONE;
+
+        // A request within the interval stays pending until the interval passed
+        if (pts - _lastForcedPts >= _minForcedInterval && _refreshRequested.exchange(false)) {
+            _frame->pict_type = AV_PICTURE_TYPE_I;
+            _lastForcedPts = pts;
+            _numForced++;
+        }
+
+        return avcodec_send_frame(_codec, _frame) == 0;
+    }
+
+    bool Encoder::receive(AVPacket* packet) {
+        return avcodec_receive_packet(_codec, packet) == 0;
+    }
+
+    void Encoder::requestRefresh() {
+        _refreshRequested = true;
+    }
+
+    uint64_t Encoder::forcedKeyframes() const {
+        return _numForced;
+    }
+
+    AVCodecContext* Encoder::context() {
+        return _codec;
+    }
+} // namespace streamer
@@ -0,0 +1,67 @@
+#ifndef STREAMER_ENCODER_HPP
+#define STREAMER_ENCODER_HPP
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <atomic>
+
+namespace streamer {
+    struct EncoderOptions {
+        int width;
+        int height;
+        int fps;
+        int64_t bitrate;
+
+        // Replace periodic IDR frames with a column of intra blocks sweeping over the image
+        // (periodic intra refresh / gradual decoder refresh). Avoids the bitrate spike of full
+        // keyframes, hence queueing delay spikes in the network.
+        bool intraRefresh;
+
+        // Encoder threads. Each thread encodes its own slice of the picture, so that frame latency
+        // does not increase with the number of threads. 0 = automatic
+        int threads;
+    };
+
+    // H.264 encoder based on libx264, tuned for low latency.
+    class Encoder {
+        public:
+            Encoder();
+            Encoder(const Encoder&) = delete;
+            Encoder& operator=(const Encoder&) = delete;
+            ~Encoder();
+
+            bool open(const EncoderOptions& options);
+
+            // Returns the frame to fill with the next picture (yuv420p).
+            AVFrame* frame();
+
+            // Encode the current frame.
+            bool send(int64_t pts);
+
+            // Retrieve the next encoded packet. Returns false if none is available.
+            bool receive(AVPacket* packet);
+
+            // (Thread-safe) Make the decoder recover from any corruption, e.g. after packet loss,
+            // by forcing an IDR frame. Also in intra refresh mode, as libavcodec does not expose
+            // x264's refresh wave control. At most one IDR per second is forced, later requests
+            // are deferred.
+            void requestRefresh();
+
+            // Number of IDR frames forced by requestRefresh()
+            uint64_t forcedKeyframes() const;
+
+            AVCodecContext* context();
+
+        private:
+            AVCodecContext* _codec;
+            AVFrame* _frame;
+            int64_t _lastForcedPts;
+            int64_t _minForcedInterval;     // In frames
+            uint64_t _numForced;
+            std::atomic<bool> _refreshRequested;
+    };
+}
+
+#endif
@@ -0,0 +1,280 @@
+#include "output.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include <libavutil/parseutils.h>
+}
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace streamer {
+    // Maximum SDP size
+    constexpr int max_sdp_size = 4096;
+
+    // Size of the shared memory ring. Holds many seconds of video at typical bitrates, i.e. the
+    // frontend would have to stall considerably before packets are dropped.
+    constexpr size_t shm_ring_capacity = 64 * 1024 * 1024;
+
+    // Maximum RTP packet size, if the URL does not specify pkt_size. Same as libavformat's.
+    constexpr int default_rtp_packet_size = 1472;
+
+    // Packets the pacer sends at once, i.e. about 1 ms at 100 Mbit/s
+    constexpr size_t pacing_burst_size = 8;
+
+
+    RtpOutput::RtpOutput() : _format(nullptr), _io(nullptr), _codecTimeBase { 0, 1 }, _pacingWindowUs(0),
+        _rtcpPackets(0) {}
+
+    RtpOutput::~RtpOutput() {
+        if (!_format)
+            return;
+
+        if (_format->pb)
+            av_write_trailer(_format);
+
+        if (_io) {
+            _pacer.stop();
+            _sender.flush();
+            av_freep(&_io->buffer);
+            avio_context_free(&_io);
+            _format->pb = nullptr;
+        } else {
+            avio_closep(&_format->pb);
+        }
+
+        avformat_free_context(_format);
+    }
+
+    bool RtpOutput::open(const char* url, const AVCodecContext* codec, const char* sdpPath, bool batch) {
+        if (avformat_alloc_output_context2(&_format, nullptr, "rtp", url) < 0) {
+            cerr << "Failed to create RTP muxer\n";
+            return false;
+        }
+
+        AVStream* stream = avformat_new_stream(_format, nullptr);
+        avcodec_parameters_from_context(stream->codecpar, codec);
+        stream->time_base = codec->time_base;
+        _codecTimeBase = codec->time_base;
+
+        if (batch) {
+            if (!_openBatch(url))
+                return false;
+        } else if (avio_open(&_format->pb, url, AVIO_FLAG_WRITE) < 0) {
+            cerr << "Failed to open " << url << endl;
+            return false;
+        } else if (_pacingWindowUs > 0) {
+            cout << "Pacing requires batch sending, sending frames at once\n";
+        }
+
+        if (avformat_write_header(_format, nullptr) < 0) {
+            cerr << "Failed to write RTP header\n";
+            return false;
+        }
+
+        cout << "Streaming to " << url << endl;
+        return _writeSDP(sdpPath);
+    }
+
+    bool RtpOutput::_openBatch(const char* url) {
+        char host[256], path[1024];
+        int port = -1;
+        av_url_split(nullptr, 0, nullptr, 0, host, sizeof(host), &port, path, sizeof(path), url);
+
+        if (port <= 0) {
+            cerr << "Missing port in " << url << endl;
+            return false;
+        }
+
+        int packetSize = default_rtp_packet_size;
+        const char* query = strchr(path, '?');
+        char value[64];
+
+        if (query && av_find_info_tag(value, sizeof(value), "pkt_size", query))
+            packetSize = atoi(value);
+
+        if (!_rtpSocket.connect(net::UDP, host, std::to_string(port).c_str())
+                || !_rtcpSocket.connect(net::UDP, host, std::to_string(port + 1).c_str())) {
+            cerr << "Failed to connect to " << host << ":" << port << endl;
+            return false;
+        }
+
+        if (query && av_find_info_tag(value, sizeof(value), "buffer_size", query))
+            _rtpSocket.setSendBufferSize(atoi(value));
+
+        // The muxer flushes after every packet, so _writePacket() receives one packet per call
+        // of at most max_packet_size bytes
+        uint8_t* buffer = static_cast<uint8_t*>(av_malloc(packetSize));
+        _io = avio_alloc_context(buffer, packetSize, 1, this, nullptr, _writePacket, nullptr);
+        if (!_io) {
+            av_free(buffer);
+            return false;
+        }
+
+        _io->max_packet_size = packetSize;
+        _format->pb = _io;
+        _sender.init(&_rtpSocket, true);
+
+        if (_pacingWindowUs > 0) {
+            _pacer.start(&_sender, _pacingWindowUs, pacing_burst_size);
+            cout << "Pacing frames over " << _pacingWindowUs << " us\n";
+        }
+
+        return true;
+    }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    int RtpOutput::_writePacket(void* opaque, const uint8_t* data, int size) {
+#else
+    int RtpOutput::_writePacket(void* opaque, uint8_t* data, int size) {
+#endif
+        RtpOutput* self = static_cast<RtpOutput*>(opaque);
+
+        // Sender reports and the like, see RTP_PT_IS_RTCP in libavformat's rtp.h
+        const bool rtcp = size >= 2 && ((data[1] >= 192 && data[1] <= 195) || (data[1] >= 200 && data[1] <= 210));
+
+        if (rtcp) {
+            self->_rtcpPackets++;
+            self->_rtcpSocket.send(reinterpret_cast<const char*>(data), size);
+        } else if (self->_pacer.isRunning()) {
+            self->_pacer.add(data, size);
+        } else {
+            self->_sender.add(data, size);
+        }
+
+        return size;
+    }
+
+    void RtpOutput::setPacing(int64_t windowUs) {
+        _pacingWindowUs = windowUs;
+    }
+
+    void RtpOutput::printPacingDelay() {
+        if (_pacer.isRunning())
+            _pacer.printDelay(cout);
+    }
+
+    void RtpOutput::printStats() {
+        if (!_io)
+            return;
+
+        if (_pacer.isRunning()) {
+            _pacer.stop();
+            _pacer.printDelay(cout);
+        }
+
+        cout << "Sent " << _sender.datagrams() << " RTP packets in " << _sender.calls() << " system calls"
+             << (_sender.segmentation() ? " using" : " without") << " UDP segmentation offload, "
+             << _rtcpPackets << " RTCP packets, " << _sender.dropped() << " refused by the receiver" << endl;
+    }
+
+    bool RtpOutput::_writeSDP(const char* path) {
+        char sdp[max_sdp_size];
+
+        if (av_sdp_create(&_format, 1, sdp, sizeof(sdp)) < 0) {
+            cerr << "Failed to create SDP\n";
+            return false;
+        }
+
+        // Announce the resolution, so the frontend can open the decoder without probing the stream.
+        // The size depends on the captured window, see X11WindowCapture.
+        const AVCodecParameters* params = _format->streams[0]->codecpar;
+        std::ofstream file(path);
+        file << sdp << "\n";
+        file << "a=framesize:96 " << params->width << "-" << params->height << "\n";
+
+        if (!file) {
+            cerr << "Failed to write SDP to " << path << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool RtpOutput::write(AVPacket* packet) {
+        packet->stream_index = 0;
+        av_packet_rescale_ts(packet, _codecTimeBase, _format->streams[0]->time_base);
+
+        if (av_write_frame(_format, packet) < 0)
+            return false;
+
+        if (_pacer.isRunning()) {
+            _pacer.commit();
+            return true;
+        }
+
+        // Send the packets of the frame at once
+        return !_io || _sender.flush();
+    }
+
+
+    bool ShmOutput::open(const char* name, const AVCodecContext* codec) {
+        net::ShmStreamInfo info {
+            .codecId = static_cast<uint32_t>(codec->codec_id),
+            .width = codec->width,
+            .height = codec->height,
+            .extradataSize = static_cast<uint32_t>(codec->extradata_size),
+        };
+
+        std::vector<uint8_t> metadata(sizeof(info) + info.extradataSize);
+        memcpy(metadata.data(), &info, sizeof(info));
+        if (info.extradataSize > 0)
+            memcpy(metadata.data() + sizeof(info), codec->extradata, info.extradataSize);
+
+        if (!_ring.create(name, shm_ring_capacity, metadata.data(), metadata.size()))
+            return false;
+
+        cout << "Streaming to shared memory /" << name << endl;
+        return true;
+    }
+
+    bool ShmOutput::write(const AVPacket* packet, int64_t captureTimeUs) {
+        return _ring.write(packet->data, packet->size, packet->flags, captureTimeUs);
+    }
+
+    uint64_t ShmOutput::dropped() const {
+        return _ring.dropped();
+    }
+
+
+    RawOutput::RawOutput() : _frame(nullptr) {}
+
+    RawOutput::~RawOutput() {
+        av_frame_free(&_frame);
+    }
+
+    bool RawOutput::open(const char* name, int width, int height) {
+        if (!_buffer.create(name, width, height))
+            return false;
+
+        // The frame only references the shared memory, it does not own any buffers
+        _frame = av_frame_alloc();
+        _frame->format = AV_PIX_FMT_YUV420P;
+        _frame->width = width;
+        _frame->height = height;
+        for (int i = 0; i < 3; ++i)
+            _frame->linesize[i] = _buffer.linesize(i);
+
+        cout << "Streaming raw frames to shared memory /" << name << endl;
+        return true;
+    }
+
+    AVFrame* RawOutput::frame() {
+        _buffer.backBuffer(_frame->data);
+        return _frame;
+    }
+
+    void RawOutput::publish(int64_t captureTimeUs) {
+        _buffer.publish(captureTimeUs);
+    }
+
+    uint64_t RawOutput::skipped() const {
+        return _buffer.skipped();
+    }
+} // namespace streamer
@@ -0,0 +1,115 @@
+#ifndef STREAMER_OUTPUT_HPP
+#define STREAMER_OUTPUT_HPP
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "network/shmring.hpp"
+#include "network/shmframebuffer.hpp"
+#include "network/socket.hpp"
+#include "network/udpbatch.hpp"
+#include "network/udppacer.hpp"
+
+namespace streamer {
+    // Sends encoded packets over RTP using libavformat's RTP muxer.
+    // By default, the muxer's packets are collected per frame and sent by net::UdpBatchSender,
+    // i.e. with UDP segmentation offload instead of one sendto() per packet. RTCP packets are sent
+    // to the next higher port like libavformat's rtp protocol does.
+    // With pacing, the packets of a frame are spread over a send window by net::UdpPacer. RTCP
+    // packets bypass the pacer.
+    class RtpOutput {
+        public:
+            RtpOutput();
+            RtpOutput(const RtpOutput&) = delete;
+            RtpOutput& operator=(const RtpOutput&) = delete;
+            ~RtpOutput();
+
+            // Spread the packets of each frame over the given time. Requires batch sending, 0
+            // disables pacing. Call before open().
+            void setPacing(int64_t windowUs);
+
+            // Open the given rtp:// URL for the stream produced by the given codec and write the
+            // corresponding SDP to sdpPath.
+            // If batch is false, packets are sent by libavformat's rtp protocol. Otherwise, only
+            // the URL options buffer_size and pkt_size are supported.
+            bool open(const char* url, const AVCodecContext* codec, const char* sdpPath, bool batch = true);
+
+            // Send the given packet. Timestamps are expected in the codec's time base.
+            bool write(AVPacket* packet);
+
+            // Print the queueing delay of paced packets since the last call, if pacing is used
+            void printPacingDelay();
+
+            // Print the number of sent datagrams and system calls, if batching is used. Sends the
+            // packets still queued for pacing first, i.e. call after the last write().
+            void printStats();
+
+        private:
+            bool _writeSDP(const char* path);
+            bool _openBatch(const char* url);
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+            static int _writePacket(void* opaque, const uint8_t* data, int size);
+#else
+            static int _writePacket(void* opaque, uint8_t* data, int size);
+#endif
+
+        private:
+            AVFormatContext* _format;
+            AVIOContext* _io;
+            net::Socket _rtpSocket;
+            net::Socket _rtcpSocket;
+            net::UdpBatchSender _sender;
+            net::UdpPacer _pacer;
+            AVRational _codecTimeBase;
+            int64_t _pacingWindowUs;
+            uint64_t _rtcpPackets;
+    };
+
+    // Passes encoded packets to a co-located frontend through a shared memory ring, bypassing
+    // RTP packetization and the network stack. See net::ShmRing.
+    // The codec parameters are published as net::ShmStreamInfo.
+    class ShmOutput {
+        public:
+            // Create the shared memory segment with the given name, e.g. "cloudgaming-video".
+            bool open(const char* name, const AVCodecContext* codec);
+
+            // Send the given packet along with the capture time of its frame. Returns false if
+            // the frontend does not keep up and the packet was dropped.
+            bool write(const AVPacket* packet, int64_t captureTimeUs);
+
+            uint64_t dropped() const;
+
+        private:
+            net::ShmRing _ring;
+    };
+
+    // Passes uncompressed yuv420p frames to a co-located frontend through a shared memory triple
+    // buffer, bypassing the encoder entirely. See net::ShmFrameBuffer.
+    class RawOutput {
+        public:
+            RawOutput();
+            RawOutput(const RawOutput&) = delete;
+            RawOutput& operator=(const RawOutput&) = delete;
+            ~RawOutput();
+
+            // Create the shared memory segment with the given name, e.g. "cloudgaming-video".
+            bool open(const char* name, int width, int height);
+
+            // Returns a frame referencing the current back buffer, i.e. color conversion writes
+            // directly into shared memory.
+            AVFrame* frame();
+
+            // Publish the frame returned by frame() along with its capture time.
+            void publish(int64_t captureTimeUs);
+
+            // Number of frames the frontend did not pick up before the next one was published
+            uint64_t skipped() const;
+
+        private:
+            net::ShmFrameBuffer _buffer;
+            AVFrame* _frame;
+    };
+}
+
+#endif
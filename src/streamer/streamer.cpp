@@ -0,0 +1,329 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef __linux__
+#   include <netinet/in.h>
+#endif
+
+#include "capture.hpp"
+#include "xvfbcapture.hpp"
+#include "windowcapture.hpp"
+#include "colorconv.hpp"
+#include "encoder.hpp"
+#include "output.hpp"
+#include "network/socket.hpp"
+#include "network/feedback.hpp"
+#include "util/clock.hpp"
+#include "util/config.hpp"
+#include "util/histogram.hpp"
+#include "util/worker_pool.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static std::atomic<bool> running = true;
+
+// Interval in which frame size statistics are printed
+constexpr int stats_interval_s = 10;
+
+// Interval in which the feedback thread checks whether it should stop
+constexpr int feedback_timeout_ms = 200;
+
+// Time to wait for the window to appear with capture=window
+constexpr int window_timeout_ms = 10000;
+
+
+void help() {
+    cout << "Usage: streamer <display> <width> <height> <fps> <bitrate> <rtp URL> <sdp file> [flags...]\n";
+    cout << "       streamer --config=<file> [flags...]\n";
+    cout << "Bitrate is given in bit/s with an optional K or M suffix, e.g. 25M.\n";
+    cout << "Captures the given X display, encodes it with H.264 and streams it over RTP.\n";
+    cout << "If the URL is shm:<name>, packets are passed through shared memory to a frontend on the same host instead. The SDP file is not written in this case.\n";
+    cout << "If the URL is shmraw:<name>, encoding is skipped and uncompressed yuv420p frames are passed through shared memory.\n";
+    cout << "All options can also be set in the config file, either globally or in its [streamer] section. The positional arguments correspond to the options display, width, height, fps, bitrate, url and sdp.\n";
+    cout << "Flags are given as key=value, --key=value, key (true) or no-key (false). They override the config file.\n";
+    cout << "Flags:\n";
+    cout << "\tconfig=<file>: Read options from the given config file\n";
+    cout << "\tcapture=<backend>: xshm to capture through XShm, xvfb to read the framebuffer of Xvfb started with -fbdir, or window to capture a single window through XComposite. Default: xshm\n";
+    cout << "\tfbdir=<dir>: Framebuffer directory of Xvfb for capture=xvfb\n";
+    cout << "\twindow=<title>: Title of the window to capture for capture=window. The stream has the size of the window, up to the given width and height.\n";
+    cout << "\tintra-refresh: Use periodic intra refresh instead of periodic IDR frames\n";
+    cout << "\tthreads=<n>: Number of threads for color conversion and encoding. Each encoder thread encodes a separate slice. Default: number of cores\n";
+    cout << "\tpin=<core>: Pin worker threads to the cores starting at the given core\n";
+    cout << "\tcolor=<kernel>: Color conversion kernel: auto, avx512, avx2, ssse3, scalar or swscale. Default: auto\n";
+    cout << "\tfeedback=<port>: Listen for loss reports from the frontend on the given UDP port and refresh the picture\n";
+    cout << "\tno-gso: Let libavformat send each RTP packet separately instead of sending the packets of a frame in batches using UDP segmentation offload\n";
+    cout << "\tpacing=<fraction>: Spread the packets of each frame over the given fraction of the frame interval to avoid bursts, e.g. of keyframes. 0 sends frames at once. Requires batch sending, i.e. not no-gso. Default: 0.5\n";
+}
+
+// Parse a bitrate with an optional K or M suffix, e.g. 25M
+int64_t parseBitrate(const char* str) {
+    char* suffix = nullptr;
+    double value = std::strtod(str, &suffix);
+
+    if (*suffix == 'k' || *suffix == 'K')
+        value *= 1000;
+    else if (*suffix == 'm' || *suffix == 'M')
+        value *= 1000000;
+
+    return static_cast<int64_t>(value);
+}
+
+void stop([[maybe_unused]] int signal) {
+    running = false;
+}
+
+void receiveFeedback(const net::Socket* socket, streamer::Encoder* encoder) {
+    net::LossReport report;
+    size_t numReports = 0;
+
+    while (running) {
+        int nrecv = socket->recv(reinterpret_cast<char*>(&report), sizeof(report));
+
+        if (nrecv != sizeof(report) || ntohl(report.magic) != net::loss_report_magic)
+            continue;
+
+        if (numReports++ == 0)
+            cout << "Received first loss report\n";
+
+        encoder->requestRefresh();
+    }
+
+    cout << "Received " << numReports << " loss reports\n";
+}
+
+
+int main(int argc, char *argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    util::Config config("streamer");
+    if (!config.parseArgs(argc, argv, { "display", "width", "height", "fps", "bitrate", "url", "sdp" }))
+        return 1;
+
+    if (config.has("help")) {
+        help();
+        return 0;
+    }
+
+    if (const char* key = config.missing({ "display", "width", "height", "fps", "bitrate", "url" })) {
+        help();
+        cerr << "Missing option: " << key << endl;
+        return 1;
+    }
+
+    const std::string display = config.getString("display");
+    streamer::EncoderOptions options {
+        .width = static_cast<int>(config.getInt("width", 0)),
+        .height = static_cast<int>(config.getInt("height", 0)),
+        .fps = static_cast<int>(config.getInt("fps", 0)),
+        .bitrate = parseBitrate(config.getString("bitrate").c_str()),
+        .intraRefresh = config.getBool("intra-refresh", false),
+        .threads = static_cast<int>(config.getInt("threads", 0)),
+    };
+    const std::string urlString = config.getString("url");
+    const std::string sdpPath = config.getString("sdp", "video.sdp");
+    const std::string feedbackPort = config.getString("feedback");
+    const int firstCore = config.getInt("pin", -1);
+    const std::string colorKernelName = config.getString("color", "auto");
+    const std::string captureBackend = config.getString("capture", "xshm");
+    const std::string fbdir = config.getString("fbdir");
+    const std::string windowTitle = config.getString("window");
+    const bool useGSO = config.getBool("gso", true);
+    const double pacing = config.getFloat("pacing", 0.5);
+    streamer::ColorKernel colorKernel = streamer::ColorKernel::Auto;
+    const char* url = urlString.c_str();
+
+    if (!streamer::parseColorKernel(colorKernelName.c_str(), &colorKernel)) {
+        cerr << "Unknown color conversion kernel: " << colorKernelName << endl;
+        return 1;
+    }
+
+    if (pacing < 0 || pacing > 1) {
+        cerr << "Pacing must be between 0 and 1\n";
+        return 1;
+    }
+
+    if (captureBackend != "xshm" && captureBackend != "xvfb" && captureBackend != "window") {
+        cerr << "Unknown capture backend: " << captureBackend << endl;
+        return 1;
+    }
+
+    if (captureBackend == "xvfb" && fbdir.empty()) {
+        cerr << "capture=xvfb requires fbdir\n";
+        return 1;
+    }
+
+    if (captureBackend == "window" && windowTitle.empty()) {
+        cerr << "capture=window requires window\n";
+        return 1;
+    }
+
+    if (options.width <= 0 || options.height <= 0 || options.fps <= 0 || options.bitrate <= 0) {
+        cerr << "Invalid stream parameters\n";
+        return 1;
+    }
+
+    if (!config.check())
+        return 1;
+    config.print(cout);
+
+    const bool useShm = strncmp(url, "shm:", 4) == 0;
+    const bool useRaw = strncmp(url, "shmraw:", 7) == 0;
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    streamer::X11Capture x11Capture;
+    streamer::XvfbCapture xvfbCapture;
+    streamer::X11WindowCapture windowCapture;
+    streamer::ICapture* capture = &x11Capture;
+
+    if (captureBackend == "xvfb") {
+        if (!xvfbCapture.open(fbdir.c_str(), display.c_str(), options.width, options.height))
+            return 1;
+        capture = &xvfbCapture;
+    } else if (captureBackend == "window") {
+        if (!windowCapture.open(display.c_str(), windowTitle.c_str(), options.width, options.height, window_timeout_ms))
+            return 1;
+        capture = &windowCapture;
+    } else if (!x11Capture.open(display.c_str(), options.width, options.height))
+        return 1;
+
+    // Window capture determines the stream size
+    options.width = capture->width();
+    options.height = capture->height();
+    cout << "Capturing " << options.width << "x" << options.height << endl;
+
+    if (options.threads <= 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Encoder threads inherit the affinity of the thread that creates them
+    if (firstCore >= 0)
+        util::pinThreadToCores(firstCore, options.threads);
+
+    streamer::Encoder encoder;
+    if (!useRaw && !encoder.open(options))
+        return 1;
+
+    // The main thread is the last worker
+    util::WorkerPool workers;
+    workers.start(options.threads, firstCore);
+    if (firstCore >= 0)
+        util::pinThreadToCore(firstCore + options.threads - 1);
+
+    streamer::ColorConverter converter;
+    if (!converter.init(options.width, options.height, &workers, colorKernel))
+        return 1;
+
+    cout << "Using " << options.threads << " threads" << (firstCore >= 0 ? ", pinned" : "")
+        << ", color conversion: " << streamer::colorKernelName(converter.kernel()) << endl;
+
+    streamer::RtpOutput rtpOutput;
+    streamer::ShmOutput shmOutput;
+    streamer::RawOutput rawOutput;
+    rtpOutput.setPacing(static_cast<int64_t>(pacing * 1'000'000 / options.fps));
+
+    if (useRaw) {
+        if (!rawOutput.open(url + 7, options.width, options.height))
+            return 1;
+    } else if (useShm) {
+        if (!shmOutput.open(url + 4, encoder.context()))
+            return 1;
+    } else if (!rtpOutput.open(url, encoder.context(), sdpPath.c_str(), useGSO))
+        return 1;
+
+    net::Socket feedbackSocket;
+    std::thread feedbackThread;
+
+    // Raw frames cannot be corrupted
+    if (!feedbackPort.empty() && !useRaw) {
+        if (!feedbackSocket.listen(net::UDP, "0.0.0.0", feedbackPort.c_str())) {
+            cerr << "Failed to listen for feedback on port " << feedbackPort << endl;
+            return 1;
+        }
+
+        feedbackSocket.setReceiveTimeout(feedback_timeout_ms);
+        feedbackThread = std::thread(receiveFeedback, &feedbackSocket, &encoder);
+        cout << "Listening for loss reports on port " << feedbackPort << endl;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    util::Histogram frameSizes;
+    uint64_t unchangedFrames = 0;
+    const auto frameInterval = std::chrono::nanoseconds(1'000'000'000 / options.fps);
+    const auto start = clock::now();
+    auto nextStats = start + std::chrono::seconds(stats_interval_s);
+
+    for (int64_t pts = 0; running; ++pts) {
+        std::this_thread::sleep_until(start + pts * frameInterval);
+
+        const int64_t captureTimeUs = util::monotonicTimeUs();
+        if (!capture->grab()) {
+            cerr << "Failed to capture screen\n";
+            break;
+        }
+
+        // The frontend keeps showing the last frame
+        if (useRaw) {
+            if (capture->changed()) {
+                converter.convert(capture->data(), capture->stride(), rawOutput.frame());
+                rawOutput.publish(captureTimeUs);
+            }
+            continue;
+        }
+
+        // The encoder frame still contains the previous picture, which encodes to skip blocks
+        AVFrame* frame = encoder.frame();
+        if (capture->changed())
+            converter.convert(capture->data(), capture->stride(), frame);
+        else
+            ++unchangedFrames;
+
+        if (!encoder.send(pts)) {
+            cerr << "Failed to encode frame\n";
+            break;
+        }
+
+        size_t frameSize = 0;
+        while (encoder.receive(packet)) {
+            frameSize += packet->size;
+            const bool sent = useShm ? shmOutput.write(packet, captureTimeUs) : rtpOutput.write(packet);
+            if (!sent)
+                cerr << "Failed to send packet\n";
+            av_packet_unref(packet);
+        }
+        frameSizes.add(frameSize);
+
+        if (clock::now() >= nextStats) {
+            if (capture == &xvfbCapture)
+                cout << "Unchanged frames: " << unchangedFrames << endl;
+            frameSizes.print(cout, "Frame size", "B");
+            rtpOutput.printPacingDelay();
+            frameSizes.reset();
+            nextStats += std::chrono::seconds(stats_interval_s);
+        }
+    }
+
+    running = false;
+    if (feedbackThread.joinable()) {
+        feedbackThread.join();
+        cout << "Forced " << encoder.forcedKeyframes() << " IDR frames due to loss reports\n";
+    }
+
+    if (useShm)
+        cout << "Dropped " << shmOutput.dropped() << " packets due to a full shared memory ring\n";
+    if (useRaw)
+        cout << "Frontend skipped " << rawOutput.skipped() << " frames\n";
+    if (!useShm && !useRaw)
+        rtpOutput.printStats();
+
+    av_packet_free(&packet);
+    return 0;
+}
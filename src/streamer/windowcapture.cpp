@@ -0,0 +1,239 @@
+#include "windowcapture.hpp"
+#include <X11/extensions/Xcomposite.h>
+#include <algorithm>
+#include <iostream>
+#include "util/x11.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace streamer {
+    X11WindowCapture::X11WindowCapture() :
+        _display(nullptr), _window(None), _pixmap(None), _canvas(None), _gc(nullptr),
+        _depth(0), _width(0), _height(0), _windowWidth(0), _windowHeight(0),
+        _renamePixmap(false), _changed(true), _first(true)
+    {}
+
+    X11WindowCapture::~X11WindowCapture() {
+        close();
+    }
+
+    bool X11WindowCapture::open(const char* display, const char* title, int maxWidth, int maxHeight, int timeoutMs) {
+        close();
+        _display = XOpenDisplay(display);
+
+        if (!_display) {
+            cerr << "Failed to open display " << (display ? display : "") << endl;
+            return false;
+        }
+
+        // XCompositeNameWindowPixmap() requires version 0.2
+        int eventBase, errorBase, major = 0, minor = 2;
+        if (!XCompositeQueryExtension(_display, &eventBase, &errorBase)
+                || !XCompositeQueryVersion(_display, &major, &minor) || (major == 0 && minor < 2)) {
+            cerr << "XComposite extension 0.2 not available\n";
+            close();
+            return false;
+        }
+
+        // The window can be destroyed at any time, which makes pending requests fail asynchronously
+        util::installXErrorHandler();
+
+        Window window = None;
+        if (!_tracker.start(display) || (window = _tracker.waitFor(title, timeoutMs)) == None) {
+            cerr << "Window '" << title << "' not found\n";
+            close();
+            return false;
+        }
+
+        XWindowAttributes attr;
+        if (!XGetWindowAttributes(_display, window, &attr)) {
+            close();
+            return false;
+        }
+
+        // The encoder requires even dimensions
+        _width = std::min(attr.width, maxWidth) & ~1;
+        _height = std::min(attr.height, maxHeight) & ~1;
+        _depth = attr.depth;
+        _title = title;
+        _first = true;
+
+        if (_width <= 0 || _height <= 0 || !_image.create(_display, attr.visual, _depth, _width, _height)) {
+            close();
+            return false;
+        }
+
+        // Composes the window onto a black background if it is smaller than the capture size
+        _canvas = XCreatePixmap(_display, window, _width, _height, _depth);
+        _gc = XCreateGC(_display, _canvas, 0, nullptr);
+        XSetForeground(_display, _gc, 0);
+
+        if (!_attach(window)) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void X11WindowCapture::close() {
+        _tracker.join();
+
+        if (!_display)
+            return;
+
+        if (_window != None)
+            XCompositeUnredirectWindow(_display, _window, CompositeRedirectAutomatic);
+
+        _detach();
+        _image.destroy();
+
+        if (_gc) {
+            XFreeGC(_display, _gc);
+            _gc = nullptr;
+        }
+
+        if (_canvas != None) {
+            XFreePixmap(_display, _canvas);
+            _canvas = None;
+        }
+
+        XCloseDisplay(_display);
+        _display = nullptr;
+    }
+
+    bool X11WindowCapture::_attach(Window window) {
+        XWindowAttributes attr;
+
+        if (!XGetWindowAttributes(_display, window, &attr))
+            return false;
+
+        if (attr.depth != _depth) {
+            cerr << "Window depth changed from " << _depth << " to " << attr.depth << endl;
+            return false;
+        }
+
+        _window = window;
+        _windowWidth = attr.width;
+        _windowHeight = attr.height;
+        _renamePixmap = true;
+
+        XSelectInput(_display, _window, StructureNotifyMask);
+
+        // Automatic redirection keeps the window visible on screen, e.g. for XShm capture or VNC
+        XCompositeRedirectWindow(_display, _window, CompositeRedirectAutomatic);
+        XSync(_display, False);
+        return true;
+    }
+
+    void X11WindowCapture::_detach() {
+        if (_pixmap != None) {
+            XFreePixmap(_display, _pixmap);
+            _pixmap = None;
+        }
+
+        _window = None;
+    }
+
+    bool X11WindowCapture::_namePixmap() {
+        XWindowAttributes attr;
+
+        // Only viewable windows have a backing pixmap
+        if (!XGetWindowAttributes(_display, _window, &attr) || attr.map_state != IsViewable)
+            return false;
+
+        // Each resize allocates a new pixmap, the old one stays valid until freed
+        if (_pixmap != None)
+            XFreePixmap(_display, _pixmap);
+
+        _pixmap = XCompositeNameWindowPixmap(_display, _window);
+        _windowWidth = attr.width;
+        _windowHeight = attr.height;
+        return true;
+    }
+
+    void X11WindowCapture::_processEvents() {
+        while (XPending(_display)) {
+            XEvent event;
+            XNextEvent(_display, &event);
+
+            if (_window == None || event.xany.window != _window)
+                continue;
+
+            switch (event.type) {
+                case ConfigureNotify:
+                    if (event.xconfigure.width != _windowWidth || event.xconfigure.height != _windowHeight)
+                        _renamePixmap = true;
+                    break;
+
+                case MapNotify:
+                    _renamePixmap = true;
+                    break;
+
+                case DestroyNotify:
+                    cout << "Window destroyed, waiting for a new window named '" << _title << "'\n";
+                    _detach();
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    bool X11WindowCapture::grab() {
+        const bool first = _first;
+        _first = false;
+
+        _processEvents();
+
+        // The tracker may still return the destroyed window for a moment, _attach() rejects it then
+        if (_window == None) {
+            Window window = _tracker.find(_title);
+
+            if (window != None && _attach(window))
+                cout << "Attached to new window '" << _title << "'\n";
+        }
+
+        if (_window != None && _renamePixmap && _namePixmap())
+            _renamePixmap = false;
+
+        // Keep the last frame while there is nothing to capture
+        if (_window == None || _pixmap == None) {
+            _changed = first;
+            return true;
+        }
+
+        _changed = true;
+
+        if (_windowWidth >= _width && _windowHeight >= _height)
+            return _image.get(_pixmap);
+
+        XFillRectangle(_display, _canvas, _gc, 0, 0, _width, _height);
+        XCopyArea(_display, _pixmap, _canvas, _gc, 0, 0,
+                std::min(_windowWidth, _width), std::min(_windowHeight, _height), 0, 0);
+        return _image.get(_canvas);
+    }
+
+    bool X11WindowCapture::changed() const {
+        return _changed;
+    }
+
+    const uint8_t* X11WindowCapture::data() const {
+        return reinterpret_cast<const uint8_t*>(_image.image()->data);
+    }
+
+    int X11WindowCapture::stride() const {
+        return _image.image()->bytes_per_line;
+    }
+
+    int X11WindowCapture::width() const {
+        return _width;
+    }
+
+    int X11WindowCapture::height() const {
+        return _height;
+    }
+} // namespace streamer
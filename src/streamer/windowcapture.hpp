@@ -0,0 +1,62 @@
+#ifndef STREAMER_WINDOWCAPTURE_HPP
+#define STREAMER_WINDOWCAPTURE_HPP
+
+#include <string>
+#include <X11/Xlib.h>
+#include "capture.hpp"
+#include "util/x11.hpp"
+
+namespace streamer {
+    // Captures a single window instead of the whole screen. The window is redirected to offscreen
+    // storage with XComposite, so its content is captured even if other windows overlap it.
+    // The capture size is fixed by open(). If the window is resized afterwards, its top left part
+    // is captured and uncovered areas are black. If the window is destroyed, the last frame is
+    // kept until a window with the same title appears again, which util::WindowTracker reports
+    // without polling.
+    class X11WindowCapture final : public ICapture {
+        public:
+            X11WindowCapture();
+            X11WindowCapture(const X11WindowCapture&) = delete;
+            X11WindowCapture& operator=(const X11WindowCapture&) = delete;
+            ~X11WindowCapture() final;
+
+            // Wait up to timeoutMs for a window with the given title. The capture size is the
+            // window size, limited to maxWidth x maxHeight and rounded down to even numbers.
+            bool open(const char* display, const char* title, int maxWidth, int maxHeight, int timeoutMs);
+            void close();
+
+            bool grab() final;
+            bool changed() const final;
+
+            const uint8_t* data() const final;
+            int stride() const final;
+            int width() const final;
+            int height() const final;
+
+        private:
+            bool _attach(Window window);
+            void _detach();
+            void _processEvents();
+            bool _namePixmap();
+
+        private:
+            util::WindowTracker _tracker;
+            Display* _display;
+            Window _window;
+            Pixmap _pixmap;
+            Pixmap _canvas;
+            GC _gc;
+            ShmImage _image;
+            std::string _title;
+            int _depth;
+            int _width;
+            int _height;
+            int _windowWidth;
+            int _windowHeight;
+            bool _renamePixmap;
+            bool _changed;
+            bool _first;
+    };
+}
+
+#endif
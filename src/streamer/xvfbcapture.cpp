@@ -0,0 +1,174 @@
+#include "xvfbcapture.hpp"
+#include <X11/XWDFile.h>
+#include <iostream>
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::endl;
+
+namespace streamer {
+    // Xvfb names the framebuffer file of screen n Xvfb_screen<n>
+    constexpr const char* framebuffer_file = "Xvfb_screen0";
+
+
+    XvfbCapture::XvfbCapture() :
+        _map(nullptr), _mapSize(0), _pixels(nullptr), _stride(0), _width(0), _height(0),
+        _display(nullptr), _damage(0), _damageEventBase(0), _changed(true), _first(true)
+    {}
+
+    XvfbCapture::~XvfbCapture() {
+        close();
+    }
+
+    bool XvfbCapture::open(const char* fbdir, const char* display, int width, int height) {
+        close();
+
+        const std::string path = std::string(fbdir) + "/" + framebuffer_file;
+        int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd == -1) {
+            cerr << "Failed to open Xvfb framebuffer " << path << ": " << std::strerror(errno) << endl;
+            return false;
+        }
+
+        struct stat st;
+        void* map = MAP_FAILED;
+
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sz_XWDheader)
+            map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (map == MAP_FAILED) {
+            cerr << "Failed to map Xvfb framebuffer " << path << endl;
+            return false;
+        }
+
+        _map = static_cast<uint8_t*>(map);
+        _mapSize = st.st_size;
+
+        // The header is stored in network byte order, the pixels in the byte order given by the header
+        XWDFileHeader header;
+        memcpy(&header, _map, sizeof(header));
+        for (CARD32* field = &header.header_size; field <= &header.window_bdrwidth; ++field)
+            *field = ntohl(*field);
+
+        const size_t offset = header.header_size + header.ncolors * sz_XWDColor;
+
+        if (header.file_version != XWD_FILE_VERSION || header.pixmap_format != ZPixmap
+                || header.bits_per_pixel != 32 || header.byte_order != LSBFirst
+                || header.red_mask != 0xff0000 || header.green_mask != 0xff00 || header.blue_mask != 0xff) {
+            cerr << "Unsupported Xvfb framebuffer format, expected 32 bit BGRX. Start Xvfb with depth 24.\n";
+            close();
+            return false;
+        }
+
+        if (static_cast<int>(header.pixmap_width) < width || static_cast<int>(header.pixmap_height) < height
+                || offset + static_cast<size_t>(header.bytes_per_line) * height > _mapSize) {
+            cerr << "Xvfb screen is smaller than " << width << "x" << height << endl;
+            close();
+            return false;
+        }
+
+        _pixels = _map + offset;
+        _stride = header.bytes_per_line;
+        _width = width;
+        _height = height;
+        _first = true;
+
+        if (display && !_openDamage(display)) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool XvfbCapture::_openDamage(const char* display) {
+        _display = XOpenDisplay(display);
+
+        if (!_display) {
+            cerr << "Failed to open display " << display << endl;
+            return false;
+        }
+
+        int errorBase;
+        if (!XDamageQueryExtension(_display, &_damageEventBase, &errorBase)) {
+            cerr << "XDamage extension not available\n";
+            return false;
+        }
+
+        // Report once whenever the damaged region becomes non-empty, i.e. after each subtract
+        _damage = XDamageCreate(_display, DefaultRootWindow(_display), XDamageReportNonEmpty);
+        XSync(_display, False);
+        return true;
+    }
+
+    void XvfbCapture::close() {
+        if (_display) {
+            if (_damage)
+                XDamageDestroy(_display, _damage);
+            XCloseDisplay(_display);
+            _display = nullptr;
+            _damage = 0;
+        }
+
+        if (_map) {
+            munmap(_map, _mapSize);
+            _map = nullptr;
+            _mapSize = 0;
+            _pixels = nullptr;
+        }
+    }
+
+    bool XvfbCapture::grab() {
+        if (!_display)
+            return true;
+
+        _changed = _first;
+        _first = false;
+
+        while (XPending(_display)) {
+            XEvent event;
+            XNextEvent(_display, &event);
+
+            if (event.type == _damageEventBase + XDamageNotify)
+                _changed = true;
+        }
+
+        // Reset the damage before the caller reads the pixels, so drawing that happens while
+        // reading is reported by the next grab(). This needs a round trip, but only on change.
+        if (_changed) {
+            XDamageSubtract(_display, _damage, None, None);
+            XSync(_display, False);
+        }
+
+        return true;
+    }
+
+    bool XvfbCapture::changed() const {
+        return _changed;
+    }
+
+    const uint8_t* XvfbCapture::data() const {
+        return _pixels;
+    }
+
+    int XvfbCapture::stride() const {
+        return _stride;
+    }
+
+    int XvfbCapture::width() const {
+        return _width;
+    }
+
+    int XvfbCapture::height() const {
+        return _height;
+    }
+} // namespace streamer
@@ -0,0 +1,55 @@
+#ifndef STREAMER_XVFBCAPTURE_HPP
+#define STREAMER_XVFBCAPTURE_HPP
+
+#include <cstddef>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdamage.h>
+#include "capture.hpp"
+
+namespace streamer {
+    // Reads the screen directly from the framebuffer file of Xvfb, started with -fbdir <dir>.
+    // The file is an XWD image that Xvfb renders into, so mapping it gives access to the pixels
+    // without X requests or copies. Frames are read in place, i.e. they may contain partial
+    // updates, like the front buffer of a real display.
+    // If a display is given, the XDamage extension tracks whether the screen changed between
+    // frames, see changed().
+    class XvfbCapture final : public ICapture {
+        public:
+            XvfbCapture();
+            XvfbCapture(const XvfbCapture&) = delete;
+            XvfbCapture& operator=(const XvfbCapture&) = delete;
+            ~XvfbCapture() final;
+
+            // Map the framebuffer of screen 0 in the given -fbdir directory and capture the
+            // top left width x height pixels. display may be nullptr to disable damage tracking.
+            bool open(const char* fbdir, const char* display, int width, int height);
+            void close();
+
+            // Does not read any pixels, only collects damage events.
+            bool grab() final;
+            bool changed() const final;
+
+            const uint8_t* data() const final;
+            int stride() const final;
+            int width() const final;
+            int height() const final;
+
+        private:
+            bool _openDamage(const char* display);
+
+        private:
+            uint8_t* _map;
+            size_t _mapSize;
+            const uint8_t* _pixels;
+            int _stride;
+            int _width;
+            int _height;
+            Display* _display;
+            Damage _damage;
+            int _damageEventBase;
+            bool _changed;
+            bool _first;
+    };
+}
+
+#endif
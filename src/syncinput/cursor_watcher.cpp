@@ -0,0 +1,178 @@
+#include "cursor_watcher.hpp"
+#include <X11/extensions/Xfixes.h>
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include "util/x11.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace input {
+    // Interval in which the thread checks whether it should stop while waiting for the frontend
+    constexpr int accept_timeout_ms = 200;
+
+    // XFixes delivers premultiplied alpha
+    static uint32_t unpremultiply(unsigned long pixel) {
+        const uint32_t a = (pixel >> 24) & 0xff;
+
+        if (a == 0)
+            return 0;
+
+        uint32_t out = a << 24;
+        for (int shift = 0; shift < 24; shift += 8) {
+            const uint32_t c = (pixel >> shift) & 0xff;
+            out |= std::min<uint32_t>(255, (c * 255 + a / 2) / a) << shift;
+        }
+        return out;
+    }
+
+
+    CursorWatcher::CursorWatcher() :
+        _display(nullptr), _running(false), _origin(None), _lastMotion(0), _pollIntervalUs(0), _eventBase(0)
+    {}
+
+    CursorWatcher::~CursorWatcher() {
+        join();
+    }
+
+    bool CursorWatcher::start(const char* host, const char* port, int pollIntervalUs) {
+        join();
+        _display = XOpenDisplay(nullptr);
+
+        if (!_display) {
+            cerr << "Failed to open display\n";
+            return false;
+        }
+
+        int errorBase;
+        if (!XFixesQueryExtension(_display, &_eventBase, &errorBase)) {
+            cerr << "XFixes extension not available\n";
+            join();
+            return false;
+        }
+
+        // The origin window may be destroyed at any time
+        util::installXErrorHandler();
+
+        if (!_transmitter.listen(host, port)) {
+            join();
+            return false;
+        }
+
+        cout << "Forwarding cursor on " << host << ":" << port << endl;
+        _pollIntervalUs = pollIntervalUs;
+        _running = true;
+        _thread = std::thread(_process, this);
+        return true;
+    }
+
+    void CursorWatcher::join() {
+        _running = false;
+
+        if (_thread.joinable())
+            _thread.join();
+
+        if (_display) {
+            XCloseDisplay(_display);
+            _display = nullptr;
+        }
+
+        _sentShapes.clear();
+    }
+
+    void CursorWatcher::setOrigin(Window window) {
+        _origin = window;
+    }
+
+    void CursorWatcher::setLastMotion(int64_t timestampUs) {
+        _lastMotion = timestampUs;
+    }
+
+    void CursorWatcher::_process(CursorWatcher* self) {
+        Display* display = self->_display;
+        const Window root = DefaultRootWindow(display);
+
+        while (self->_running && !self->_transmitter.accept(accept_timeout_ms))
+            ;
+
+        if (!self->_running)
+            return;
+
+        cout << "Cursor channel connected\n";
+
+        // Showing and hiding is reference counted per client, closing the display shows it again
+        XFixesSelectCursorInput(display, root, XFixesDisplayCursorNotifyMask);
+        XFixesHideCursor(display, root);
+
+        int lastX = INT_MIN, lastY = INT_MIN;
+        int64_t lastMotion = -1;
+        bool ok = self->_sendShape(0);
+
+        while (self->_running && ok) {
+            while (XPending(display)) {
+                XEvent event;
+                XNextEvent(display, &event);
+
+                if (event.type == self->_eventBase + XFixesCursorNotify) {
+                    auto& notify = reinterpret_cast<const XFixesCursorNotifyEvent&>(event);
+                    ok = ok && self->_sendShape(notify.cursor_serial);
+                }
+            }
+
+            // Read before querying, so the position includes at least this motion
+            const int64_t motion = self->_lastMotion;
+            Window origin = self->_origin;
+            Window rootReturn, child;
+            int rootX, rootY, x, y;
+            unsigned int mask;
+
+            if (origin == None || !XQueryPointer(display, origin, &rootReturn, &child, &rootX, &rootY, &x, &y, &mask))
+                XQueryPointer(display, root, &rootReturn, &child, &x, &y, &rootX, &rootY, &mask);
+
+            if (x != lastX || y != lastY || motion != lastMotion) {
+                ok = ok && self->_transmitter.sendPosition(x, y, motion);
+                lastX = x;
+                lastY = y;
+                lastMotion = motion;
+            }
+
+            usleep(self->_pollIntervalUs);
+        }
+
+        XFixesShowCursor(display, root);
+        XFlush(display);
+        cout << "Cursor forwarding stopped\n";
+    }
+
+    bool CursorWatcher::_sendShape(unsigned long serial) {
+        // Only cached shapes can be selected without fetching the image
+        if (serial != 0 && _sentShapes.count(serial))
+            return _transmitter.sendShape(serial, 0, 0, 0, 0, {});
+
+        XFixesCursorImage* image = XFixesGetCursorImage(_display);
+
+        if (!image)
+            return true;
+
+        if (image->width > max_cursor_size || image->height > max_cursor_size) {
+            cerr << "Cursor too large: " << image->width << "x" << image->height << endl;
+            XFree(image);
+            return true;
+        }
+
+        std::vector<uint32_t> pixels(image->width * image->height);
+        for (size_t i = 0; i < pixels.size(); ++i)
+            pixels[i] = unpremultiply(image->pixels[i]);
+
+        // The cursor may have changed again since the event, the image has the current serial
+        const bool ok = _transmitter.sendShape(image->cursor_serial, image->xhot, image->yhot,
+                image->width, image->height, pixels);
+        _sentShapes.insert(image->cursor_serial);
+        XFree(image);
+        return ok;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef CURSOR_WATCHER_HPP
+#define CURSOR_WATCHER_HPP
+
+#include <X11/Xlib.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <unordered_set>
+#include "network/cursor.hpp"
+
+namespace input {
+    // Forwards the cursor of the X display to the frontend, see CursorTransmitter.
+    // While the frontend is connected, the cursor is hidden on the X server, so it never ends up
+    // in the video. XFixes still reports shape changes of the hidden cursor. The position is
+    // polled and only sent when it changed.
+    class CursorWatcher {
+        public:
+            CursorWatcher();
+            CursorWatcher(const CursorWatcher&) = delete;
+            CursorWatcher& operator=(const CursorWatcher&) = delete;
+            ~CursorWatcher();
+
+            // Listen on the given address, then wait for the frontend and forward the cursor in
+            // a background thread.
+            bool start(const char* host, const char* port, int pollIntervalUs);
+            void join();
+
+            // (Thread-safe) Report positions relative to the given window instead of the root
+            // window, e.g. when only this window is captured. None resets it.
+            void setOrigin(Window window);
+
+            // (Thread-safe) Set the timestamp of the last injected mouse motion event.
+            void setLastMotion(int64_t timestampUs);
+
+        private:
+            static void _process(CursorWatcher* self);
+
+            // Send the shape with the given serial, or the current one if it was not sent before
+            bool _sendShape(unsigned long serial);
+
+        private:
+            Display* _display;
+            CursorTransmitter _transmitter;
+            std::unordered_set<unsigned long> _sentShapes;
+            std::thread _thread;
+            std::atomic<bool> _running;
+            std::atomic<Window> _origin;
+            std::atomic<int64_t> _lastMotion;
+            int _pollIntervalUs;
+            int _eventBase;
+    };
+}
+
+#endif
@@ -4,6 +4,7 @@
 // Include platform specific headers
 #ifdef __linux__
 #include "xorg.hpp"
+#include "uinput.hpp"
 // Use XTest implementation by default because it will work 99% of the time.
 #elif _WIN32
 #error "Not yet supported"
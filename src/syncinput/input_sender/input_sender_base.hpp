@@ -2,6 +2,7 @@
 #define INPUT_BASE_HPP
 
 #include <SDL2/SDL_keycode.h>
+#include <SDL2/SDL_scancode.h>
 
 namespace input {
     class IInputSender
@@ -12,7 +13,7 @@ namespace input {
             // Attach to window with the given title
             virtual bool attach(const char* title) = 0;
 
-            // Send key event. Expects a platform specific keysym. see also convertSDLKeycode().
+            // Send key event. Expects a platform specific key code. see also convertSDLKey().
             virtual void sendKey(bool pressed, unsigned long key) const = 0;
 
             // Send a mouse button event
@@ -27,8 +28,10 @@ namespace input {
             // Flush the command queue. Required on some platforms.
             virtual void flush() const = 0;
 
-            // Convert an SDL keycode to a platform specific keysym.
-            virtual unsigned long convertSDLKeycode(SDL_Keycode keycode) const = 0;
+            // Convert an SDL key to a platform specific key code.
+            // The scancode is preferred, as it identifies the physical key independent of the
+            // keyboard layout. The keycode is used as fallback if the scancode is unknown.
+            virtual unsigned long convertSDLKey(SDL_Keycode keycode, SDL_Scancode scancode) const = 0;
     };
 }
 
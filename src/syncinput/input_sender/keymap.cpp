@@ -0,0 +1,238 @@
+#include "keymap.hpp"
+#include <X11/XKBlib.h>
+#include <linux/input-event-codes.h>
+#include <cstring>
+#include <iostream>
+
+namespace input {
+    // X keycodes of evdev based keymaps are offset by 8 from the Linux keycodes.
+    constexpr int evdev_keycode_offset = 8;
+
+    static const KeyMapping key_mappings[] = {
+        { SDL_SCANCODE_A, "AC01", KEY_A },
+        { SDL_SCANCODE_B, "AB05", KEY_B },
+        { SDL_SCANCODE_C, "AB03", KEY_C },
+        { SDL_SCANCODE_D, "AC03", KEY_D },
+        { SDL_SCANCODE_E, "AD03", KEY_E },
+        { SDL_SCANCODE_F, "AC04", KEY_F },
+        { SDL_SCANCODE_G, "AC05", KEY_G },
+        { SDL_SCANCODE_H, "AC06", KEY_H },
+        { SDL_SCANCODE_I, "AD08", KEY_I },
+        { SDL_SCANCODE_J, "AC07", KEY_J },
+        { SDL_SCANCODE_K, "AC08", KEY_K },
+        { SDL_SCANCODE_L, "AC09", KEY_L },
+        { SDL_SCANCODE_M, "AB07", KEY_M },
+        { SDL_SCANCODE_N, "AB06", KEY_N },
+        { SDL_SCANCODE_O, "AD09", KEY_O },
+        { SDL_SCANCODE_P, "AD10", KEY_P },
+        { SDL_SCANCODE_Q, "AD01", KEY_Q },
+        { SDL_SCANCODE_R, "AD04", KEY_R },
+        { SDL_SCANCODE_S, "AC02", KEY_S },
+        { SDL_SCANCODE_T, "AD05", KEY_T },
+        { SDL_SCANCODE_U, "AD07", KEY_U },
+        { SDL_SCANCODE_V, "AB04", KEY_V },
+        { SDL_SCANCODE_W, "AD02", KEY_W },
+        { SDL_SCANCODE_X, "AB02", KEY_X },
+        { SDL_SCANCODE_Y, "AD06", KEY_Y },
+        { SDL_SCANCODE_Z, "AB01", KEY_Z },
+
+        { SDL_SCANCODE_1, "AE01", KEY_1 },
+        { SDL_SCANCODE_2, "AE02", KEY_2 },
+        { SDL_SCANCODE_3, "AE03", KEY_3 },
+        { SDL_SCANCODE_4, "AE04", KEY_4 },
+        { SDL_SCANCODE_5, "AE05", KEY_5 },
+        { SDL_SCANCODE_6, "AE06", KEY_6 },
+        { SDL_SCANCODE_7, "AE07", KEY_7 },
+        { SDL_SCANCODE_8, "AE08", KEY_8 },
+        { SDL_SCANCODE_9, "AE09", KEY_9 },
+        { SDL_SCANCODE_0, "AE10", KEY_0 },
+
+        { SDL_SCANCODE_RETURN, "RTRN", KEY_ENTER },
+        { SDL_SCANCODE_ESCAPE, "ESC", KEY_ESC },
+        { SDL_SCANCODE_BACKSPACE, "BKSP", KEY_BACKSPACE },
+        { SDL_SCANCODE_TAB, "TAB", KEY_TAB },
+        { SDL_SCANCODE_SPACE, "SPCE", KEY_SPACE },
+        { SDL_SCANCODE_MINUS, "AE11", KEY_MINUS },
+        { SDL_SCANCODE_EQUALS, "AE12", KEY_EQUAL },
+        { SDL_SCANCODE_LEFTBRACKET, "AD11", KEY_LEFTBRACE },
+        { SDL_SCANCODE_RIGHTBRACKET, "AD12", KEY_RIGHTBRACE },
+        { SDL_SCANCODE_BACKSLASH, "BKSL", KEY_BACKSLASH },
+        { SDL_SCANCODE_NONUSHASH, "BKSL", KEY_BACKSLASH },
+        { SDL_SCANCODE_SEMICOLON, "AC10", KEY_SEMICOLON },
+        { SDL_SCANCODE_APOSTROPHE, "AC11", KEY_APOSTROPHE },
+        { SDL_SCANCODE_GRAVE, "TLDE", KEY_GRAVE },
+        { SDL_SCANCODE_COMMA, "AB08", KEY_COMMA },
+        { SDL_SCANCODE_PERIOD, "AB09", KEY_DOT },
+        { SDL_SCANCODE_SLASH, "AB10", KEY_SLASH },
+        { SDL_SCANCODE_CAPSLOCK, "CAPS", KEY_CAPSLOCK },
+        { SDL_SCANCODE_NONUSBACKSLASH, "LSGT", KEY_102ND },
+        { SDL_SCANCODE_APPLICATION, "COMP", KEY_COMPOSE },
+
+        { SDL_SCANCODE_F1, "FK01", KEY_F1 },
+        { SDL_SCANCODE_F2, "FK02", KEY_F2 },
+        { SDL_SCANCODE_F3, "FK03", KEY_F3 },
+        { SDL_SCANCODE_F4, "FK04", KEY_F4 },
+        { SDL_SCANCODE_F5, "FK05", KEY_F5 },
+        { SDL_SCANCODE_F6, "FK06", KEY_F6 },
+        { SDL_SCANCODE_F7, "FK07", KEY_F7 },
+        { SDL_SCANCODE_F8, "FK08", KEY_F8 },
+        { SDL_SCANCODE_F9, "FK09", KEY_F9 },
+        { SDL_SCANCODE_F10, "FK10", KEY_F10 },
+        { SDL_SCANCODE_F11, "FK11", KEY_F11 },
+        { SDL_SCANCODE_F12, "FK12", KEY_F12 },
+
+        { SDL_SCANCODE_PRINTSCREEN, "PRSC", KEY_SYSRQ },
+        { SDL_SCANCODE_SCROLLLOCK, "SCLK", KEY_SCROLLLOCK },
+        { SDL_SCANCODE_PAUSE, "PAUS", KEY_PAUSE },
+        { SDL_SCANCODE_INSERT, "INS", KEY_INSERT },
+        { SDL_SCANCODE_HOME, "HOME", KEY_HOME },
+        { SDL_SCANCODE_PAGEUP, "PGUP", KEY_PAGEUP },
+        { SDL_SCANCODE_DELETE, "DELE", KEY_DELETE },
+        { SDL_SCANCODE_END, "END", KEY_END },
+        { SDL_SCANCODE_PAGEDOWN, "PGDN", KEY_PAGEDOWN },
+        { SDL_SCANCODE_RIGHT, "RGHT", KEY_RIGHT },
+        { SDL_SCANCODE_LEFT, "LEFT", KEY_LEFT },
+        { SDL_SCANCODE_DOWN, "DOWN", KEY_DOWN },
+        { SDL_SCANCODE_UP, "UP", KEY_UP },
+
+        { SDL_SCANCODE_NUMLOCKCLEAR, "NMLK", KEY_NUMLOCK },
+        { SDL_SCANCODE_KP_DIVIDE, "KPDV", KEY_KPSLASH },
+        { SDL_SCANCODE_KP_MULTIPLY, "KPMU", KEY_KPASTERISK },
+        { SDL_SCANCODE_KP_MINUS, "KPSU", KEY_KPMINUS },
+        { SDL_SCANCODE_KP_PLUS, "KPAD", KEY_KPPLUS },
+        { SDL_SCANCODE_KP_ENTER, "KPEN", KEY_KPENTER },
+        { SDL_SCANCODE_KP_1, "KP1", KEY_KP1 },
+        { SDL_SCANCODE_KP_2, "KP2", KEY_KP2 },
+        { SDL_SCANCODE_KP_3, "KP3", KEY_KP3 },
+        { SDL_SCANCODE_KP_4, "KP4", KEY_KP4 },
+        { SDL_SCANCODE_KP_5, "KP5", KEY_KP5 },
+        { SDL_SCANCODE_KP_6, "KP6", KEY_KP6 },
+        { SDL_SCANCODE_KP_7, "KP7", KEY_KP7 },
+        { SDL_SCANCODE_KP_8, "KP8", KEY_KP8 },
+        { SDL_SCANCODE_KP_9, "KP9", KEY_KP9 },
+        { SDL_SCANCODE_KP_0, "KP0", KEY_KP0 },
+        { SDL_SCANCODE_KP_PERIOD, "KPDL", KEY_KPDOT },
+
+        { SDL_SCANCODE_LCTRL, "LCTL", KEY_LEFTCTRL },
+        { SDL_SCANCODE_LSHIFT, "LFSH", KEY_LEFTSHIFT },
+        { SDL_SCANCODE_LALT, "LALT", KEY_LEFTALT },
+        { SDL_SCANCODE_LGUI, "LWIN", KEY_LEFTMETA },
+        { SDL_SCANCODE_RCTRL, "RCTL", KEY_RIGHTCTRL },
+        { SDL_SCANCODE_RSHIFT, "RTSH", KEY_RIGHTSHIFT },
+        { SDL_SCANCODE_RALT, "RALT", KEY_RIGHTALT },
+        { SDL_SCANCODE_RGUI, "RWIN", KEY_RIGHTMETA },
+    };
+
+
+    const KeyMapping* findKeyMapping(SDL_Scancode scancode) {
+        // Indexed on first use
+        static const auto table = [] {
+            std::array<const KeyMapping*, SDL_NUM_SCANCODES> table {};
+            for (const auto& mapping : key_mappings)
+                table[mapping.scancode] = &mapping;
+            return table;
+        }();
+
+        if (scancode < 0 || scancode >= SDL_NUM_SCANCODES)
+            return nullptr;
+        return table[scancode];
+    }
+
+
+    XKeymap::XKeymap() : _scancodes{}, _xkbEventBase(-1) {}
+
+    void XKeymap::build(Display* display) {
+        int minKeycode, maxKeycode;
+        XDisplayKeycodes(display, &minKeycode, &maxKeycode);
+
+        // Scancodes: Resolve XKB key names to keycodes
+        _scancodes.fill(0);
+        XkbDescPtr desc = nullptr;
+        int opcode, errorBase, major = XkbMajorVersion, minor = XkbMinorVersion;
+
+        if (XkbQueryExtension(display, &opcode, &_xkbEventBase, &errorBase, &major, &minor)) {
+            XkbSelectEvents(display, XkbUseCoreKbd,
+                    XkbNewKeyboardNotifyMask | XkbMapNotifyMask,
+                    XkbNewKeyboardNotifyMask | XkbMapNotifyMask);
+
+            desc = XkbGetMap(display, 0, XkbUseCoreKbd);
+            if (desc && XkbGetNames(display, XkbKeyNamesMask, desc) != Success) {
+                XkbFreeKeyboard(desc, 0, True);
+                desc = nullptr;
+            }
+        } else {
+            _xkbEventBase = -1;
+        }
+
+        for (const auto& mapping : key_mappings) {
+            KeyCode keycode = 0;
+
+            if (desc) {
+                for (int kc = desc->min_key_code; kc <= desc->max_key_code; ++kc) {
+                    if (strncmp(desc->names->keys[kc].name, mapping.xkbName, XkbKeyNameLength) == 0) {
+                        keycode = kc;
+                        break;
+                    }
+                }
+            }
+
+            // Fallback to evdev keycodes
+            if (keycode == 0 && mapping.evdev + evdev_keycode_offset <= maxKeycode)
+                keycode = mapping.evdev + evdev_keycode_offset;
+
+            _scancodes[mapping.scancode] = keycode;
+        }
+
+        bool hasXkb = desc != nullptr;
+        if (desc)
+            XkbFreeKeyboard(desc, 0, True);
+
+        // Keysyms: Use the first keycode producing the respective keysym, preferring unshifted keysyms
+        _keysyms.clear();
+        int symsPerKeycode;
+        int count = maxKeycode - minKeycode + 1;
+        KeySym* syms = XGetKeyboardMapping(display, minKeycode, count, &symsPerKeycode);
+
+        if (syms) {
+            for (int col = 0; col < symsPerKeycode; ++col)
+                for (int i = 0; i < count; ++i)
+                    if (KeySym sym = syms[i * symsPerKeycode + col]; sym != NoSymbol)
+                        _keysyms.emplace(sym, minKeycode + i);
+            XFree(syms);
+        }
+
+        std::cout << "Keymap built: " << _keysyms.size() << " keysyms, XKB key names " << (hasXkb ? "available" : "unavailable") << std::endl;
+    }
+
+    void XKeymap::update(Display* display) {
+        bool changed = false;
+
+        while (XPending(display)) {
+            XEvent ev;
+            XNextEvent(display, &ev);
+
+            if (ev.type == MappingNotify) {
+                XRefreshKeyboardMapping(&ev.xmapping);
+                changed = true;
+            } else if (_xkbEventBase != -1 && ev.type == _xkbEventBase) {
+                changed = true;
+            }
+        }
+
+        if (changed) {
+            std::cout << "Keymap changed, rebuilding\n";
+            build(display);
+        }
+    }
+
+    KeyCode XKeymap::fromScancode(SDL_Scancode scancode) const {
+        if (scancode < 0 || scancode >= SDL_NUM_SCANCODES)
+            return 0;
+        return _scancodes[scancode];
+    }
+
+    KeyCode XKeymap::fromKeysym(KeySym keysym) const {
+        auto it = _keysyms.find(keysym);
+        return it == _keysyms.end() ? 0 : it->second;
+    }
+}
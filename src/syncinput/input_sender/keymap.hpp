@@ -0,0 +1,48 @@
+#ifndef KEYMAP_HPP
+#define KEYMAP_HPP
+
+#include <array>
+#include <unordered_map>
+#include <X11/Xlib.h>
+#include <SDL2/SDL_scancode.h>
+
+namespace input {
+    // Describes a physical key by its SDL scancode, XKB key name and Linux evdev code.
+    struct KeyMapping {
+        SDL_Scancode scancode;
+        const char* xkbName;
+        unsigned short evdev;
+    };
+
+    // Returns the mapping of the given scancode or nullptr if the scancode is not supported.
+    const KeyMapping* findKeyMapping(SDL_Scancode scancode);
+
+    // Precomputed SDL scancode -> X keycode and keysym -> X keycode tables of an X server's keymap.
+    // Scancodes are resolved by XKB key name, i.e. by physical key position, which makes them
+    // independent of the keyboard layout.
+    class XKeymap
+    {
+        public:
+            XKeymap();
+
+            // Build the tables from the server's current keymap and subscribe to keymap changes.
+            void build(Display* display);
+
+            // Process pending keymap change notifications and rebuild the tables if necessary.
+            // Does not cause a server round-trip if nothing changed.
+            void update(Display* display);
+
+            // Returns the X keycode of the given scancode or 0 if unknown.
+            KeyCode fromScancode(SDL_Scancode scancode) const;
+
+            // Returns the X keycode that produces the given keysym or 0 if unknown.
+            KeyCode fromKeysym(KeySym keysym) const;
+
+        private:
+            std::array<KeyCode, SDL_NUM_SCANCODES> _scancodes;
+            std::unordered_map<KeySym, KeyCode> _keysyms;
+            int _xkbEventBase;
+    };
+}
+
+#endif
@@ -0,0 +1,277 @@
+#include "uinput.hpp"
+#include "keymap.hpp"
+#include <linux/uinput.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <cstring>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+namespace input {
+    // Wheel units per detent for high-resolution wheel events
+    constexpr int wheel_hi_res_detent = 120;
+
+
+    UInputSender::UInputSender() : _fd(-1)
+    {
+        _fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+
+        if (_fd == -1)
+        {
+            cerr << "Failed to open /dev/uinput: " << std::strerror(errno) << endl;
+            return;
+        }
+
+        ioctl(_fd, UI_SET_EVBIT, EV_SYN);
+        ioctl(_fd, UI_SET_EVBIT, EV_KEY);
+        ioctl(_fd, UI_SET_EVBIT, EV_REL);
+
+        // Keyboard keys
+        for (int key = KEY_ESC; key <= KEY_MICMUTE; ++key)
+            ioctl(_fd, UI_SET_KEYBIT, key);
+
+        // Mouse buttons
+        for (int button = BTN_LEFT; button <= BTN_TASK; ++button)
+            ioctl(_fd, UI_SET_KEYBIT, button);
+
+        ioctl(_fd, UI_SET_RELBIT, REL_X);
+        ioctl(_fd, UI_SET_RELBIT, REL_Y);
+        ioctl(_fd, UI_SET_RELBIT, REL_WHEEL);
+        ioctl(_fd, UI_SET_RELBIT, REL_HWHEEL);
+#ifdef REL_WHEEL_HI_RES
+        ioctl(_fd, UI_SET_RELBIT, REL_WHEEL_HI_RES);
+        ioctl(_fd, UI_SET_RELBIT, REL_HWHEEL_HI_RES);
+#endif
+
+        uinput_setup setup;
+        memset(&setup, 0, sizeof(setup));
+        setup.id.bustype = BUS_VIRTUAL;
+        setup.id.vendor = 0x1209;  // pid.codes, generic open source vendor ID
+        setup.id.product = 0x0001;
+        strncpy(setup.name, "syncinput virtual input device", UINPUT_MAX_NAME_SIZE - 1);
+
+        if (ioctl(_fd, UI_DEV_SETUP, &setup) == -1 || ioctl(_fd, UI_DEV_CREATE) == -1)
+        {
+            cerr << "Failed to create uinput device: " << std::strerror(errno) << endl;
+            close(_fd);
+            _fd = -1;
+        }
+    }
+
+    UInputSender::~UInputSender()
+    {
+        if (_fd != -1)
+        {
+            ioctl(_fd, UI_DEV_DESTROY);
+            close(_fd);
+        }
+    }
+
+    void UInputSender::_queue(unsigned short type, unsigned short code, int value) const
+    {
+        input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+        _events.push_back(ev);
+    }
+
+    void UInputSender::sendKey(bool pressed, unsigned long key) const
+    {
+        if (key == KEY_RESERVED)
+            return;
+        _queue(EV_KEY, key, pressed);
+    }
+
+    void UInputSender::sendMouse(bool pressed, unsigned int button) const
+    {
+        // Button numbering follows SDL, i.e. 4 and 5 are X1 and X2, not the wheel as in X11
+        switch (button)
+        {
+            case 1:
+                _queue(EV_KEY, BTN_LEFT, pressed);
+                break;
+
+            case 2:
+                _queue(EV_KEY, BTN_MIDDLE, pressed);
+                break;
+
+            case 3:
+                _queue(EV_KEY, BTN_RIGHT, pressed);
+                break;
+
+            case 4:
+                _queue(EV_KEY, BTN_SIDE, pressed);
+                break;
+
+            case 5:
+                _queue(EV_KEY, BTN_EXTRA, pressed);
+                break;
+
+            default:
+                cerr << "Unknown mouse button: " << button << endl;
+                break;
+        }
+    }
+
+    void UInputSender::sendMouseMove(int x, int y, bool relative) const
+    {
+        if (!relative)
+        {
+            cerr << "Absolute mouse motion is not supported by the uinput backend\n";
+            return;
+        }
+
+        if (x != 0)
+            _queue(EV_REL, REL_X, x);
+        if (y != 0)
+            _queue(EV_REL, REL_Y, y);
+    }
+
+    void UInputSender::sendMouseWheel(int x, int y) const
+    {
+        if (y != 0)
+        {
+            _queue(EV_REL, REL_WHEEL, y);
+#ifdef REL_WHEEL_HI_RES
+            _queue(EV_REL, REL_WHEEL_HI_RES, y * wheel_hi_res_detent);
+#endif
+        }
+
+        if (x != 0)
+        {
+            _queue(EV_REL, REL_HWHEEL, x);
+#ifdef REL_WHEEL_HI_RES
+            _queue(EV_REL, REL_HWHEEL_HI_RES, x * wheel_hi_res_detent);
+#endif
+        }
+    }
+
+    void UInputSender::flush() const
+    {
+        if (_events.empty() || _fd == -1)
+        {
+            _events.clear();
+            return;
+        }
+
+        _queue(EV_SYN, SYN_REPORT, 0);
+
+        // Write the whole batch with a single syscall
+        ssize_t size = _events.size() * sizeof(input_event);
+        if (write(_fd, _events.data(), size) != size)
+            cerr << "Failed to write uinput events: " << std::strerror(errno) << endl;
+
+        _events.clear();
+    }
+
+    bool UInputSender::attach([[maybe_unused]] const char* title)
+    {
+        return _fd != -1;
+    }
+
+    unsigned long UInputSender::convertSDLKey(SDL_Keycode keycode, SDL_Scancode scancode) const
+    {
+        if (const KeyMapping* mapping = findKeyMapping(scancode))
+            return mapping->evdev;
+        return _convertSDLKeycode(keycode);
+    }
+
+    unsigned short UInputSender::_convertSDLKeycode(SDL_Keycode keycode)
+    {
+        switch (keycode)
+        {
+            case SDLK_a: return KEY_A;
+            case SDLK_b: return KEY_B;
+            case SDLK_c: return KEY_C;
+            case SDLK_d: return KEY_D;
+            case SDLK_e: return KEY_E;
+            case SDLK_f: return KEY_F;
+            case SDLK_g: return KEY_G;
+            case SDLK_h: return KEY_H;
+            case SDLK_i: return KEY_I;
+            case SDLK_j: return KEY_J;
+            case SDLK_k: return KEY_K;
+            case SDLK_l: return KEY_L;
+            case SDLK_m: return KEY_M;
+            case SDLK_n: return KEY_N;
+            case SDLK_o: return KEY_O;
+            case SDLK_p: return KEY_P;
+            case SDLK_q: return KEY_Q;
+            case SDLK_r: return KEY_R;
+            case SDLK_s: return KEY_S;
+            case SDLK_t: return KEY_T;
+            case SDLK_u: return KEY_U;
+            case SDLK_v: return KEY_V;
+            case SDLK_w: return KEY_W;
+            case SDLK_x: return KEY_X;
+            case SDLK_y: return KEY_Y;
+            case SDLK_z: return KEY_Z;
+            case SDLK_1: return KEY_1;
+            case SDLK_2: return KEY_2;
+            case SDLK_3: return KEY_3;
+            case SDLK_4: return KEY_4;
+            case SDLK_5: return KEY_5;
+            case SDLK_6: return KEY_6;
+            case SDLK_7: return KEY_7;
+            case SDLK_8: return KEY_8;
+            case SDLK_9: return KEY_9;
+            case SDLK_0: return KEY_0;
+            case SDLK_MINUS: return KEY_MINUS;
+            case SDLK_EQUALS: return KEY_EQUAL;
+            case SDLK_LEFTBRACKET: return KEY_LEFTBRACE;
+            case SDLK_RIGHTBRACKET: return KEY_RIGHTBRACE;
+            case SDLK_BACKSLASH: return KEY_BACKSLASH;
+            case SDLK_SEMICOLON: return KEY_SEMICOLON;
+            case SDLK_QUOTE: return KEY_APOSTROPHE;
+            case SDLK_BACKQUOTE: return KEY_GRAVE;
+            case SDLK_COMMA: return KEY_COMMA;
+            case SDLK_PERIOD: return KEY_DOT;
+            case SDLK_SLASH: return KEY_SLASH;
+            case SDLK_SPACE: return KEY_SPACE;
+            case SDLK_TAB: return KEY_TAB;
+            case SDLK_RETURN: return KEY_ENTER;
+            case SDLK_ESCAPE: return KEY_ESC;
+            case SDLK_BACKSPACE: return KEY_BACKSPACE;
+            case SDLK_DELETE: return KEY_DELETE;
+            case SDLK_INSERT: return KEY_INSERT;
+            case SDLK_HOME: return KEY_HOME;
+            case SDLK_END: return KEY_END;
+            case SDLK_PAGEUP: return KEY_PAGEUP;
+            case SDLK_PAGEDOWN: return KEY_PAGEDOWN;
+            case SDLK_UP: return KEY_UP;
+            case SDLK_DOWN: return KEY_DOWN;
+            case SDLK_LEFT: return KEY_LEFT;
+            case SDLK_RIGHT: return KEY_RIGHT;
+            case SDLK_F1: return KEY_F1;
+            case SDLK_F2: return KEY_F2;
+            case SDLK_F3: return KEY_F3;
+            case SDLK_F4: return KEY_F4;
+            case SDLK_F5: return KEY_F5;
+            case SDLK_F6: return KEY_F6;
+            case SDLK_F7: return KEY_F7;
+            case SDLK_F8: return KEY_F8;
+            case SDLK_F9: return KEY_F9;
+            case SDLK_F10: return KEY_F10;
+            case SDLK_F11: return KEY_F11;
+            case SDLK_F12: return KEY_F12;
+            case SDLK_CAPSLOCK: return KEY_CAPSLOCK;
+            case SDLK_LCTRL: return KEY_LEFTCTRL;
+            case SDLK_RCTRL: return KEY_RIGHTCTRL;
+            case SDLK_LSHIFT: return KEY_LEFTSHIFT;
+            case SDLK_RSHIFT: return KEY_RIGHTSHIFT;
+            case SDLK_LALT: return KEY_LEFTALT;
+            case SDLK_RALT: return KEY_RIGHTALT;
+            case SDLK_LGUI: return KEY_LEFTMETA;
+            case SDLK_RGUI: return KEY_RIGHTMETA;
+
+            default:
+                cerr << "Unknown key: " << keycode << endl;
+                return KEY_RESERVED;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef UINPUT_HPP
+#define UINPUT_HPP
+
+#include <vector>
+#include <linux/input.h>
+#include "input_sender_base.hpp"
+
+namespace input {
+    // Injects inputs through a virtual uinput device (keyboard + relative mouse + high-resolution
+    // wheel). Events are queued and written in a single batch terminated by SYN_REPORT on flush().
+    // Requires write access to /dev/uinput and an X server that picks up evdev devices, e.g. Xorg
+    // with libinput. Xvfb does not read evdev devices.
+    class UInputSender final : public IInputSender
+    {
+        public:
+            UInputSender();
+            ~UInputSender() final;
+
+            bool attach(const char* title) final;
+            void sendKey(bool pressed, unsigned long key) const final;
+            void sendMouse(bool pressed, unsigned int button) const final;
+            void sendMouseMove(int x, int y, bool relative) const final;
+            void sendMouseWheel(int x, int y) const final;
+            void flush() const final;
+            unsigned long convertSDLKey(SDL_Keycode keycode, SDL_Scancode scancode) const final;
+
+        private:
+            // Convert an SDL keycode to a Linux keycode
+            static unsigned short _convertSDLKeycode(SDL_Keycode keycode);
+
+            void _queue(unsigned short type, unsigned short code, int value) const;
+
+        private:
+            int _fd;
+            mutable std::vector<input_event> _events;
+    };
+}
+
+#endif
@@ -7,43 +7,6 @@
 #include <iostream>
 
 namespace input {
-    Window findWindowByName(Display* display, Window root, const char* name)
-    {
-        unsigned int nchildren;
-        Window* children;
-        Window root_return, parent_return;
-        Window found = BadWindow;
-
-        XQueryTree(display, root, &root_return, &parent_return, &children, &nchildren);
-
-        for (size_t i = 0; i < nchildren; ++i)
-        {
-            Window win = children[i];
-            char* title = nullptr;
-            XFetchName(display, win, &title);
-
-            if (title != nullptr)
-            {
-                if (strcmp(name, title) == 0)
-                {
-                    found = win;
-                    break;
-                }
-                XFree(title);
-            }
-
-            found = findWindowByName(display, win, name);
-            if (found != BadWindow)
-                break;
-        }
-
-        if (children)
-            XFree(children);
-
-        return found;
-    }
-
-
     InputSender::InputSender()
     {
         _display = XOpenDisplay(nullptr);
@@ -54,12 +17,10 @@ namespace input {
         XCloseDisplay(_display);
     }
 
-    void InputSender::sendKey(bool pressed, KeySym key) const
+    void InputSender::sendKey(bool pressed, unsigned long keycode) const
     {
-        auto keycode = XKeysymToKeycode(_display, key);
-
-        if (keycode == NoSymbol)
-            std::cerr << "Unknown key: " << key << std::endl;
+        if (keycode == 0)
+            std::cerr << "Unknown key\n";
         else
             XTestFakeKeyEvent(_display, keycode, pressed, CurrentTime);
     }
@@ -101,10 +62,25 @@ namespace input {
 
     bool InputSender::attach([[maybe_unused]] const char* title)
     {
+        _keymap.build(_display);
         return true;
     };
 
-    unsigned long InputSender::convertSDLKeycode(SDL_Keycode keycode) const
+    unsigned long InputSender::convertSDLKey(SDL_Keycode keycode, SDL_Scancode scancode) const
+    {
+        // Keymap changes, e.g. by setxkbmap, are signaled asynchronously
+        _keymap.update(_display);
+
+        if (KeyCode code = _keymap.fromScancode(scancode); code != 0)
+            return code;
+
+        KeyCode code = _keymap.fromKeysym(_convertSDLKeycode(keycode));
+        if (code == 0)
+            std::cerr << "Unknown key: " << keycode << " (scancode " << scancode << ")" << std::endl;
+        return code;
+    }
+
+    KeySym InputSender::_convertSDLKeycode(SDL_Keycode keycode)
     {
         switch (keycode)
         {
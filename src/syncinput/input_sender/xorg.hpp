@@ -3,11 +3,10 @@
 
 #include <X11/Xlib.h>
 #include "input_sender_base.hpp"
+#include "keymap.hpp"
 
 namespace input {
-    Window findWindowByName(Display* display, Window root, const char* name);
-
-    class InputSender final : private IInputSender
+    class InputSender final : public IInputSender
     {
         public:
             InputSender();
@@ -19,10 +18,15 @@ namespace input {
             void sendMouseMove(int x, int y, bool relative) const final;
             void sendMouseWheel(int x, int y) const final;
             void flush() const final;
-            unsigned long convertSDLKeycode(SDL_Keycode keycode) const final;
+            unsigned long convertSDLKey(SDL_Keycode keycode, SDL_Scancode scancode) const final;
+
+        private:
+            // Convert an SDL keycode to an X11 keysym
+            static KeySym _convertSDLKeycode(SDL_Keycode keycode);
 
         private:
             Display* _display;
+            mutable XKeymap _keymap;
     };
 }
 
@@ -1,7 +1,15 @@
 #include <iostream>
-#include <unistd.h>  // sleep
+#include <memory>
+#include <cstring>
+#include <cstdlib>
 #include "network/input.hpp"
 #include "input_sender/input_sender.hpp"
+#include "cursor_watcher.hpp"
+#include "util/clock.hpp"
+#include "util/config.hpp"
+#include "util/histogram.hpp"
+#include "util/thread_role.hpp"
+#include "util/x11.hpp"
 
 using std::cout;
 using std::cerr;
@@ -9,56 +17,200 @@ using std::endl;
 
 
 void help() {
-    cout << "Usage: syncinput <window title> <ip> <port> <tcp|udp>\n";
-    cout << "Listens on the given IP and port, or localhost:9090 by default, for inputs and sends them to the window with the given title.\n";
+    cout << "Usage: syncinput <window title> <ip> <port> <tcp|udp> [xtest|uinput] [flags...]\n";
+    cout << "       syncinput --config=<file> [flags...]\n";
+    cout << "Listens on the given IP and port for inputs and sends them to the window with the given title.\n";
+    cout << "An empty title skips waiting for the window. Otherwise, syncinput re-attaches whenever the window is recreated.\n";
+    cout << "The last argument selects the input injection backend. Default: xtest\n";
+    cout << "All options can also be set in the config file, either globally or in its [syncinput] section. The positional arguments correspond to the options window, host, port, protocol and backend.\n";
+    cout << "Flags are given as key=value or --key=value. They override the config file.\n";
+    cout << "Flags:\n";
+    cout << "\tconfig=<file>: Read options from the given config file\n";
+    cout << "\tattach-tries=<n>: Number of seconds to wait for the window. Default: 5\n";
+    cout << "\tcursor-port=<port>: Forward the cursor to the frontend on this TCP port and hide it on the X server\n";
+    cout << "\tcursor-window: Report cursor positions relative to the window, e.g. when only the window is captured\n";
+    cout << "\tcursor-poll-us=<us>: Interval in which the cursor position is read. Default: 1000\n";
+    cout << "\tthread=<role>: Pin the receive loop and set its scheduling, given as <cores>[:<policy>[:<priority>]], e.g. 1:fifo:50. Policy is one of other, fifo and rr.\n";
+    cout << "\tmlock: Lock all memory to avoid page faults\n";
 }
 
 
-bool attach(input::InputSender& input, const char* winTitle, int maxTries) {
-    for (int i = 0; i < maxTries; ++i) {
-        if (input.attach(winTitle))
-            return true;
-        cout << "Waiting for window with name '" << winTitle << "'...\n";
-        sleep(1);
-    }
-    return false;
+std::unique_ptr<input::IInputSender> createInputSender(const char* backend) {
+    if (strcmp(backend, "xtest") == 0)
+        return std::make_unique<input::InputSender>();
+    else if (strcmp(backend, "uinput") == 0)
+        return std::make_unique<input::UInputSender>();
+
+    cerr << "Unknown input backend: " << backend << endl;
+    return nullptr;
 }
 
 
+// Collects input path latency statistics.
+// The one-way delay relies on the frontend's clock sync. Without it, it is only meaningful if
+// both sides run on the same host.
+class InputStats {
+    public:
+        // Interval in which statistics are printed
+        static constexpr int64_t report_interval_us = 10'000'000;
+
+        InputStats() : _lastTransit(0), _jitter(0), _lastReport(util::monotonicTimeUs()) {}
+
+        void addEvent(int64_t sendTime, int64_t receiveTime, int64_t injectedTime) {
+            const int64_t transit = receiveTime - sendTime;
+
+            // Inter-arrival jitter according to RFC 3550, section 6.4.1
+            if (_delay.count() > 0) {
+                const int64_t d = std::llabs(transit - _lastTransit);
+                _interarrival.add(d);
+                _jitter += (d - _jitter) / 16.0;
+            }
+
+            _lastTransit = transit;
+            _delay.add(transit);
+            _injection.add(injectedTime - receiveTime);
+
+            if (injectedTime - _lastReport >= report_interval_us) {
+                print();
+                _lastReport = injectedTime;
+            }
+        }
+
+        void print() const {
+            cout << "Input statistics, RFC 3550 jitter: " << static_cast<int64_t>(_jitter) << "us\n";
+            _delay.print(cout, "One-way delay");
+            _interarrival.print(cout, "Inter-arrival jitter");
+            _injection.print(cout, "Injection time");
+        }
+
+    private:
+        util::Histogram _delay;
+        util::Histogram _interarrival;
+        util::Histogram _injection;
+        int64_t _lastTransit;
+        double _jitter;
+        int64_t _lastReport;
+};
+
+
 int main(int argc, char *argv[]) {
-    if (argc < 5) {
+    util::Config config("syncinput");
+    if (!config.parseArgs(argc, argv, { "window", "host", "port", "protocol", "backend" }))
+        return 1;
+
+    if (config.has("help")) {
+        help();
+        return 0;
+    }
+
+    if (const char* key = config.missing({ "window", "host", "port", "protocol" })) {
         help();
-        cerr << "Missing arguments\n";
+        cerr << "Missing option: " << key << endl;
         return 1;
     }
 
-    const char* winTitle = argv[1];
-    const char* host = argv[2];
-    const char* port = argv[3];
-    net::SocketType protocol = net::parseProtocol(argv[4]);
+    const std::string winTitle = config.getString("window");
+    const std::string host = config.getString("host");
+    const std::string port = config.getString("port");
+    net::SocketType protocol = net::parseProtocol(config.getString("protocol").c_str());
+    const std::string backend = config.getString("backend", "xtest");
+    const int attachTries = config.getInt("attach-tries", 5);
+    const std::string cursorPort = config.getString("cursor-port");
+    const bool cursorWindow = config.getBool("cursor-window", false);
+    const int cursorPollUs = config.getInt("cursor-poll-us", 1000);
+    const bool lockMemory = config.getBool("mlock", false);
+    util::ThreadRole receiveRole;
+
+    if (config.has("thread") && !util::parseThreadRole(config.getString("thread"), &receiveRole))
+        return 1;
+
+    if (!config.check())
+        return 1;
+    config.print(cout);
+
+    if (lockMemory && !util::lockMemory())
+        return 1;
+
+    // Listen before the input connection is accepted, so the frontend can connect right after it
+    input::CursorWatcher cursorWatcher;
+    if (!cursorPort.empty() && !cursorWatcher.start(host.c_str(), cursorPort.c_str(), cursorPollUs))
+        return 1;
 
     input::InputTransmitter inputTransmitter;
-    if (!inputTransmitter.listen(host, port, protocol)) {
+    if (!inputTransmitter.listen(host.c_str(), port.c_str(), protocol)) {
         cerr << "Failed to establish connection\n";
         return 1;
     }
 
-    input::InputSender inputSender;
-    if (!attach(inputSender, winTitle, 5)) {
+    auto sender = createInputSender(backend.c_str());
+    if (!sender)
+        return 1;
+
+    cout << "Using input backend: " << backend << endl;
+    input::IInputSender& inputSender = *sender;
+
+    // Follows window creation through X events, so a recreated window is found right away
+    util::WindowTracker tracker;
+    Window window = None;
+
+    if (!winTitle.empty()) {
+        if (!tracker.start())
+            return 1;
+
+        cout << "Waiting for window with name '" << winTitle << "'...\n";
+        window = tracker.waitFor(winTitle, attachTries * 1000);
+
+        if (window == None) {
+            cerr << "Window '" << winTitle << "' not found\n";
+            return 1;
+        }
+
+        util::WindowTracker::WindowInfo info {};
+        tracker.info(window, &info);
+        cout << "Found window 0x" << std::hex << window << std::dec << ", pid " << info.pid << endl;
+
+        if (cursorWindow)
+            cursorWatcher.setOrigin(window);
+    }
+
+    if (!inputSender.attach(winTitle.c_str())) {
         cerr << "Failed to attach to window\n";
         return 1;
     }
 
+    InputStats stats;
+
+    // After starting all other threads, so they do not inherit the role
+    util::ScopedThreadRole role("receive", receiveRole);
+
     while (true) {
         input::InputEvent event;
 
         if (!inputTransmitter.recv(&event))
             break;
 
+        const int64_t receiveTime = util::monotonicTimeUs();
+
+        // Only a hash lookup, the tracker updates its cache in the background
+        if (window != None) {
+            if (Window current = tracker.find(winTitle); current != None && current != window) {
+                cout << "Window recreated, re-attaching to 0x" << std::hex << current << std::dec << endl;
+                window = current;
+                inputSender.attach(winTitle.c_str());
+
+                if (cursorWindow)
+                    cursorWatcher.setOrigin(window);
+            }
+        }
+
         switch (event.type) {
+            case input::InputEventType::EventPing:
+                inputTransmitter.sendPong(event, receiveTime);
+                continue;
             case input::InputEventType::EventKey:
                 // cout << "key received " << event.key.key << " " << event.key.pressed << endl;
-                inputSender.sendKey(event.key.pressed, inputSender.convertSDLKeycode(event.key.key));
+                inputSender.sendKey(event.key.pressed,
+                        inputSender.convertSDLKey(event.key.key, static_cast<SDL_Scancode>(event.key.scancode)));
                 break;
             case input::InputEventType::EventMouseButton:
                 // cout << "mouse received " << static_cast<int>(event.button.button) << " " << event.button.pressed << endl;
@@ -74,11 +226,17 @@ int main(int argc, char *argv[]) {
                 break;
             default:
                 cerr << "Invalid event type: " << static_cast<int>(event.type) << endl;
-                break;
+                continue;
         }
 
         inputSender.flush();
+
+        if (event.type == input::InputEventType::EventMouseMotion)
+            cursorWatcher.setLastMotion(input::timestampToUs(event.timestamp));
+
+        stats.addEvent(input::timestampToUs(event.timestamp), receiveTime, util::monotonicTimeUs());
     }
 
+    stats.print();
     return 0;
 }
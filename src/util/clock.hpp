@@ -0,0 +1,18 @@
+#ifndef UTIL_CLOCK_HPP
+#define UTIL_CLOCK_HPP
+
+#include <chrono>
+#include <cstdint>
+
+namespace util {
+    // Returns the current monotonic time in microseconds, relative to an arbitrary epoch.
+    // The epoch is the same for all processes on the same host.
+    inline int64_t monotonicTimeUs() {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        using std::chrono::steady_clock;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include "config.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+using std::cerr;
+using std::endl;
+
+namespace util {
+    static std::string trim(const std::string& str) {
+        const size_t begin = str.find_first_not_of(" \t\r");
+        if (begin == std::string::npos)
+            return "";
+        const size_t end = str.find_last_not_of(" \t\r");
+        return str.substr(begin, end - begin + 1);
+    }
+
+    static std::string toString(double value) {
+        std::ostringstream out;
+        out << value;
+        return out.str();
+    }
+
+
+    Config::Config(const char* section) : _section(section), _valid(true) {}
+
+    bool Config::parseArgs(int argc, char* argv[], std::initializer_list<const char*> positional) {
+        std::vector<std::pair<std::string, std::string>> args;
+        size_t numPositional = 0;
+        bool flags = false;
+
+        for (int i = 1; i < argc; ++i) {
+            const char* arg = argv[i];
+
+            if (strncmp(arg, "--", 2) == 0) {
+                flags = true;
+                arg += 2;
+            } else if (!flags && numPositional < positional.size()) {
+                args.emplace_back(positional.begin()[numPositional++], arg);
+                continue;
+            }
+
+            if (const char* eq = strchr(arg, '='))
+                args.emplace_back(std::string(arg, eq), eq + 1);
+            else if (strncmp(arg, "no-", 3) == 0)
+                args.emplace_back(arg + 3, "false");
+            else
+                args.emplace_back(arg, "true");
+        }
+
+        // The file is loaded first, so the command line overrides it regardless of the order
+        for (const auto& [key, value] : args) {
+            if (key == "config" && !loadFile(value.c_str()))
+                return false;
+        }
+
+        for (const auto& [key, value] : args)
+            _set(key, value, Source::CommandLine);
+
+        if (has("config"))
+            getString("config");
+
+        return true;
+    }
+
+    bool Config::loadFile(const char* path) {
+        std::ifstream file(path);
+
+        if (!file) {
+            cerr << "Failed to open config file " << path << endl;
+            return false;
+        }
+
+        std::string line;
+        Source source = Source::File;
+        bool skip = false;
+
+        for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+            line = trim(line);
+
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            if (line.front() == '[' && line.back() == ']') {
+                skip = trim(line.substr(1, line.size() - 2)) != _section;
+                source = Source::Section;
+                continue;
+            }
+
+            const size_t eq = line.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                cerr << path << ":" << lineNumber << ": Expected 'key = value'\n";
+                return false;
+            }
+
+            if (!skip)
+                _set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)), source);
+        }
+
+        _path = path;
+        return true;
+    }
+
+    bool Config::has(const char* key) const {
+        return _values.find(key) != _values.end();
+    }
+
+    const char* Config::missing(std::initializer_list<const char*> keys) const {
+        for (const char* key : keys)
+            if (!has(key))
+                return key;
+        return nullptr;
+    }
+
+    std::string Config::getString(const char* key, const char* def) {
+        const Value* value = _get(key, def);
+        return value ? value->value : def;
+    }
+
+    int64_t Config::getInt(const char* key, int64_t def) {
+        const Value* value = _get(key, std::to_string(def).c_str());
+        if (!value)
+            return def;
+
+        char* end = nullptr;
+        const int64_t result = std::strtoll(value->value.c_str(), &end, 0);
+
+        if (value->value.empty() || *end != '\0') {
+            _invalid(key, value->value);
+            return def;
+        }
+
+        return result;
+    }
+
+    double Config::getFloat(const char* key, double def) {
+        const Value* value = _get(key, toString(def).c_str());
+        if (!value)
+            return def;
+
+        char* end = nullptr;
+        const double result = std::strtod(value->value.c_str(), &end);
+
+        if (value->value.empty() || *end != '\0') {
+            _invalid(key, value->value);
+            return def;
+        }
+
+        return result;
+    }
+
+    bool Config::getBool(const char* key, bool def) {
+        const Value* value = _get(key, def ? "true" : "false");
+        if (!value)
+            return def;
+
+        const std::string& str = value->value;
+
+        if (str == "true" || str == "yes" || str == "on" || str == "1")
+            return true;
+        else if (str == "false" || str == "no" || str == "off" || str == "0")
+            return false;
+
+        _invalid(key, str);
+        return def;
+    }
+
+    bool Config::check() const {
+        for (const auto& [key, value] : _values) {
+            // Global keys of a shared config file may be meant for other executables
+            if (value.source == Source::File)
+                continue;
+
+            const bool used = std::any_of(_effective.begin(), _effective.end(),
+                    [&key](const Effective& e) { return e.key == key; });
+
+            if (!used)
+                cerr << "Unknown option: " << key << endl;
+        }
+
+        return _valid;
+    }
+
+    void Config::print(std::ostream& out) const {
+        static const char* const source_names[] = { "default", "file", "file section", "command line" };
+
+        out << "Configuration";
+        if (!_path.empty())
+            out << " (" << _path << ", [" << _section << "])";
+        out << ":\n";
+
+        for (const auto& e : _effective)
+            out << "\t" << e.key << " = " << e.value << "  (" << source_names[static_cast<int>(e.source)] << ")\n";
+    }
+
+    void Config::_set(const std::string& key, const std::string& value, Source source) {
+        auto it = _values.find(key);
+
+        if (it == _values.end())
+            _values.emplace(key, Value { value, source });
+        else if (source >= it->second.source)
+            it->second = Value { value, source };
+    }
+
+    const Config::Value* Config::_get(const char* key, const char* def) {
+        auto it = _values.find(key);
+        const Value* value = it == _values.end() ? nullptr : &it->second;
+        Effective effective { key, value ? value->value : def, value ? value->source : Source::Default };
+
+        auto existing = std::find_if(_effective.begin(), _effective.end(),
+                [key](const Effective& e) { return e.key == key; });
+
+        if (existing != _effective.end())
+            *existing = std::move(effective);
+        else
+            _effective.push_back(std::move(effective));
+
+        return value;
+    }
+
+    void Config::_invalid(const char* key, const std::string& value) {
+        cerr << "Invalid value for option " << key << ": " << value << endl;
+        _valid = false;
+    }
+} // namespace util
@@ -0,0 +1,80 @@
+#ifndef UTIL_CONFIG_HPP
+#define UTIL_CONFIG_HPP
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace util {
+    // Key-value configuration read from a config file and the command line.
+    //
+    // Config files consist of "key = value" lines and "# comments". Keys before the first
+    // [section] header apply to all executables, keys inside a section only to the executable of
+    // the same name, i.e. a single file can configure a whole session.
+    //
+    // Command line arguments are either positional, "key=value", "--key=value", "key" or "--key".
+    // The latter two set the key to true, "no-key" sets it to false. "config=<file>" loads a
+    // config file. Command line values take precedence over the file, section values over
+    // global values.
+    //
+    // Getters record which value was used, including defaults, so the effective configuration
+    // can be printed to the log.
+    class Config {
+        public:
+            // section: Config file section to read, usually the name of the executable.
+            explicit Config(const char* section);
+
+            // Parse the command line. Leading arguments are assigned to the given positional keys
+            // in order, until an argument starts with "--". Remaining arguments must be flags.
+            // Returns false if the config file cannot be read.
+            bool parseArgs(int argc, char* argv[], std::initializer_list<const char*> positional);
+
+            bool loadFile(const char* path);
+
+            bool has(const char* key) const;
+
+            // Returns the first key that is not set, or nullptr if all are set.
+            const char* missing(std::initializer_list<const char*> keys) const;
+
+            std::string getString(const char* key, const char* def = "");
+            int64_t getInt(const char* key, int64_t def);
+            double getFloat(const char* key, double def);
+            bool getBool(const char* key, bool def);
+
+            // Reports options that were never read and returns false if any value was invalid.
+            bool check() const;
+
+            // Print all options read so far and where their value came from.
+            void print(std::ostream& out) const;
+
+        private:
+            enum class Source { Default, File, Section, CommandLine };
+
+            struct Value {
+                std::string value;
+                Source source;
+            };
+
+            struct Effective {
+                std::string key;
+                std::string value;
+                Source source;
+            };
+
+            void _set(const std::string& key, const std::string& value, Source source);
+            const Value* _get(const char* key, const char* def);
+            void _invalid(const char* key, const std::string& value);
+
+        private:
+            std::string _section;
+            std::string _path;
+            std::map<std::string, Value> _values;
+            std::vector<Effective> _effective;
+            bool _valid;
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include "histogram.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <string>
+
+namespace util {
+    Histogram::Histogram() {
+        reset();
+    }
+
+    void Histogram::reset() {
+        _buckets.fill(0);
+        _count = 0;
+        _min = std::numeric_limits<int64_t>::max();
+        _max = 0;
+        _sum = 0;
+    }
+
+    int Histogram::_bucketIndex(uint64_t value) {
+        if (value < linear_buckets)
+            return value;
+
+        int exponent = std::bit_width(value) - 1;  // >= 4
+        int sub = (value >> (exponent - 2)) & (sub_buckets - 1);
+        return linear_buckets + (exponent - 4) * sub_buckets + sub;
+    }
+
+    int64_t Histogram::_bucketLowerBound(int index) {
+        if (index < linear_buckets)
+            return index;
+
+        int exponent = (index - linear_buckets) / sub_buckets + 4;
+        int sub = (index - linear_buckets) % sub_buckets;
+        return (int64_t(sub_buckets + sub)) << (exponent - 2);
+    }
+
+    int64_t Histogram::_bucketUpperBound(int index) {
+        if (index + 1 >= num_buckets)
+            return std::numeric_limits<int64_t>::max();
+        return _bucketLowerBound(index + 1) - 1;
+    }
+
+    void Histogram::add(int64_t value) {
+        // Negative values can only result from clock errors, count them as 0.
+        value = std::max<int64_t>(value, 0);
+        ++_buckets[_bucketIndex(value)];
+        ++_count;
+        _min = std::min(_min, value);
+        _max = std::max(_max, value);
+        _sum += value;
+    }
+
+    uint64_t Histogram::count() const {
+        return _count;
+    }
+
+    int64_t Histogram::min() const {
+        return _count ? _min : 0;
+    }
+
+    int64_t Histogram::max() const {
+        return _max;
+    }
+
+    double Histogram::mean() const {
+        return _count ? _sum / _count : 0;
+    }
+
+    int64_t Histogram::percentile(double p) const {
+        if (_count == 0)
+            return 0;
+
+        auto rank = static_cast<uint64_t>(std::ceil(p / 100.0 * _count));
+        rank = std::clamp<uint64_t>(rank, 1, _count);
+        uint64_t seen = 0;
+
+        for (int i = 0; i < num_buckets; ++i) {
+            seen += _buckets[i];
+            if (seen >= rank)
+                return std::min(_bucketUpperBound(i), _max);
+        }
+
+        return _max;
+    }
+
+    void Histogram::print(std::ostream& out, const char* name, const char* unit) const {
+        out << name << ": n=" << _count
+            << " min=" << min() << unit
+            << " mean=" << static_cast<int64_t>(mean()) << unit
+            << " p50=" << percentile(50) << unit
+            << " p90=" << percentile(90) << unit
+            << " p99=" << percentile(99) << unit
+            << " max=" << max() << unit << "\n";
+
+        if (_count == 0)
+            return;
+
+        constexpr int bar_width = 40;
+        const uint64_t peak = *std::max_element(_buckets.begin(), _buckets.end());
+
+        for (int i = 0; i < num_buckets; ++i) {
+            if (_buckets[i] == 0)
+                continue;
+
+            out << "  [" << _bucketLowerBound(i) << ", " << _bucketUpperBound(i) << "] "
+                << std::string(_buckets[i] * bar_width / peak, '#')
+                << " " << _buckets[i] << "\n";
+        }
+    }
+} // namespace util
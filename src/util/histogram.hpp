@@ -0,0 +1,48 @@
+#ifndef UTIL_HISTOGRAM_HPP
+#define UTIL_HISTOGRAM_HPP
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace util {
+    // Log-linear histogram for non-negative integer samples, e.g. durations in microseconds.
+    // Values below 16 are recorded exactly, larger values in 4 sub-buckets per power of two,
+    // i.e. with a relative error of at most 25%. Not thread-safe.
+    class Histogram {
+        public:
+            Histogram();
+
+            void add(int64_t value);
+            void reset();
+
+            uint64_t count() const;
+            int64_t min() const;
+            int64_t max() const;
+            double mean() const;
+
+            // Returns an upper bound for the given percentile (0-100).
+            int64_t percentile(double p) const;
+
+            // Print a summary line followed by one line per non-empty bucket.
+            void print(std::ostream& out, const char* name, const char* unit = "us") const;
+
+        private:
+            static constexpr int linear_buckets = 16;
+            static constexpr int sub_buckets = 4;
+            static constexpr int num_buckets = linear_buckets + (63 - 4) * sub_buckets;
+
+            static int _bucketIndex(uint64_t value);
+            static int64_t _bucketLowerBound(int index);
+            static int64_t _bucketUpperBound(int index);
+
+        private:
+            std::array<uint64_t, num_buckets> _buckets;
+            uint64_t _count;
+            int64_t _min;
+            int64_t _max;
+            double _sum;
+    };
+}
+
+#endif
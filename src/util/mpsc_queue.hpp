@@ -0,0 +1,165 @@
+#ifndef UTIL_MPSC_QUEUE_HPP
+#define UTIL_MPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+    // Bounded lock-free multi-producer single-consumer queue.
+    // Based on Dmitry Vyukov's bounded MPMC queue, with the consumer side simplified.
+    // push() never blocks, i.e. fails if the queue is full. Producers can instead sleep until
+    // space is available using waitPush().
+    // The consumer can sleep until an element arrives using waitPop().
+    // Capacity must be a power of two.
+    template <typename T, size_t Capacity>
+    class MPSCQueue {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        public:
+            MPSCQueue() : _head(0), _tail(0), _signal(0), _space(0), _waitingProducers(0), _closed(false) {
+                for (size_t i = 0; i < Capacity; ++i)
+                    _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            // (Thread-safe) Returns false if the queue is full or closed.
+            bool push(const T& value) {
+                if (_closed.load(std::memory_order_relaxed))
+                    return false;
+
+                size_t pos = _tail.load(std::memory_order_relaxed);
+                Cell* cell;
+
+                while (true) {
+                    cell = &_cells[pos & mask];
+                    size_t seq = cell->sequence.load(std::memory_order_acquire);
+                    intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+                    if (diff == 0) {
+                        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff < 0)
+                        return false;  // Full
+                    else
+                        pos = _tail.load(std::memory_order_relaxed);
+                }
+
+                cell->value = value;
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                _wake();
+                return true;
+            }
+
+            // (Thread-safe) Wait until there is space for the element or the queue is closed.
+            // Returns false if the queue was closed.
+            bool waitPush(const T& value) {
+                // Registered before checking for space, so the consumer cannot miss us
+                _waitingProducers.fetch_add(1, std::memory_order_seq_cst);
+                bool pushed = false;
+
+                while (!pushed && !isClosed()) {
+                    uint32_t space = _space.load(std::memory_order_acquire);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                    if (!(pushed = push(value)) && !isClosed())
+                        _space.wait(space, std::memory_order_acquire);
+                }
+
+                _waitingProducers.fetch_sub(1, std::memory_order_relaxed);
+                return pushed;
+            }
+
+            // (Consumer only) Returns false if the queue is empty.
+            bool pop(T* value) {
+                Cell* cell = _front();
+                if (!cell)
+                    return false;
+
+                *value = cell->value;
+                cell->sequence.store(_head + Capacity, std::memory_order_release);
+                ++_head;
+
+                // Pairs with the fence in waitPush(), i.e. either the producer sees the free cell
+                // or we see the producer waiting
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (_waitingProducers.load(std::memory_order_relaxed) > 0)
+                    _wakeProducers();
+
+                return true;
+            }
+
+            // (Consumer only) Returns a pointer to the next element, or nullptr if the queue is
+            // empty. The pointer stays valid until the element is popped.
+            const T* peek() {
+                Cell* cell = _front();
+                return cell ? &cell->value : nullptr;
+            }
+
+            // (Consumer only) Wait until an element is available or the queue is closed.
+            // Returns false if the queue was closed and all elements have been consumed.
+            bool waitPop(T* value) {
+                while (true) {
+                    uint32_t signal = _signal.load(std::memory_order_acquire);
+
+                    if (pop(value))
+                        return true;
+
+                    if (_closed.load(std::memory_order_acquire))
+                        return false;
+
+                    _signal.wait(signal, std::memory_order_acquire);
+                }
+            }
+
+            // (Thread-safe) Reject further elements and wake up the consumer and waiting producers.
+            void close() {
+                _closed.store(true, std::memory_order_release);
+                _wake();
+                _wakeProducers();
+            }
+
+            bool isClosed() const {
+                return _closed.load(std::memory_order_acquire);
+            }
+
+        private:
+            static constexpr size_t mask = Capacity - 1;
+
+            // Avoid false sharing between producers and the consumer
+            static constexpr size_t cache_line_size = 64;
+
+            struct Cell {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            Cell* _front() {
+                Cell* cell = &_cells[_head & mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                return seq == _head + 1 ? cell : nullptr;
+            }
+
+            void _wake() {
+                _signal.fetch_add(1, std::memory_order_release);
+                _signal.notify_one();
+            }
+
+            void _wakeProducers() {
+                _space.fetch_add(1, std::memory_order_release);
+                _space.notify_all();
+            }
+
+        private:
+            std::array<Cell, Capacity> _cells;
+            alignas(cache_line_size) size_t _head;
+            alignas(cache_line_size) std::atomic<size_t> _tail;
+            alignas(cache_line_size) std::atomic<uint32_t> _signal;
+            alignas(cache_line_size) std::atomic<uint32_t> _space;
+            std::atomic<uint32_t> _waitingProducers;
+            std::atomic<bool> _closed;
+    };
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include "thread_role.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <syncstream>
+#include <thread>
+
+#ifdef __linux__
+#   include <pthread.h>
+#   include <sched.h>
+#   include <sys/mman.h>
+#   include <sys/resource.h>
+#endif
+
+namespace util {
+    bool ThreadRole::isDefault() const {
+        return cores.empty() && policy == Policy::Default;
+    }
+
+    static bool parseCores(const std::string& spec, std::vector<int>* cores) {
+        std::istringstream stream(spec);
+        std::string range;
+
+        while (std::getline(stream, range, ',')) {
+            int first, last;
+            char dash;
+            std::istringstream rangeStream(range);
+
+            if (!(rangeStream >> first))
+                return false;
+
+            if (rangeStream >> dash) {
+                if (dash != '-' || !(rangeStream >> last) || last < first)
+                    return false;
+            } else {
+                last = first;
+            }
+
+            if (first < 0)
+                return false;
+
+            for (int core = first; core <= last; ++core)
+                cores->push_back(core);
+        }
+
+        return true;
+    }
+
+    bool parseThreadRole(const std::string& spec, ThreadRole* role) {
+        std::istringstream stream(spec);
+        std::string cores, policy, priority;
+        std::getline(stream, cores, ':');
+        std::getline(stream, policy, ':');
+        std::getline(stream, priority);
+
+        *role = ThreadRole();
+
+        if (!parseCores(cores, &role->cores)) {
+            std::cerr << "Invalid cores: " << cores << "\n";
+            return false;
+        }
+
+        // Unknown if 0, in which case pthread_setaffinity_np() rejects nonexistent cores
+        const unsigned numCores = std::thread::hardware_concurrency();
+
+        for (int core : role->cores) {
+#ifdef __linux__
+            if (core >= CPU_SETSIZE) {
+                std::cerr << "Core " << core << " exceeds the maximum of " << CPU_SETSIZE - 1 << ": " << cores << "\n";
+                return false;
+            }
+#endif
+            if (numCores > 0 && static_cast<unsigned>(core) >= numCores) {
+                std::cerr << "Core " << core << " does not exist, there are " << numCores << " cores: " << cores << "\n";
+                return false;
+            }
+        }
+
+        if (policy.empty())
+            role->policy = ThreadRole::Policy::Default;
+        else if (policy == "other")
+            role->policy = ThreadRole::Policy::Other;
+        else if (policy == "fifo")
+            role->policy = ThreadRole::Policy::Fifo;
+        else if (policy == "rr")
+            role->policy = ThreadRole::Policy::RoundRobin;
+        else {
+            std::cerr << "Unknown scheduling policy: " << policy << "\n";
+            return false;
+        }
+
+        if (!priority.empty())
+            role->priority = atoi(priority.c_str());
+
+        const bool realtime = role->policy == ThreadRole::Policy::Fifo || role->policy == ThreadRole::Policy::RoundRobin;
+        if (realtime && (role->priority < 1 || role->priority > 99)) {
+            std::cerr << "Real-time priority must be between 1 and 99: " << spec << "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool applyThreadRole(const ThreadRole& role) {
+#ifdef __linux__
+        bool success = true;
+
+        if (!role.cores.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+
+            // The cores are validated by parseThreadRole()
+            for (int core : role.cores)
+                CPU_SET(core, &set);
+
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+                std::cerr << "Failed to set thread affinity\n";
+                success = false;
+            }
+        }
+
+        if (role.policy != ThreadRole::Policy::Default) {
+            int policy = SCHED_OTHER;
+            sched_param param {};
+
+            if (role.policy == ThreadRole::Policy::Fifo)
+                policy = SCHED_FIFO;
+            else if (role.policy == ThreadRole::Policy::RoundRobin)
+                policy = SCHED_RR;
+
+            if (policy != SCHED_OTHER)
+                param.sched_priority = role.priority;
+
+            if (int err = pthread_setschedparam(pthread_self(), policy, &param); err != 0) {
+                std::cerr << "Failed to set thread scheduling policy: " << strerror(err) << "\n";
+                success = false;
+            }
+        }
+
+        return success;
+#else
+        return role.isDefault();
+#endif
+    }
+
+    bool lockMemory() {
+#ifdef __linux__
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            std::cerr << "Failed to lock memory: " << strerror(errno) << "\n";
+            return false;
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    ScopedThreadRole::ScopedThreadRole(const char* name, const ThreadRole& role) :
+        _name(name), _voluntary(0), _involuntary(0)
+    {
+        if (!role.isDefault())
+            applyThreadRole(role);
+
+#ifdef __linux__
+        rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            _voluntary = usage.ru_nvcsw;
+            _involuntary = usage.ru_nivcsw;
+        }
+#endif
+    }
+
+    ScopedThreadRole::~ScopedThreadRole() {
+#ifdef __linux__
+        rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) != 0)
+            return;
+
+        std::osyncstream(std::cout) << "Thread " << _name << ": " << usage.ru_nvcsw - _voluntary
+            << " voluntary, " << usage.ru_nivcsw - _involuntary << " involuntary context switches\n";
+#endif
+    }
+} // namespace util
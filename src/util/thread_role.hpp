@@ -0,0 +1,55 @@
+#ifndef UTIL_THREAD_ROLE_HPP
+#define UTIL_THREAD_ROLE_HPP
+
+#include <string>
+#include <vector>
+
+namespace util {
+    // Placement of a latency critical thread, so it does not compete with the game, Xvfb and the
+    // encoder for CPU time.
+    struct ThreadRole {
+        enum class Policy {
+            Default,    // Keep the inherited policy
+            Other,      // SCHED_OTHER
+            Fifo,       // SCHED_FIFO
+            RoundRobin, // SCHED_RR
+        };
+
+        std::vector<int> cores;  // Allowed cores, empty to keep the inherited affinity
+        Policy policy = Policy::Default;
+        int priority = 0;        // Real-time priority for Fifo and RoundRobin, 1 to 99
+
+        bool isDefault() const;
+    };
+
+    // Parse a role given as <cores>[:<policy>[:<priority>]], e.g. "2-3:fifo:50" or ":rr:10".
+    // Cores are a comma separated list of cores or core ranges, policy is one of other, fifo
+    // and rr.
+    bool parseThreadRole(const std::string& spec, ThreadRole* role);
+
+    // Apply the role to the calling thread. Threads created afterwards by the calling thread
+    // inherit it. Real-time priorities require CAP_SYS_NICE or a sufficient RLIMIT_RTPRIO.
+    bool applyThreadRole(const ThreadRole& role);
+
+    // Lock all current and future memory of the process, so real-time threads do not stall on
+    // page faults. Requires CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK.
+    bool lockMemory();
+
+    // Applies a role to the calling thread for the lifetime of the object and prints the number
+    // of context switches of the thread when it is destroyed. Many involuntary context switches
+    // mean that the thread is preempted, i.e. competes for its cores.
+    class ScopedThreadRole {
+        public:
+            ScopedThreadRole(const char* name, const ThreadRole& role);
+            ScopedThreadRole(const ScopedThreadRole&) = delete;
+            ScopedThreadRole& operator=(const ScopedThreadRole&) = delete;
+            ~ScopedThreadRole();
+
+        private:
+            const char* _name;
+            long _voluntary;
+            long _involuntary;
+    };
+}
+
+#endif
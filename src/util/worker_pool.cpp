@@ -0,0 +1,118 @@
+#include "worker_pool.hpp"
+#include <iostream>
+
+#ifdef __linux__
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+namespace util {
+    bool pinThreadToCores(int first, int count) {
+#ifdef __linux__
+        const int numCores = std::thread::hardware_concurrency();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        for (int i = 0; i < count; ++i)
+            CPU_SET((first + i) % numCores, &set);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            std::cerr << "Failed to set thread affinity\n";
+            return false;
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool pinThreadToCore(int core) {
+        return pinThreadToCores(core, 1);
+    }
+
+
+    WorkerPool::WorkerPool() :
+        _job(nullptr), _nextJob(0), _numJobs(0), _busyWorkers(0), _generation(0), _running(false)
+    {}
+
+    WorkerPool::~WorkerPool() {
+        stop();
+    }
+
+    void WorkerPool::start(int numWorkers, int firstCore) {
+        stop();
+        _running = true;
+
+        for (int i = 0; i < numWorkers - 1; ++i)
+            _threads.emplace_back(_process, this, firstCore >= 0 ? firstCore + i : -1);
+    }
+
+    void WorkerPool::stop() {
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            _running = false;
+        }
+
+        _startCondition.notify_all();
+
+        for (auto& thread : _threads)
+            thread.join();
+        _threads.clear();
+    }
+
+    int WorkerPool::size() const {
+        return _threads.size() + 1;
+    }
+
+    void WorkerPool::run(int numJobs, const std::function<void(int)>& job) {
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            _job = &job;
+            _numJobs = numJobs;
+            _nextJob = 0;
+            _busyWorkers = _threads.size();
+            ++_generation;
+        }
+
+        _startCondition.notify_all();
+        _work();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _doneCondition.wait(lock, [this] { return _busyWorkers == 0; });
+        _job = nullptr;
+    }
+
+    void WorkerPool::_work() {
+        // Jobs are picked dynamically, so faster workers take over more jobs
+        for (int i = _nextJob++; i < _numJobs; i = _nextJob++)
+            (*_job)(i);
+    }
+
+    void WorkerPool::_process(WorkerPool* self, int core) {
+        if (core >= 0)
+            pinThreadToCore(core);
+
+        uint64_t generation = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(self->_mutex);
+                self->_startCondition.wait(lock, [&] { return !self->_running || self->_generation != generation; });
+
+                if (!self->_running)
+                    return;
+
+                generation = self->_generation;
+            }
+
+            self->_work();
+
+            {
+                std::lock_guard<std::mutex> guard(self->_mutex);
+                --self->_busyWorkers;
+            }
+            self->_doneCondition.notify_one();
+        }
+    }
+} // namespace util
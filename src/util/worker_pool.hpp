@@ -0,0 +1,59 @@
+#ifndef UTIL_WORKER_POOL_HPP
+#define UTIL_WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+    // Pin the calling thread to the given CPU core. Returns false on failure.
+    bool pinThreadToCore(int core);
+
+    // Pin the calling thread to the cores [first, first + count).
+    // Threads created afterwards by the calling thread inherit this affinity.
+    bool pinThreadToCores(int first, int count);
+
+    // Fixed-size thread pool for fork-join parallelism, e.g. processing a frame in bands.
+    class WorkerPool {
+        public:
+            WorkerPool();
+            WorkerPool(const WorkerPool&) = delete;
+            WorkerPool& operator=(const WorkerPool&) = delete;
+            ~WorkerPool();
+
+            // Start numWorkers - 1 threads, the calling thread of run() being the last worker.
+            // If firstCore >= 0, worker i is pinned to core firstCore + i (modulo the number of
+            // cores) and the calling thread should be pinned to firstCore + numWorkers - 1.
+            void start(int numWorkers, int firstCore = -1);
+            void stop();
+
+            // Number of workers including the calling thread
+            int size() const;
+
+            // Run job(i) for i in [0, numJobs) on all workers and wait for completion.
+            // Must not be called concurrently.
+            void run(int numJobs, const std::function<void(int)>& job);
+
+        private:
+            static void _process(WorkerPool* self, int core);
+            void _work();
+
+        private:
+            std::vector<std::thread> _threads;
+            std::mutex _mutex;
+            std::condition_variable _startCondition;
+            std::condition_variable _doneCondition;
+            const std::function<void(int)>* _job;
+            std::atomic<int> _nextJob;
+            int _numJobs;
+            int _busyWorkers;
+            uint64_t _generation;
+            bool _running;
+    };
+}
+
+#endif
@@ -0,0 +1,257 @@
+#include "x11.hpp"
+#include <X11/Xatom.h>
+#include <X11/Xproto.h>
+#include <chrono>
+#include <iostream>
+#include <poll.h>
+
+using std::cerr;
+using std::endl;
+
+namespace util {
+    // Interval in which the tracker thread checks whether it should stop
+    constexpr int poll_timeout_ms = 200;
+
+    static int logXError(Display* display, XErrorEvent* error) {
+        if (error->error_code == BadWindow)
+            return 0;
+
+        char text[256];
+        XGetErrorText(display, error->error_code, text, sizeof(text));
+        cerr << "X error: " << text << " (request " << static_cast<int>(error->request_code) << ")\n";
+        return 0;
+    }
+
+    void installXErrorHandler() {
+        XSetErrorHandler(logXError);
+    }
+
+
+    WindowTracker::WindowTracker() :
+        _display(nullptr), _netWmName(None), _netWmPid(None), _utf8String(None), _running(false)
+    {}
+
+    WindowTracker::~WindowTracker() {
+        join();
+    }
+
+    bool WindowTracker::start(const char* display) {
+        join();
+        _display = XOpenDisplay(display);
+
+        if (!_display) {
+            cerr << "Failed to open display " << (display ? display : "") << endl;
+            return false;
+        }
+
+        installXErrorHandler();
+        _netWmName = XInternAtom(_display, "_NET_WM_NAME", False);
+        _netWmPid = XInternAtom(_display, "_NET_WM_PID", False);
+        _utf8String = XInternAtom(_display, "UTF8_STRING", False);
+
+        // Windows are selected before their children are queried, so none is missed
+        _add(DefaultRootWindow(_display));
+
+        _running = true;
+        _thread = std::thread(_process, this);
+        return true;
+    }
+
+    void WindowTracker::join() {
+        _running = false;
+
+        if (_thread.joinable())
+            _thread.join();
+
+        if (_display) {
+            XCloseDisplay(_display);
+            _display = nullptr;
+        }
+
+        std::lock_guard lock(_mutex);
+        _windows.clear();
+        _byTitle.clear();
+    }
+
+    Window WindowTracker::find(const std::string& title) const {
+        std::lock_guard lock(_mutex);
+        auto it = _byTitle.find(title);
+        return it == _byTitle.end() ? None : it->second;
+    }
+
+    Window WindowTracker::waitFor(const std::string& title, int timeoutMs) const {
+        std::unique_lock lock(_mutex);
+        _changed.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                [this, &title]() { return _byTitle.find(title) != _byTitle.end(); });
+
+        auto it = _byTitle.find(title);
+        return it == _byTitle.end() ? None : it->second;
+    }
+
+    bool WindowTracker::info(Window window, WindowInfo* info) const {
+        std::lock_guard lock(_mutex);
+        auto it = _windows.find(window);
+
+        if (it == _windows.end())
+            return false;
+
+        *info = it->second;
+        return true;
+    }
+
+    void WindowTracker::_process(WindowTracker* self) {
+        Display* display = self->_display;
+        pollfd fd { .fd = ConnectionNumber(display), .events = POLLIN, .revents = 0 };
+
+        while (self->_running) {
+            if (!XPending(display))
+                poll(&fd, 1, poll_timeout_ms);
+
+            while (XPending(display)) {
+                XEvent event;
+                XNextEvent(display, &event);
+                self->_handleEvent(event);
+            }
+        }
+    }
+
+    void WindowTracker::_handleEvent(const XEvent& event) {
+        switch (event.type) {
+            case CreateNotify:
+                _add(event.xcreatewindow.window);
+                break;
+
+            // Sent for every destroyed window, as its parent is tracked as well
+            case DestroyNotify:
+                _remove(event.xdestroywindow.window);
+                break;
+
+            case PropertyNotify:
+                if (event.xproperty.atom == XA_WM_NAME || event.xproperty.atom == _netWmName) {
+                    _setTitle(event.xproperty.window, _fetchTitle(event.xproperty.window));
+                } else if (event.xproperty.atom == _netWmPid) {
+                    const pid_t pid = _fetchPid(event.xproperty.window);
+                    std::lock_guard lock(_mutex);
+                    if (auto it = _windows.find(event.xproperty.window); it != _windows.end())
+                        it->second.pid = pid;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void WindowTracker::_add(Window window) {
+        XSelectInput(_display, window, SubstructureNotifyMask | PropertyChangeMask);
+
+        {
+            std::lock_guard lock(_mutex);
+            if (!_windows.emplace(window, WindowInfo { "", _fetchPid(window) }).second)
+                return;
+        }
+
+        _setTitle(window, _fetchTitle(window));
+
+        unsigned int numChildren = 0;
+        Window* children = nullptr;
+        Window root, parent;
+
+        if (!XQueryTree(_display, window, &root, &parent, &children, &numChildren))
+            return;
+
+        for (unsigned int i = 0; i < numChildren; ++i)
+            _add(children[i]);
+
+        if (children)
+            XFree(children);
+    }
+
+    void WindowTracker::_remove(Window window) {
+        std::lock_guard lock(_mutex);
+        auto it = _windows.find(window);
+
+        if (it == _windows.end())
+            return;
+
+        auto [begin, end] = _byTitle.equal_range(it->second.title);
+        for (auto entry = begin; entry != end; ++entry) {
+            if (entry->second == window) {
+                _byTitle.erase(entry);
+                break;
+            }
+        }
+
+        _windows.erase(it);
+    }
+
+    void WindowTracker::_setTitle(Window window, std::string title) {
+        {
+            std::lock_guard lock(_mutex);
+            auto it = _windows.find(window);
+
+            if (it == _windows.end() || it->second.title == title)
+                return;
+
+            auto [begin, end] = _byTitle.equal_range(it->second.title);
+            for (auto entry = begin; entry != end; ++entry) {
+                if (entry->second == window) {
+                    _byTitle.erase(entry);
+                    break;
+                }
+            }
+
+            // Most windows have no title
+            if (!title.empty())
+                _byTitle.emplace(title, window);
+            it->second.title = std::move(title);
+        }
+
+        _changed.notify_all();
+    }
+
+    std::string WindowTracker::_fetchTitle(Window window) const {
+        Atom type;
+        int format;
+        unsigned long numItems, bytesAfter;
+        unsigned char* data = nullptr;
+        std::string title;
+
+        if (XGetWindowProperty(_display, window, _netWmName, 0, 1024, False, _utf8String,
+                    &type, &format, &numItems, &bytesAfter, &data) == Success && data) {
+            if (type == _utf8String && format == 8)
+                title.assign(reinterpret_cast<const char*>(data), numItems);
+            XFree(data);
+        }
+
+        if (title.empty()) {
+            char* name = nullptr;
+
+            if (XFetchName(_display, window, &name) && name)
+                title = name;
+
+            if (name)
+                XFree(name);
+        }
+
+        return title;
+    }
+
+    pid_t WindowTracker::_fetchPid(Window window) const {
+        Atom type;
+        int format;
+        unsigned long numItems, bytesAfter;
+        unsigned char* data = nullptr;
+        pid_t pid = 0;
+
+        if (XGetWindowProperty(_display, window, _netWmPid, 0, 1, False, XA_CARDINAL,
+                    &type, &format, &numItems, &bytesAfter, &data) == Success && data) {
+            // Format 32 properties are returned as long
+            if (type == XA_CARDINAL && format == 32 && numItems == 1)
+                pid = *reinterpret_cast<const long*>(data);
+            XFree(data);
+        }
+
+        return pid;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef UTIL_X11_HPP
+#define UTIL_X11_HPP
+
+#include <X11/Xlib.h>
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace util {
+    // Install an X error handler that logs errors instead of exiting the process.
+    // BadWindow errors are ignored, as windows can be destroyed at any time.
+    void installXErrorHandler();
+
+    // Keeps track of all windows of a display and their titles, so windows can be looked up
+    // without walking the window tree.
+    // The tree is walked once in start(). Afterwards, a background thread follows window
+    // creation, destruction and title changes through SubstructureNotify and PropertyNotify
+    // events on every window, using its own display connection.
+    class WindowTracker {
+        public:
+            struct WindowInfo {
+                std::string title;  // _NET_WM_NAME, or WM_NAME if not set
+                pid_t pid;          // _NET_WM_PID, or 0 if not set
+            };
+
+        public:
+            WindowTracker();
+            WindowTracker(const WindowTracker&) = delete;
+            WindowTracker& operator=(const WindowTracker&) = delete;
+            ~WindowTracker();
+
+            bool start(const char* display = nullptr);
+            void join();
+
+            // (Thread-safe) Returns a window with the given title or None.
+            Window find(const std::string& title) const;
+
+            // (Thread-safe) Wait up to timeoutMs for a window with the given title to appear.
+            // Returns None on timeout.
+            Window waitFor(const std::string& title, int timeoutMs) const;
+
+            // (Thread-safe) Returns false if the window is unknown.
+            bool info(Window window, WindowInfo* info) const;
+
+        private:
+            static void _process(WindowTracker* self);
+            void _handleEvent(const XEvent& event);
+            void _add(Window window);
+            void _remove(Window window);
+            void _setTitle(Window window, std::string title);
+            std::string _fetchTitle(Window window) const;
+            pid_t _fetchPid(Window window) const;
+
+        private:
+            Display* _display;
+            Atom _netWmName;
+            Atom _netWmPid;
+            Atom _utf8String;
+            std::unordered_map<Window, WindowInfo> _windows;
+            std::unordered_multimap<std::string, Window> _byTitle;
+            mutable std::mutex _mutex;
+            mutable std::condition_variable _changed;
+            std::thread _thread;
+            std::atomic<bool> _running;
+    };
+}
+
+#endif